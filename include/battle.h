@@ -300,8 +300,34 @@ struct SwitchinCandidate
 {
     struct BattlePokemon battleMon;
     bool8 hypotheticalStatus;
+    u8 partyIndex;
 };
 
+#define AI_SWITCHIN_SPEED_ORDERS (MAX_MON_MOVES * 2)
+
+// The damage and speed order calcs in battle_ai_switch_items.c for one party mon
+// against one opposing battler. They're filled in as they're needed while the AI
+// decides its actions at the start of a turn, so that the switch heuristics don't
+// calculate the same matchup more than once. status1 is part of the key, because
+// GetSwitchinStatusDamage gives the candidate a hypothetical status while it runs.
+struct AiSwitchinMatchup
+{
+    u32 status1;
+    u16 dealtMoves[MAX_MON_MOVES];
+    u16 dealtDamage[MAX_MON_MOVES];
+    u16 takenMoves[MAX_MON_MOVES];
+    u16 takenDamage[MAX_MON_MOVES];
+    u16 speedOrderMoves[AI_SWITCHIN_SPEED_ORDERS][2]; // aiMove, playerMove
+    u8 numDealt;
+    u8 numTaken;
+    u8 numSpeedOrders;
+    u8 isFaster; // 1 bit per speedOrderMoves entry
+    u8 opposingBattler;
+    bool8 isValid;
+};
+
+STATIC_ASSERT(sizeof(((struct AiSwitchinMatchup *)0)->isFaster) * 8 >= AI_SWITCHIN_SPEED_ORDERS, AiSwitchinMatchupIsFasterTooSmall)
+
 struct SimulatedDamage
 {
     u16 minimum;
@@ -327,6 +353,7 @@ struct AiLogicData
     u8 monToSwitchInId[MAX_BATTLERS_COUNT]; // ID of the mon to switch in.
     u8 mostSuitableMonId[MAX_BATTLERS_COUNT]; // Stores result of GetMostSuitableMonToSwitchInto, which decides which generic mon the AI would switch into if they decide to switch. This can be overruled by specific mons found in ShouldSwitch; the final resulting mon is stored in AI_monToSwitchIntoId.
     struct SwitchinCandidate switchinCandidate; // Struct used for deciding which mon to switch to in battle_ai_switch_items.c
+    struct AiSwitchinMatchup switchinMatchups[MAX_BATTLERS_COUNT][PARTY_SIZE]; // battler, partyIndex
     u8 weatherHasEffect:1; // The same as HasWeatherEffect(). Stored here, so it's called only once.
     u8 ejectButtonSwitch:1; // Tracks whether current switch out was from Eject Button
     u8 ejectPackSwitch:1; // Tracks whether current switch out was from Eject Pack
@@ -334,9 +361,10 @@ struct AiLogicData
     u8 aiPredictionInProgress:1; // Tracks whether the AI is in the middle of running prediction calculations
     u8 aiCalcInProgress:1;
     u8 predictingMove:1; // Determines whether AI will use move predictions this turn or not
-    u8 padding1:1;
+    u8 switchinMatchupsActive:1; // Set while nothing in the battle can change, so switchinMatchups can be reused
     u8 shouldSwitch:4; // Stores result of ShouldSwitch, which decides whether a mon should be switched out
-    u8 padding2:4;
+    u8 movesDataPending:4; // Battlers whose moves SetAiLogicDataForNextBattler still has to simulate this turn
+    u8 predictionsPending:4; // Battlers whose moves SetAiLogicDataForNextBattler still has to predict this turn
     u16 predictedMove[MAX_BATTLERS_COUNT];
 };
 
@@ -603,6 +631,32 @@ struct PartyState
     u32 padding:10;
 };
 
+// The parts of GetBattlerAbilityInternal that don't depend on the move being used.
+// An entry is only valid while the battler's ability, item and ability-related
+// volatiles are the ones it was resolved with, and until InvalidateBattlerAbilityCache
+// is called because a Neutralizing Gas user may have appeared.
+struct AbilityCache
+{
+    u32 epoch;
+    u16 ability;
+    u16 item;
+    u8 state; // ABILITY_CACHE_* flags the entry was resolved with
+    u8 gasBattler; // 1 + the battler whose Neutralizing Gas suppresses the ability, or 0
+    bool8 suppressed;
+    bool8 hasAbilityShield;
+};
+
+// The type chart multiplier of every attacking type against a battler's types.
+// It's rebuilt when the battler's types, e.g. from Terastallization, or the
+// Inverse Battle flag differ from the ones it was built for.
+struct TypeEffectivenessCache
+{
+    u8 types[3];
+    bool8 isInverse;
+    bool8 isValid;
+    u16 modifiers[NUMBER_OF_MON_TYPES]; // uq4_12_t
+};
+
 // Cleared at the beginning of the battle. Fields need to be cleared when needed manually otherwise.
 struct BattleStruct
 {
@@ -782,11 +836,29 @@ struct BattleStruct
     u8 numHazards[NUM_BATTLE_SIDES];
     u8 hazardsCounter:4; // Counter for applying hazard on switch in
     u8 padding2:4;
+    struct AbilityCache abilityCache[MAX_BATTLERS_COUNT][2]; // battler, noAbilityShield
+    u32 abilityCacheEpoch;
+    struct TypeEffectivenessCache typeEffectiveness[MAX_BATTLERS_COUNT];
+};
+
+// The results of CalcBattlerAiMovesData for one attacker and target, and
+// hashes of everything they were calculated from, so that SetAiLogicDataForNextBattler
+// only recalculates the pairs whose inputs have changed since the last turn.
+struct AiMovesDataCache
+{
+    u32 fieldKey;
+    u32 attackerKey;
+    u32 targetKey;
+    struct SimulatedDamage simulatedDmg[MAX_MON_MOVES];
+    uq4_12_t effectiveness[MAX_MON_MOVES];
+    u8 moveAccuracy[MAX_MON_MOVES];
+    bool8 valid;
 };
 
 struct AiBattleData
 {
     s32 finalScore[MAX_BATTLERS_COUNT][MAX_BATTLERS_COUNT][MAX_MON_MOVES]; // AI, target, moves to make debugging easier
+    struct AiMovesDataCache movesDataCache[MAX_BATTLERS_COUNT][MAX_BATTLERS_COUNT]; // attacker, target
     u8 playerStallMons[PARTY_SIZE];
     u8 chosenMoveIndex[MAX_BATTLERS_COUNT];
     u8 chosenTarget[MAX_BATTLERS_COUNT];
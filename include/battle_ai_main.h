@@ -120,12 +120,13 @@ enum MoveComparisonResult
 void BattleAI_SetupItems(void);
 void BattleAI_SetupFlags(void);
 void BattleAI_SetupAIData(u8 defaultScoreMoves, u32 battler);
-void ComputeBattlerDecisions(u32 battler);
+bool32 ComputeBattlerDecisions(u32 battler);
 u32 BattleAI_ChooseMoveIndex(u32 battler);
 void Ai_InitPartyStruct(void);
 void Ai_UpdateSwitchInData(u32 battler);
 void Ai_UpdateFaintData(u32 battler);
 void SetAiLogicDataForTurn(struct AiLogicData *aiData);
+bool32 SetAiLogicDataForNextBattler(struct AiLogicData *aiData);
 void ResetDynamicAiFunc(void);
 
 #endif // GUARD_BATTLE_AI_MAIN_H
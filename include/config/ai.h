@@ -67,6 +67,9 @@
 #define RISKY_AI_CRIT_STAGE_THRESHOLD                           2   // Stat stages at which Risky will assume it gets a crit
 #define RISKY_AI_CRIT_THRESHOLD_GEN_1                           128 // "Stat stage" at which Risky will assume it gets a crit with gen 1 mechanics (this translates to an X / 255 % crit threshold)
 
+// AI performance
+#define AI_DECISIONS_PER_FRAME                                  1   // Number of battlers the AI simulates the moves of or decides an action for in one frame at the start of a turn. Higher values make it decide sooner, but animations may stutter while it does.
+
 // AI prediction chances
 #define PREDICT_SWITCH_CHANCE                                   50
 #define PREDICT_MOVE_CHANCE                                     100
@@ -279,6 +279,24 @@
  * this cannot be used to have two moves independently hit or miss, for
  * example.
  *
+ * PASSES_RANDOMLY(successes, trials, tag, .independent = TRUE)
+ * Each call involving tag returns its own number instead. The test is run
+ * once for each combination of numbers that the calls can produce, and
+ * each run is weighted by how likely that combination is, so the pass
+ * ratio is exact apart from rounding each run's weight to a multiple of
+ * 2^-24. For example, to check that Paralysis skips two turns in a row
+ * 1/16 times:
+ *     SINGLE_BATTLE_TEST("Paralysis has a 25% chance of skipping each turn")
+ *     {
+ *         PASSES_RANDOMLY(1, 16, RNG_PARALYSIS, .independent = TRUE);
+ *         ...
+ *     }
+ * The number of runs is the product of the number of outcomes of each
+ * call, so this should only be used with a few calls.
+ *
+ * In either mode, the runs stop early once the remaining ones can't
+ * change whether the test passes.
+ *
  * If the tag is not provided, runs the test 50 times and computes an
  * approximate pass ratio.
  *     PASSES_RANDOMLY(GetMoveAccuracy(move), 100);
@@ -338,6 +356,20 @@
  * The most common combination is  AI_FLAGS(AI_FLAG_CHECK_BAD_MOVE | AI_FLAG_CHECK_VIABILITY | AI_FLAG_TRY_TO_FAINT)
  * which is the general 'smart' AI.
  *
+ * AIDecisionsPerFrame(n)
+ * Overrides AI_DECISIONS_PER_FRAME, i.e. how many battlers the AI works
+ * on in one frame at the start of a turn. Used to check that spreading
+ * the AI's work over frames doesn't change its decisions.
+ *
+ * FUZZ(fuzzCase)
+ * Generates both parties at random from fuzzCase.seed, and then plays
+ * fuzzCase.turns turns in which every battler takes a random legal
+ * action. Replaces PLAYER, OPPONENT and WHEN, and the test only fails if
+ * the battle crashes, hangs, leaks memory or overflows the battle script
+ * stack. Used by the "Fuzz: ..." tests in test/fuzz/battle.c, which
+ * `make fuzz` runs with new seeds; the name of a failing test ends with
+ * the FUZZ_CASE that reproduces it.
+ *
  * WHEN
  * Contains the choices that battlers make during the battle.
  *
@@ -536,6 +568,7 @@
 #define MAX_TURNS 16
 #define MAX_QUEUED_EVENTS 30
 #define MAX_EXPECTED_ACTIONS 10
+#define MAX_RNG_BRANCHES 16
 
 enum { BATTLE_TEST_SINGLES, BATTLE_TEST_DOUBLES, BATTLE_TEST_WILD, BATTLE_TEST_AI_SINGLES, BATTLE_TEST_AI_DOUBLES };
 
@@ -681,6 +714,24 @@ struct BattleTrialData
     u8 aiActionsPlayed[MAX_BATTLERS_COUNT];
 };
 
+// A randomly generated battle; see FUZZ. 'turns' and 'reductions' start
+// at values derived from 'seed', and are changed to minimize the case.
+struct FuzzCase
+{
+    u32 seed;
+    u16 turns;
+    u16 reductions;
+};
+
+#define MAX_FUZZ_TURNS 20
+
+// Parts of a fuzz case to leave out.
+#define FUZZ_DROP_PLAYER(partyIndex) (1 << (partyIndex))
+#define FUZZ_DROP_OPPONENT(partyIndex) (1 << (PARTY_SIZE + (partyIndex)))
+#define FUZZ_NO_ITEMS (1 << (2 * PARTY_SIZE))
+#define FUZZ_NO_ABILITIES (1 << (2 * PARTY_SIZE + 1))
+#define FUZZ_ONE_MOVE (1 << (2 * PARTY_SIZE + 2))
+
 struct BattleTestData
 {
     u8 stack[BATTLE_TEST_STACK_SIZE];
@@ -706,6 +757,7 @@ struct BattleTestData
     u8 moveBattlers;
     bool8 hasAI:1;
     bool8 logAI:1;
+    u8 aiDecisionsPerFrame; // Overrides AI_DECISIONS_PER_FRAME unless 0.
 
     struct RecordedBattleSave recordedBattle;
     u8 battleRecordTypes[MAX_BATTLERS_COUNT][BATTLER_RECORD_SIZE];
@@ -724,10 +776,20 @@ struct BattleTestData
     struct AILogLine aiLogLines[MAX_BATTLERS_COUNT][MAX_MON_MOVES][MAX_AI_LOG_LINES];
     u8 aiLogPrintedForMove[MAX_BATTLERS_COUNT]; // Marks ai score log as printed for move, so the same log isn't displayed multiple times.
     u16 flagId;
+    struct FuzzCase fuzzCase; // fuzzCase.turns is 0 unless FUZZ was used.
+    rng_value_t fuzzRng;
 
     struct BattleTrialData trial;
 };
 
+// The outcome taken by one call with the PASSES_RANDOMLY tag, when each
+// call is independent.
+struct RngBranch
+{
+    u16 value;
+    u16 count;
+};
+
 struct BattleTestRunnerState
 {
     u8 battlersCount;
@@ -739,11 +801,16 @@ struct BattleTestRunnerState
     u16 rngTrialOffset;
     u16 trials;
     u16 runTrial;
-    u16 expectedRatio;
-    u16 observedRatio;
-    u16 trialRatio;
+    u32 expectedRatio;
+    u32 observedRatio;
+    u32 exploredRatio;
+    u32 trialRatio;
+    u8 rngDepth;
+    u8 rngBranchesCount;
+    struct RngBranch rngBranches[MAX_RNG_BRANCHES];
     bool8 runRandomly:1;
     bool8 didRunRandomly:1;
+    bool8 rngIndependent:1;
     bool8 runGiven:1;
     bool8 runWhen:1;
     bool8 runScene:1;
@@ -831,10 +898,27 @@ extern struct BattleTestRunnerState *const gBattleTestRunnerState;
 struct RandomlyContext
 {
     u16 tag;
+    bool8 independent;
 };
 
 void Randomly(u32 sourceLine, u32 passes, u32 trials, struct RandomlyContext);
 
+/* Fuzz */
+
+// The number of "Fuzz: ..." tests of each type that the cases are spread
+// between, so that hydra can run them in parallel.
+#define FUZZ_TESTS 16
+
+// Used in GIVEN instead of PLAYER/OPPONENT and TURN. Generates random
+// parties from the case's seed, and then plays 'turns' turns choosing a
+// random legal action whenever the battle asks for one. The test fails
+// if the battle crashes, hangs, leaks or overflows the script stack.
+#define FUZZ(fuzzCase) Fuzz_(__LINE__, fuzzCase)
+
+void Fuzz_(u32 sourceLine, struct FuzzCase fuzzCase);
+// Gets the n-th case of the type to run, as configured by gTestRunnerFuzz.
+bool32 GetFuzzCase(u32 n, bool32 isDouble, struct FuzzCase *fuzzCase);
+
 /* Given */
 
 struct moveWithPP {
@@ -847,6 +931,7 @@ struct moveWithPP {
 #define RNGSeed(seed) RNGSeed_(__LINE__, seed)
 #define AI_FLAGS(flags) AIFlags_(__LINE__, flags)
 #define AI_LOG AILogScores(__LINE__)
+#define AIDecisionsPerFrame(decisions) AIDecisionsPerFrame_(__LINE__, decisions)
 
 #define FLAG_SET(flagId) SetFlagForTest(__LINE__, flagId)
 #define WITH_CONFIG(configTag, value) TestSetConfig(__LINE__, configTag, value)
@@ -891,6 +976,7 @@ void ClosePokemon(u32 sourceLine);
 void RNGSeed_(u32 sourceLine, rng_value_t seed);
 void AIFlags_(u32 sourceLine, u64 flags);
 void AILogScores(u32 sourceLine);
+void AIDecisionsPerFrame_(u32 sourceLine, u32 decisions);
 void Gender_(u32 sourceLine, u32 gender);
 void Nature_(u32 sourceLine, u32 nature);
 void Ability_(u32 sourceLine, u32 ability);
@@ -3,7 +3,10 @@
 
 #include "test_runner.h"
 
-#define MAX_PROCESSES 32 // See also tools/mgba-rom-test-hydra/main.c
+// The most processes that the tests can be split between when each
+// process assigns itself tests (i.e. gTestRunnerEnd is 0). Hydra has no
+// limit when it hands out ranges. See also tools/mgba-rom-test-hydra/main.c
+#define MAX_PROCESSES 32
 
 enum TestResult
 {
@@ -37,6 +40,10 @@ struct Test
     u16 sourceLine;
 };
 
+// Hydra reads the '.tests' section to hand out tests.
+// See also tools/mgba-rom-test-hydra/main.c
+STATIC_ASSERT(sizeof(struct Test) == 20, TestSizeMatchesHydra);
+
 enum TestFilterMode
 {
     TEST_FILTER_MODE_TEST_NAME_PREFIX,
@@ -53,6 +60,8 @@ struct TestRunnerState
     u32 failedAssumptionsBlockLine;
     const struct Test *test;
     u32 processCosts[MAX_PROCESSES];
+    // Min-heap of process indices, ordered by processCosts then index.
+    u8 processHeap[MAX_PROCESSES];
 
     u8 result;
     u8 expectedResult;
@@ -60,6 +69,7 @@ struct TestRunnerState
     bool8 inBenchmark:1;
     bool8 tearDown:1;
     u32 timeoutSeconds;
+    u32 startFrame;
 };
 
 struct PersistentTestRunnerState
@@ -72,7 +82,19 @@ struct PersistentTestRunnerState
 
 extern const u8 gTestRunnerN;
 extern const u8 gTestRunnerI;
+// If gTestRunnerEnd is non-zero, only the tests in [gTestRunnerStart,
+// gTestRunnerEnd) of '.tests' are run, as handed out by hydra.
+extern const u32 gTestRunnerStart;
+extern const u32 gTestRunnerEnd;
 extern const char gTestRunnerArgv[256];
+// If set, the tests are sampled about 1000 times a second and the
+// samples are sent to hydra, which builds a profile from them.
+extern const bool8 gTestRunnerProfile;
+// Which cases the "Fuzz: ..." tests run: "<seed>/<cases>" runs that
+// many new cases of each type, "<seed>-<turns>-<reductions>" runs that
+// case and the smaller cases it can be reduced to, and "" runs one case
+// per test from seed 0.
+extern const char gTestRunnerFuzz[32];
 
 extern const struct TestRunner gAssumptionsRunner;
 
@@ -194,18 +216,23 @@ static inline void BenchmarkStart(void)
     // Wait for a v-blank so that comparing two benchmarks is not affected
     // by the v-count (different numbers of IRQs may run).
     VBlankIntrWait();
-    REG_TM3CNT = (TIMER_ENABLE | TIMER_64CLK) << 16;
+    // TM3 raises its interrupt flag if it overflows, which BenchmarkStop
+    // checks. The interrupt itself isn't enabled, so it doesn't fire.
+    REG_IF = INTR_FLAG_TIMER3;
+    REG_TM3CNT = (TIMER_ENABLE | TIMER_INTR_ENABLE | TIMER_64CLK) << 16;
 }
 
-static inline struct Benchmark BenchmarkStop(void)
+static inline struct Benchmark BenchmarkStop(u32 sourceLine)
 {
     REG_TM3CNT_H = 0;
     gTestRunnerState.inBenchmark = FALSE;
+    if (REG_IF & INTR_FLAG_TIMER3)
+        Test_ExitWithResult(TEST_RESULT_FAIL, sourceLine, ":L%s:%d: BENCHMARK took more than %u cycles", gTestRunnerState.test->filename, sourceLine, (UINT16_MAX + 1) * 64);
     return (struct Benchmark) { REG_TM3CNT_L };
 }
 
 #define BENCHMARK(id) \
-    for (BenchmarkStart(); gTestRunnerState.inBenchmark; *(id) = BenchmarkStop())
+    for (BenchmarkStart(); gTestRunnerState.inBenchmark; *(id) = BenchmarkStop(__LINE__))
 
 // An approximation of how much overhead benchmarks introduce.
 #define BENCHMARK_ABS 2
@@ -232,6 +259,12 @@ static inline struct Benchmark BenchmarkStop(void)
             Test_ExitWithResult(TEST_RESULT_FAIL, __LINE__, ":L%s:%d: EXPECT_SLOWER(" #a ", " #b ") failed", gTestRunnerState.test->filename, __LINE__); \
     } while (0)
 
+// Reports a benchmark's cycle count to hydra, which 'make bench' checks
+// against the stored baseline. The benchmark is identified by the test
+// name and 'b', so those should be unique.
+#define REPORT_BENCHMARK(b) \
+    Test_MgbaPrintf(":B%u %s", (u32)(b).ticks * 64, #b)
+
 #define KNOWN_FAILING \
     Test_ExpectedResult(TEST_RESULT_KNOWN_FAIL)
 
@@ -20,12 +20,16 @@ void TestRunner_Battle_CheckAiMoveScores(u32 battlerId);
 void TestRunner_Battle_AISetScore(const char *file, u32 line, u32 battlerId, u32 moveIndex, s32 score);
 void TestRunner_Battle_AIAdjustScore(const char *file, u32 line, u32 battlerId, u32 moveIndex, s32 score);
 void TestRunner_Battle_InvalidNoHPMon(u32 battlerId, u32 partyIndex);
+void TestRunner_Battle_ScriptsStackOverflow(const u8 *bsPtr);
+void TestRunner_Battle_StaleAbilityCache(u32 battlerId);
 void TestRunner_CheckMemory(void);
 
 void TestRunner_Battle_CheckBattleRecordActionType(u32 battlerId, u32 recordIndex, u32 actionType);
+void TestRunner_Battle_FuzzBattleRecordAction(u32 battlerId, u32 actionType, u8 *action);
 
 u32 TestRunner_Battle_GetForcedAbility(u32 side, u32 partyIndex);
 u32 TestRunner_Battle_GetChosenGimmick(u32 side, u32 partyIndex);
+u32 TestRunner_Battle_GetAiDecisionsPerFrame(void);
 
 #else
 
@@ -42,13 +46,18 @@ u32 TestRunner_Battle_GetChosenGimmick(u32 side, u32 partyIndex);
 #define TestRunner_Battle_AISetScore(...) (void)0
 #define TestRunner_Battle_AIAdjustScore(...) (void)0
 #define TestRunner_Battle_InvalidNoHPMon(...) (void)0
+#define TestRunner_Battle_ScriptsStackOverflow(...) (void)0
+#define TestRunner_Battle_StaleAbilityCache(...) (void)0
 
 #define TestRunner_Battle_CheckBattleRecordActionType(...) (void)0
+#define TestRunner_Battle_FuzzBattleRecordAction(...) (void)0
 
 #define TestRunner_Battle_GetForcedAbility(...) (u32)0
 
 #define TestRunner_Battle_GetChosenGimmick(...) (u32)0
 
+#define TestRunner_Battle_GetAiDecisionsPerFrame(...) (u32)0
+
 #endif
 
 #endif
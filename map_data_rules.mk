@@ -25,17 +25,49 @@ $(DATA_ASM_BUILDDIR)/maps.o: $(DATA_ASM_SUBDIR)/maps.s $(LAYOUTS_DIR)/layouts.in
 $(DATA_ASM_BUILDDIR)/map_events.o: $(DATA_ASM_SUBDIR)/map_events.s $(MAPS_DIR)/events.inc $(MAP_EVENTS)
 	$(PREPROC) $< charmap.txt | $(CPP) -I include - | $(PREPROC) -ie $< charmap.txt | $(AS) $(ASFLAGS) -o $@
 
-$(MAPS_OUTDIR)/%/header.inc $(MAPS_OUTDIR)/%/events.inc $(MAPS_OUTDIR)/%/connections.inc: $(MAPS_DIR)/%/map.json
-	$(MAPJSON) map emerald $< $(LAYOUTS_DIR)/layouts.json $(@D)
+# mapjson only rewrites outputs whose contents change, so that editing one map doesn't rebuild everything that
+# includes the generated files. The stamp files record when each mapjson step last ran instead.
+# If an output has gone missing while its stamp is up to date, it is regenerated on its own.
+MAPJSON_STAMP_DIR := $(BUILD_DIR)/mapjson
 
-$(MAPS_OUTDIR)/connections.inc $(MAPS_OUTDIR)/groups.inc $(MAPS_OUTDIR)/events.inc $(MAPS_OUTDIR)/headers.inc $(INCLUDECONSTS_OUTDIR)/map_groups.h $(DATA_SRC_SUBDIR)/map_group_count.h: $(MAPS_DIR)/map_groups.json
-	$(MAPJSON) groups emerald $< $(MAPS_OUTDIR) $(INCLUDECONSTS_OUTDIR)
+$(MAPJSON_STAMP_DIR):
+	@mkdir -p $@
 
-$(LAYOUTS_OUTDIR)/layouts.inc $(LAYOUTS_OUTDIR)/layouts_table.inc $(INCLUDECONSTS_OUTDIR)/layouts.h: $(LAYOUTS_DIR)/layouts.json
-	$(MAPJSON) layouts emerald $< $(LAYOUTS_OUTDIR) $(INCLUDECONSTS_OUTDIR)
+# All maps are processed by a single mapjson call, which skips maps whose inputs are unchanged.
+# There's a lot of map.json files, so we print an abbreviated output with echo.
+$(MAPJSON_STAMP_DIR)/maps.stamp: $(MAP_JSONS) $(LAYOUTS_DIR)/layouts.json | $(MAPJSON_STAMP_DIR)
+	@$(MAPJSON) maps emerald $(LAYOUTS_DIR)/layouts.json $(MAPJSON_STAMP_DIR)/maps.cache $(MAP_JSONS)
+	@echo "$(MAPJSON) maps emerald $(LAYOUTS_DIR)/layouts.json $(MAPJSON_STAMP_DIR)/maps.cache <MAP_JSONS>"
+	@touch $@
+
+$(MAP_CONNECTIONS) $(MAP_EVENTS) $(MAP_HEADERS): $(MAPJSON_STAMP_DIR)/maps.stamp
+	@test -f $@ || $(MAPJSON) map emerald $(@D)/map.json $(LAYOUTS_DIR)/layouts.json $(@D)
+
+MAP_GROUPS_OUTPUTS := $(MAPS_OUTDIR)/connections.inc $(MAPS_OUTDIR)/groups.inc $(MAPS_OUTDIR)/events.inc $(MAPS_OUTDIR)/headers.inc $(INCLUDECONSTS_OUTDIR)/map_groups.h $(DATA_SRC_SUBDIR)/map_group_count.h
+LAYOUTS_OUTPUTS := $(LAYOUTS_OUTDIR)/layouts.inc $(LAYOUTS_OUTDIR)/layouts_table.inc $(INCLUDECONSTS_OUTDIR)/layouts.h
+
+# With ASSET_CACHE set, the steps below are restored from the cache where possible. Like mapjson itself, this
+# leaves outputs whose contents are unchanged alone (-u). The per-map step has its own cache in maps.cache.
+$(MAPJSON_STAMP_DIR)/groups.stamp: $(MAPS_DIR)/map_groups.json | $(MAPJSON_STAMP_DIR)
+	$(call CACHED,$(MAP_GROUPS_OUTPUTS),-u) $(MAPJSON) groups emerald $< $(MAPS_OUTDIR) $(INCLUDECONSTS_OUTDIR)
+	@touch $@
+
+$(MAP_GROUPS_OUTPUTS): $(MAPJSON_STAMP_DIR)/groups.stamp
+	@test -f $@ || $(MAPJSON) groups emerald $(MAPS_DIR)/map_groups.json $(MAPS_OUTDIR) $(INCLUDECONSTS_OUTDIR)
+
+$(MAPJSON_STAMP_DIR)/layouts.stamp: $(LAYOUTS_DIR)/layouts.json | $(MAPJSON_STAMP_DIR)
+	$(call CACHED,$(LAYOUTS_OUTPUTS),-u) $(MAPJSON) layouts emerald $< $(LAYOUTS_OUTDIR) $(INCLUDECONSTS_OUTDIR)
+	@touch $@
+
+$(LAYOUTS_OUTPUTS): $(MAPJSON_STAMP_DIR)/layouts.stamp
+	@test -f $@ || $(MAPJSON) layouts emerald $(LAYOUTS_DIR)/layouts.json $(LAYOUTS_OUTDIR) $(INCLUDECONSTS_OUTDIR)
 
 # Generate constants for map events, which depend on data that's distributed across the map.json files.
 # There's a lot of map.json files, so we print an abbreviated output with echo.
-$(INCLUDECONSTS_OUTDIR)/map_event_ids.h: $(MAP_JSONS)
-	@$(MAPJSON) event_constants emerald $^ $(INCLUDECONSTS_OUTDIR)/map_event_ids.h
+$(MAPJSON_STAMP_DIR)/map_event_ids.stamp: $(MAP_JSONS) | $(MAPJSON_STAMP_DIR)
+	@$(call CACHED,$(INCLUDECONSTS_OUTDIR)/map_event_ids.h,-u) $(MAPJSON) event_constants emerald $(MAP_JSONS) $(INCLUDECONSTS_OUTDIR)/map_event_ids.h
 	@echo "$(MAPJSON) event_constants emerald <MAP_JSONS> $(INCLUDECONSTS_OUTDIR)/map_event_ids.h"
+	@touch $@
+
+$(INCLUDECONSTS_OUTDIR)/map_event_ids.h: $(MAPJSON_STAMP_DIR)/map_event_ids.stamp
+	@test -f $@ || $(MAPJSON) event_constants emerald $(MAP_JSONS) $@
@@ -22,6 +22,7 @@
 #include "recorded_battle.h"
 #include "util.h"
 #include "script.h"
+#include "test/test.h"
 #include "constants/abilities.h"
 #include "constants/battle_ai.h"
 #include "constants/battle_move_effects.h"
@@ -356,19 +357,21 @@ void SetupAIPredictionData(u32 battler, enum SwitchType switchType)
     gAiLogicData->aiPredictionInProgress = FALSE;
 }
 
-void ComputeBattlerDecisions(u32 battler)
+// Returns whether there were any decisions to compute.
+bool32 ComputeBattlerDecisions(u32 battler)
 {
     bool32 isAiBattler = (gBattleTypeFlags & BATTLE_TYPE_HAS_AI || IsWildMonSmart()) && (BattlerHasAi(battler) && !(gBattleTypeFlags & BATTLE_TYPE_PALACE));
     if (isAiBattler || CanAiPredictMove())
     {
         // If ai is about to flee or chosen to watch player, no need to calc anything
         if (isAiBattler && BattlerChoseNonMoveAction())
-            return;
+            return FALSE;
 
         // Risky AI switches aggressively even mid battle
         enum SwitchType switchType = (gAiThinkingStruct->aiFlags[battler] & AI_FLAG_RISKY) ? SWITCH_AFTER_KO : SWITCH_MID_BATTLE;
 
         gAiLogicData->aiCalcInProgress = TRUE;
+        gAiLogicData->switchinMatchupsActive = TRUE;
 
         // Setup battler and prediction data
         BattleAI_SetupAIData(0xF, battler);
@@ -388,7 +391,10 @@ void ComputeBattlerDecisions(u32 battler)
         ModifySwitchAfterMoveScoring(battler);
 
         gAiLogicData->aiCalcInProgress = FALSE;
+        gAiLogicData->switchinMatchupsActive = FALSE;
+        return TRUE;
     }
+    return FALSE;
 }
 
 void ReconsiderGimmick(u32 battlerAtk, u32 battlerDef, u16 move)
@@ -590,7 +596,28 @@ static u32 Ai_SetMoveAccuracy(struct AiLogicData *aiData, u32 battlerAtk, u32 ba
 }
 #undef BYPASSES_ACCURACY_CALC
 
-static void CalcBattlerAiMovesData(struct AiLogicData *aiData, u32 battlerAtk, u32 battlerDef, u32 weather)
+// These depend on what happened earlier in the turn, which the keys below
+// don't cover, so they're recalculated even when the rest is cached.
+static bool32 IsAiMovesDataCacheable(struct AiLogicData *aiData, u32 battlerAtk, u32 move)
+{
+    if (aiData->abilities[battlerAtk] == ABILITY_ANALYTIC)
+        return FALSE;
+
+    switch (GetMoveEffect(move))
+    {
+    case EFFECT_BEAT_UP:
+    case EFFECT_BOLT_BEAK:
+    case EFFECT_FUSION_COMBO:
+    case EFFECT_PAYBACK:
+    case EFFECT_RETALIATE:
+    case EFFECT_ROUND:
+        return FALSE;
+    default:
+        return TRUE;
+    }
+}
+
+static void CalcBattlerAiMovesData(struct AiLogicData *aiData, u32 battlerAtk, u32 battlerDef, u32 weather, bool32 isCached)
 {
     u32 moveIndex, move;
     u16 *moves = GetMovesArray(battlerAtk);
@@ -604,6 +631,8 @@ static void CalcBattlerAiMovesData(struct AiLogicData *aiData, u32 battlerAtk, u
 
         if (IsMoveUnusable(moveIndex, move, moveLimitations))
             continue;
+        if (isCached && IsAiMovesDataCacheable(aiData, battlerAtk, move))
+            continue;
 
         // Also get effectiveness of status moves
         dmg = AI_CalcDamage(move, battlerAtk, battlerDef, &effectiveness, USE_GIMMICK, NO_GIMMICK, weather);
@@ -614,11 +643,132 @@ static void CalcBattlerAiMovesData(struct AiLogicData *aiData, u32 battlerAtk, u
     }
 }
 
-static void SetBattlerAiMovesData(struct AiLogicData *aiData, u32 battlerAtk, u32 battlersCount, u32 weather)
+#define HASH_AI_MOVES_DATA_INPUT(hash, input) HashAiMovesDataInput(hash, &(input), sizeof(input))
+static u32 HashAiMovesDataInput(u32 hash, const void *input, u32 size)
 {
-    u32 battlerDef;
+    const u8 *bytes = input;
+
+    // FNV-1a
+    while (size-- != 0)
+        hash = (hash ^ *bytes++) * 16777619;
+    return hash;
+}
+
+// Hashes everything about the battler that the damage and accuracy calcs read,
+// as the AI sees it (i.e. after SetBattlerData). HP is part of it, so a
+// battler that was hit or healed has all its pairs recalculated.
+static u32 GetAiMovesDataBattlerKey(struct AiLogicData *aiData, u32 battler)
+{
+    u32 hash = 2166136261;
+    u32 gimmick = GetActiveGimmick(battler);
+    bool32 slowStart = gDisableStructs[battler].slowStartTimer > gBattleTurnCounter;
+
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gBattleMons[battler]);
+    hash = HashAiMovesDataInput(hash, GetMovesArray(battler), sizeof(u16) * MAX_MON_MOVES);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gDisableStructs[battler]);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gProtectStructs[battler]);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gSpecialStatuses[battler]);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gBattleStruct->battlerState[battler]);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, *GetBattlerPartyState(battler));
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gBattlerPartyIndexes[battler]);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gLastResultingMoves[battler]);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gBattleStruct->sameMoveTurns[battler]);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gBattleStruct->chosenMovePositions[battler]);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gBattleStruct->skyDropTargets[battler]);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gBattleStruct->supremeOverlordCounter[battler]);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gBattleStruct->gimmick.usableGimmick[battler]);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gimmick);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, slowStart);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gAiThinkingStruct->aiFlags[battler]);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, aiData->abilities[battler]);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, aiData->items[battler]);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, aiData->holdEffects[battler]);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, aiData->holdEffectParams[battler]);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, aiData->moveLimitations[battler]);
+    return hash;
+}
+
+// Hashes the weather, terrain, screens and everything else that isn't about
+// the attacker or target, e.g. their partners' abilities. Timers are left
+// out because only their statuses affect the calcs.
+static u32 GetAiMovesDataFieldKey(struct AiLogicData *aiData, u32 weather)
+{
+    u32 battler;
+    u32 hash = 2166136261;
+    bool32 weatherHasEffect = aiData->weatherHasEffect;
+    bool32 meFirst = GetMoveEffect(gChosenMove) == EFFECT_ME_FIRST;
+    bool32 pledgeMove = gBattleStruct->pledgeMove;
+    bool32 fickleBeamBoosted = gBattleStruct->fickleBeamBoosted;
+
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, weather);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, weatherHasEffect);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gBattleWeather);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gFieldStatuses);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gSideStatuses);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gBattleResults.playerFaintCounter);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gBattleResults.opponentFaintCounter);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, gMultiHitCounter);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, meFirst);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, pledgeMove);
+    hash = HASH_AI_MOVES_DATA_INPUT(hash, fickleBeamBoosted);
+    for (battler = 0; battler < gBattlersCount; battler++)
+    {
+        bool32 isAlive = IsBattlerAlive(battler);
+
+        hash = HASH_AI_MOVES_DATA_INPUT(hash, isAlive);
+        hash = HASH_AI_MOVES_DATA_INPUT(hash, gBattleMons[battler].species);
+        hash = HASH_AI_MOVES_DATA_INPUT(hash, aiData->abilities[battler]);
+        hash = HASH_AI_MOVES_DATA_INPUT(hash, aiData->holdEffects[battler]);
+    }
+    return hash;
+}
+#undef HASH_AI_MOVES_DATA_INPUT
+
+static void SetCachedAiMovesData(struct AiLogicData *aiData, u32 battlerAtk, u32 battlerDef, u32 weather, u32 fieldKey, u32 attackerKey)
+{
+    struct AiMovesDataCache *cache = &gAiBattleData->movesDataCache[battlerAtk][battlerDef];
+    u32 targetKey = GetAiMovesDataBattlerKey(aiData, battlerDef);
+    bool32 isCached = cache->valid
+                   && cache->fieldKey == fieldKey
+                   && cache->attackerKey == attackerKey
+                   && cache->targetKey == targetKey;
+
+    if (isCached)
+    {
+        memcpy(aiData->simulatedDmg[battlerAtk][battlerDef], cache->simulatedDmg, sizeof(cache->simulatedDmg));
+        memcpy(aiData->effectiveness[battlerAtk][battlerDef], cache->effectiveness, sizeof(cache->effectiveness));
+        memcpy(aiData->moveAccuracy[battlerAtk][battlerDef], cache->moveAccuracy, sizeof(cache->moveAccuracy));
+    }
+    CalcBattlerAiMovesData(aiData, battlerAtk, battlerDef, weather, isCached);
+
+    if (TESTING && isCached)
+    {
+        // Catch inputs that are missing from the keys.
+        memcpy(cache->simulatedDmg, aiData->simulatedDmg[battlerAtk][battlerDef], sizeof(cache->simulatedDmg));
+        memcpy(cache->effectiveness, aiData->effectiveness[battlerAtk][battlerDef], sizeof(cache->effectiveness));
+        memcpy(cache->moveAccuracy, aiData->moveAccuracy[battlerAtk][battlerDef], sizeof(cache->moveAccuracy));
+        CalcBattlerAiMovesData(aiData, battlerAtk, battlerDef, weather, FALSE);
+        if (memcmp(cache->simulatedDmg, aiData->simulatedDmg[battlerAtk][battlerDef], sizeof(cache->simulatedDmg)) != 0
+         || memcmp(cache->effectiveness, aiData->effectiveness[battlerAtk][battlerDef], sizeof(cache->effectiveness)) != 0
+         || memcmp(cache->moveAccuracy, aiData->moveAccuracy[battlerAtk][battlerDef], sizeof(cache->moveAccuracy)) != 0)
+            Test_ExitWithResult(TEST_RESULT_ERROR, 0, ":L:%s:%d: cached AI moves data of battler %d against %d is stale", __FILE__, __LINE__, battlerAtk, battlerDef);
+    }
+
+    cache->valid = TRUE;
+    cache->fieldKey = fieldKey;
+    cache->attackerKey = attackerKey;
+    cache->targetKey = targetKey;
+    memcpy(cache->simulatedDmg, aiData->simulatedDmg[battlerAtk][battlerDef], sizeof(cache->simulatedDmg));
+    memcpy(cache->effectiveness, aiData->effectiveness[battlerAtk][battlerDef], sizeof(cache->effectiveness));
+    memcpy(cache->moveAccuracy, aiData->moveAccuracy[battlerAtk][battlerDef], sizeof(cache->moveAccuracy));
+}
+
+static void SetBattlerAiMovesData(struct AiLogicData *aiData, u32 battlerAtk, u32 battlersCount, u32 weather, u32 fieldKey)
+{
+    u32 battlerDef, attackerKey;
     SaveBattlerData(battlerAtk);
     SetBattlerData(battlerAtk);
+    attackerKey = GetAiMovesDataBattlerKey(aiData, battlerAtk);
 
     // Simulate dmg for both ai controlled mons and for player controlled mons.
     for (battlerDef = 0; battlerDef < battlersCount; battlerDef++)
@@ -628,7 +778,7 @@ static void SetBattlerAiMovesData(struct AiLogicData *aiData, u32 battlerAtk, u3
 
         SaveBattlerData(battlerDef);
         SetBattlerData(battlerDef);
-        CalcBattlerAiMovesData(aiData, battlerAtk, battlerDef, weather);
+        SetCachedAiMovesData(aiData, battlerAtk, battlerDef, weather, fieldKey, attackerKey);
         RestoreBattlerData(battlerDef);
     }
     RestoreBattlerData(battlerAtk);
@@ -636,7 +786,7 @@ static void SetBattlerAiMovesData(struct AiLogicData *aiData, u32 battlerAtk, u3
 
 void SetAiLogicDataForTurn(struct AiLogicData *aiData)
 {
-    u32 battlerAtk, battlersCount, weather;
+    u32 battlerAtk;
 
     memset(aiData, 0, sizeof(struct AiLogicData));
     if (!(gBattleTypeFlags & BATTLE_TYPE_HAS_AI) && !IsWildMonSmart())
@@ -646,36 +796,59 @@ void SetAiLogicDataForTurn(struct AiLogicData *aiData)
     gBattleStruct->aiDelayTimer = gMain.vblankCounter1;
 
     aiData->weatherHasEffect = HasWeatherEffect();
-    weather = AI_GetWeather();
-
-    // get/assume all battler data and simulate AI damage
-    battlersCount = gBattlersCount;
 
+    // get/assume all battler data, and leave simulating AI damage to SetAiLogicDataForNextBattler
     gAiLogicData->aiCalcInProgress = TRUE;
     if (DEBUG_AI_DELAY_TIMER)
         CycleCountStart();
-    for (battlerAtk = 0; battlerAtk < battlersCount; battlerAtk++)
+    for (battlerAtk = 0; battlerAtk < gBattlersCount; battlerAtk++)
     {
         if (!IsBattlerAlive(battlerAtk))
             continue;
 
         SetBattlerAiData(battlerAtk, aiData);
+        aiData->movesDataPending |= 1u << battlerAtk;
     }
 
-    for (battlerAtk = 0; battlerAtk < battlersCount; battlerAtk++)
+    for (battlerAtk = 0; battlerAtk < gBattlersCount; battlerAtk++)
     {
-        if (!IsBattlerAlive(battlerAtk))
-            continue;
-
-        SetBattlerAiMovesData(aiData, battlerAtk, battlersCount, weather);
+        // Prediction limited to player side but can be expanded to read partners move in the future
+        if (IsOnPlayerSide(battlerAtk) && CanAiPredictMove())
+            aiData->predictionsPending |= 1u << battlerAtk;
     }
 
-    for (battlerAtk = 0; battlerAtk < battlersCount; battlerAtk++)
-    {
-        // Prediction limited to player side but can be expanded to read partners move in the future
-        if (!IsOnPlayerSide(battlerAtk) || !CanAiPredictMove())
-            continue;
+    if (DEBUG_AI_DELAY_TIMER)
+        // We add to existing to compound multiple calls
+        gBattleStruct->aiDelayCycles += CycleCountEnd();
+    gAiLogicData->aiCalcInProgress = FALSE;
+}
+
+// Simulates the moves of the next battler that SetAiLogicDataForTurn left for later,
+// and once they are all done, predicts the move of the next player battler.
+// Returns FALSE if there was nothing left to do.
+bool32 SetAiLogicDataForNextBattler(struct AiLogicData *aiData)
+{
+    u32 battlerAtk, weather;
+
+    if (aiData->movesDataPending == 0 && aiData->predictionsPending == 0)
+        return FALSE;
 
+    gAiLogicData->aiCalcInProgress = TRUE;
+    if (DEBUG_AI_DELAY_TIMER)
+        CycleCountStart();
+    if (aiData->movesDataPending != 0)
+    {
+        for (battlerAtk = 0; !(aiData->movesDataPending & (1u << battlerAtk)); battlerAtk++)
+            ;
+        aiData->movesDataPending &= ~(1u << battlerAtk);
+        weather = AI_GetWeather();
+        SetBattlerAiMovesData(aiData, battlerAtk, gBattlersCount, weather, GetAiMovesDataFieldKey(aiData, weather));
+    }
+    else
+    {
+        for (battlerAtk = 0; !(aiData->predictionsPending & (1u << battlerAtk)); battlerAtk++)
+            ;
+        aiData->predictionsPending &= ~(1u << battlerAtk);
         // This can potentially be cleaned up more
         BattleAI_SetupAIData(0xF, battlerAtk);
         u32 chosenMoveIndex = ChooseMoveOrAction(battlerAtk);
@@ -684,9 +857,9 @@ void SetAiLogicDataForTurn(struct AiLogicData *aiData)
     }
 
     if (DEBUG_AI_DELAY_TIMER)
-        // We add to existing to compound multiple calls
         gBattleStruct->aiDelayCycles += CycleCountEnd();
     gAiLogicData->aiCalcInProgress = FALSE;
+    return TRUE;
 }
 
 u32 GetPartyMonAbility(struct Pokemon *mon)
@@ -712,6 +885,7 @@ static u32 PpStallReduction(u32 move, u32 battlerAtk)
         if (currentStallValue == 0 || GetMonData(&gPlayerParty[partyIndex], MON_DATA_HP) == 0)
             continue;
         PokemonToBattleMon(&gPlayerParty[partyIndex], &gBattleMons[tempBattleMonIndex]);
+        InvalidateBattlerAbilityCache();
         u32 species = GetMonData(&gPlayerParty[partyIndex], MON_DATA_SPECIES);
         u32 abilityAtk = ABILITY_NONE;
         u32 abilityDef = GetPartyMonAbility(&gPlayerParty[partyIndex]);
@@ -731,6 +905,7 @@ static u32 PpStallReduction(u32 move, u32 battlerAtk)
     }
 
     memcpy(&gBattleMons[tempBattleMonIndex], &backupBattleMon, sizeof(struct BattlePokemon));
+    InvalidateBattlerAbilityCache();
 
     return returnValue;
 }
@@ -980,8 +1155,9 @@ void BattleAI_DoAIProcessing_PredictedSwitchin(struct AiThinkingStruct *aiThink,
     // Get battler and move data for predicted switchin
     PokemonToBattleMon(&party[aiData->mostSuitableMonId[battlerDef]], &switchinCandidate);
     gBattleMons[battlerDef] = switchinCandidate;
+    InvalidateBattlerAbilityCache();
     SetBattlerAiData(battlerDef, aiData);
-    CalcBattlerAiMovesData(aiData, battlerAtk, battlerDef, AI_GetWeather());
+    CalcBattlerAiMovesData(aiData, battlerAtk, battlerDef, AI_GetWeather(), FALSE);
 
     // Regular processing with new battler
     do
@@ -1005,6 +1181,7 @@ void BattleAI_DoAIProcessing_PredictedSwitchin(struct AiThinkingStruct *aiThink,
 
                 // Restore old switchout data
                 gBattleMons[battlerDef] = switchoutCandidate;
+                InvalidateBattlerAbilityCache();
                 SetBattlerAiData(battlerDef, aiData);
                 aiData->simulatedDmg[battlerAtk][battlerDef][aiThink->movesetIndex] = simulatedDamageSwitchout[aiThink->movesetIndex];
                 aiData->effectiveness[battlerAtk][battlerDef][aiThink->movesetIndex] = effectivenessSwitchout[aiThink->movesetIndex];
@@ -1023,6 +1200,7 @@ void BattleAI_DoAIProcessing_PredictedSwitchin(struct AiThinkingStruct *aiThink,
 
                 // Restore new switchin data
                 gBattleMons[battlerDef] = switchinCandidate;
+                InvalidateBattlerAbilityCache();
                 SetBattlerAiData(battlerDef, aiData);
                 aiData->simulatedDmg[battlerAtk][battlerDef][aiThink->movesetIndex] = simulatedDamageSwitchin[aiThink->movesetIndex];
                 aiData->effectiveness[battlerAtk][battlerDef][aiThink->movesetIndex] = effectivenessSwitchin[aiThink->movesetIndex];
@@ -20,6 +20,7 @@
 #include "constants/battle_move_effects.h"
 #include "constants/items.h"
 #include "constants/moves.h"
+#include "test/test.h"
 
 // this file's functions
 static bool32 CanUseSuperEffectiveMoveAgainstOpponents(u32 battler);
@@ -33,10 +34,102 @@ static bool32 CanAbilityTrapOpponent(u16 ability, u32 opponent);
 static u32 GetHPHealAmount(u8 itemEffectParam, struct Pokemon *mon);
 static u32 GetBattleMonTypeMatchup(struct BattlePokemon opposingBattleMon, struct BattlePokemon battleMon);
 
-static void InitializeSwitchinCandidate(struct Pokemon *mon)
+static void InitializeSwitchinCandidate(struct Pokemon *party, u32 partyIndex)
 {
-    PokemonToBattleMon(mon, &gAiLogicData->switchinCandidate.battleMon);
+    PokemonToBattleMon(&party[partyIndex], &gAiLogicData->switchinCandidate.battleMon);
     gAiLogicData->switchinCandidate.hypotheticalStatus = FALSE;
+    gAiLogicData->switchinCandidate.partyIndex = partyIndex;
+}
+
+// Returns the switch-in candidate's matchup against opposingBattler, or NULL if it can't be reused.
+static struct AiSwitchinMatchup *GetSwitchinMatchup(u32 battler, u32 opposingBattler)
+{
+    struct AiSwitchinMatchup *matchup;
+
+    if (!gAiLogicData->switchinMatchupsActive)
+        return NULL;
+
+    matchup = &gAiLogicData->switchinMatchups[battler][gAiLogicData->switchinCandidate.partyIndex];
+    if (!matchup->isValid
+     || matchup->opposingBattler != opposingBattler
+     || matchup->status1 != gAiLogicData->switchinCandidate.battleMon.status1)
+    {
+        memset(matchup, 0, sizeof(*matchup));
+        matchup->status1 = gAiLogicData->switchinCandidate.battleMon.status1;
+        matchup->opposingBattler = opposingBattler;
+        matchup->isValid = TRUE;
+    }
+    return matchup;
+}
+
+// AI_CalcPartyMonDamage for the switch-in candidate, with battler's switch-in dealing the damage if calcContext is AI_ATTACKING.
+static s32 GetSwitchinDamage(u32 move, u32 battler, u32 opposingBattler, enum DamageCalcContext calcContext)
+{
+    struct AiSwitchinMatchup *matchup = GetSwitchinMatchup(battler, opposingBattler);
+    u32 battlerAtk = (calcContext == AI_ATTACKING) ? battler : opposingBattler;
+    u32 battlerDef = (calcContext == AI_ATTACKING) ? opposingBattler : battler;
+    u16 *moves = NULL, *damage = NULL;
+    u8 *count = NULL;
+    s32 dmg;
+    u32 i;
+
+    if (matchup != NULL)
+    {
+        moves = (calcContext == AI_ATTACKING) ? matchup->dealtMoves : matchup->takenMoves;
+        damage = (calcContext == AI_ATTACKING) ? matchup->dealtDamage : matchup->takenDamage;
+        count = (calcContext == AI_ATTACKING) ? &matchup->numDealt : &matchup->numTaken;
+        for (i = 0; i < *count; i++)
+        {
+            if (moves[i] != move)
+                continue;
+
+            if (TESTING && AI_CalcPartyMonDamage(move, battlerAtk, battlerDef, gAiLogicData->switchinCandidate.battleMon, calcContext) != damage[i])
+                Test_ExitWithResult(TEST_RESULT_ERROR, 0, ":L:%s:%d: switch-in damage of party mon %d is stale", __FILE__, __LINE__, gAiLogicData->switchinCandidate.partyIndex);
+            return damage[i];
+        }
+    }
+
+    dmg = AI_CalcPartyMonDamage(move, battlerAtk, battlerDef, gAiLogicData->switchinCandidate.battleMon, calcContext);
+    if (matchup != NULL && *count < MAX_MON_MOVES)
+    {
+        moves[*count] = move;
+        damage[*count] = dmg;
+        (*count)++;
+    }
+    return dmg;
+}
+
+// AI_IsPartyMonFaster for battler's switch-in candidate.
+static bool32 IsSwitchinFaster(u32 battler, u32 opposingBattler, u32 aiMove, u32 playerMove)
+{
+    struct AiSwitchinMatchup *matchup = GetSwitchinMatchup(battler, opposingBattler);
+    bool32 isFaster;
+    u32 i;
+
+    if (matchup != NULL)
+    {
+        for (i = 0; i < matchup->numSpeedOrders; i++)
+        {
+            if (matchup->speedOrderMoves[i][0] != aiMove || matchup->speedOrderMoves[i][1] != playerMove)
+                continue;
+
+            isFaster = (matchup->isFaster >> i) & 1;
+            if (TESTING && AI_IsPartyMonFaster(battler, opposingBattler, gAiLogicData->switchinCandidate.battleMon, aiMove, playerMove, CONSIDER_PRIORITY) != isFaster)
+                Test_ExitWithResult(TEST_RESULT_ERROR, 0, ":L:%s:%d: switch-in speed order of party mon %d is stale", __FILE__, __LINE__, gAiLogicData->switchinCandidate.partyIndex);
+            return isFaster;
+        }
+    }
+
+    isFaster = AI_IsPartyMonFaster(battler, opposingBattler, gAiLogicData->switchinCandidate.battleMon, aiMove, playerMove, CONSIDER_PRIORITY);
+    if (matchup != NULL && matchup->numSpeedOrders < AI_SWITCHIN_SPEED_ORDERS)
+    {
+        matchup->speedOrderMoves[matchup->numSpeedOrders][0] = aiMove;
+        matchup->speedOrderMoves[matchup->numSpeedOrders][1] = playerMove;
+        if (isFaster)
+            matchup->isFaster |= 1u << matchup->numSpeedOrders;
+        matchup->numSpeedOrders++;
+    }
+    return isFaster;
 }
 
 u32 GetSwitchChance(enum ShouldSwitchScenario shouldSwitchScenario)
@@ -1454,7 +1547,7 @@ static u32 GetBestMonTypeMatchup(struct Pokemon *party, int firstId, int lastId,
         {
             if (!((1u << i) & invalidMons) && !((1u << i) & bits))
             {
-                InitializeSwitchinCandidate(&party[i]);
+                InitializeSwitchinCandidate(party, i);
 
                 u32 typeEffectiveness = GetBattleMonTypeMatchup(gBattleMons[opposingBattler], gAiLogicData->switchinCandidate.battleMon);
                 if (typeEffectiveness < bestResist)
@@ -1502,14 +1595,14 @@ static u32 GetBestMonDmg(struct Pokemon *party, int firstId, int lastId, u8 inva
     {
         if ((1 << (i)) & invalidMons)
             continue;
-        InitializeSwitchinCandidate(&party[i]);
+        InitializeSwitchinCandidate(party, i);
         for (j = 0; j < MAX_MON_MOVES; j++)
         {
             aiMove = gAiLogicData->switchinCandidate.battleMon.moves[j];
             if (aiMove != MOVE_NONE && !IsBattleMoveStatus(aiMove))
             {
                 aiMove = GetMonData(&party[i], MON_DATA_MOVE1 + j);
-                dmg = AI_CalcPartyMonDamage(aiMove, battler, opposingBattler, gAiLogicData->switchinCandidate.battleMon, AI_ATTACKING);
+                dmg = GetSwitchinDamage(aiMove, battler, opposingBattler, AI_ATTACKING);
                 if (bestDmg < dmg)
                 {
                     bestDmg = dmg;
@@ -1980,7 +2073,7 @@ static int GetRandomSwitchinWithBatonPass(int aliveCount, int bits, int firstId,
         return PARTY_SIZE;
 }
 
-static s32 GetMaxDamagePlayerCouldDealToSwitchin(u32 battler, u32 opposingBattler, struct BattlePokemon battleMon, u32 *bestPlayerMove)
+static s32 GetMaxDamagePlayerCouldDealToSwitchin(u32 battler, u32 opposingBattler, u32 *bestPlayerMove)
 {
     int i = 0;
     u32 playerMove;
@@ -1992,7 +2085,7 @@ static s32 GetMaxDamagePlayerCouldDealToSwitchin(u32 battler, u32 opposingBattle
         playerMove = SMART_SWITCHING_OMNISCIENT ? gBattleMons[opposingBattler].moves[i] : playerMoves[i];
         if (playerMove != MOVE_NONE && !IsBattleMoveStatus(playerMove) && GetMoveEffect(playerMove) != EFFECT_FOCUS_PUNCH && gBattleMons[opposingBattler].pp[i] > 0)
         {
-            damageTaken = AI_CalcPartyMonDamage(playerMove, opposingBattler, battler, battleMon, AI_DEFENDING);
+            damageTaken = GetSwitchinDamage(playerMove, battler, opposingBattler, AI_DEFENDING);
             if (playerMove == gBattleStruct->choicedMove[opposingBattler]) // If player is choiced, only care about the choice locked move
                 return damageTaken;
             if (damageTaken > maxDamageTaken)
@@ -2005,7 +2098,7 @@ static s32 GetMaxDamagePlayerCouldDealToSwitchin(u32 battler, u32 opposingBattle
     return maxDamageTaken;
 }
 
-static s32 GetMaxPriorityDamagePlayerCouldDealToSwitchin(u32 battler, u32 opposingBattler, struct BattlePokemon battleMon, u32 *bestPlayerPriorityMove)
+static s32 GetMaxPriorityDamagePlayerCouldDealToSwitchin(u32 battler, u32 opposingBattler, u32 *bestPlayerPriorityMove)
 {
     int i = 0;
     u32 playerMove;
@@ -2018,7 +2111,7 @@ static s32 GetMaxPriorityDamagePlayerCouldDealToSwitchin(u32 battler, u32 opposi
         if (GetBattleMovePriority(opposingBattler, gAiLogicData->abilities[opposingBattler], playerMove) > 0
             && playerMove != MOVE_NONE && !IsBattleMoveStatus(playerMove) && GetMoveEffect(playerMove) != EFFECT_FOCUS_PUNCH && gBattleMons[opposingBattler].pp[i] > 0)
         {
-            damageTaken = AI_CalcPartyMonDamage(playerMove, opposingBattler, battler, battleMon, AI_DEFENDING);
+            damageTaken = GetSwitchinDamage(playerMove, battler, opposingBattler, AI_DEFENDING);
             if (playerMove == gBattleStruct->choicedMove[opposingBattler]) // If player is choiced, only care about the choice locked move
                 return damageTaken;
             if (damageTaken > maxDamageTaken)
@@ -2143,15 +2236,15 @@ static u32 GetBestMonIntegrated(struct Pokemon *party, int firstId, int lastId,
         else
             aliveCount++;
 
-        InitializeSwitchinCandidate(&party[i]);
+        InitializeSwitchinCandidate(party, i);
 
         // While not really invalid per se, not really wise to switch into this mon
         if (gAiLogicData->switchinCandidate.battleMon.ability == ABILITY_TRUANT && IsTruantMonVulnerable(battler, opposingBattler))
             continue;
 
         // Get max number of hits for player to KO AI mon and type matchup for defensive switching
-        hitsToKOAI = GetSwitchinHitsToKO(GetMaxDamagePlayerCouldDealToSwitchin(battler, opposingBattler, gAiLogicData->switchinCandidate.battleMon, &bestPlayerMove), battler);
-        hitsToKOAIPriority = GetSwitchinHitsToKO(GetMaxPriorityDamagePlayerCouldDealToSwitchin(battler, opposingBattler, gAiLogicData->switchinCandidate.battleMon, &bestPlayerPriorityMove), battler);
+        hitsToKOAI = GetSwitchinHitsToKO(GetMaxDamagePlayerCouldDealToSwitchin(battler, opposingBattler, &bestPlayerMove), battler);
+        hitsToKOAIPriority = GetSwitchinHitsToKO(GetMaxPriorityDamagePlayerCouldDealToSwitchin(battler, opposingBattler, &bestPlayerPriorityMove), battler);
         typeMatchup = GetBattleMonTypeMatchup(gBattleMons[opposingBattler], gAiLogicData->switchinCandidate.battleMon);
 
         // Check through current mon's moves
@@ -2162,12 +2255,12 @@ static u32 GetBestMonIntegrated(struct Pokemon *party, int firstId, int lastId,
                 continue;
 
             aiMove = gAiLogicData->switchinCandidate.battleMon.moves[j];
-            damageDealt = AI_CalcPartyMonDamage(aiMove, battler, opposingBattler, gAiLogicData->switchinCandidate.battleMon, AI_ATTACKING);
+            damageDealt = GetSwitchinDamage(aiMove, battler, opposingBattler, AI_ATTACKING);
             hitsToKOPlayer = GetNoOfHitsToKOBattlerDmg(damageDealt, opposingBattler);
 
             // Offensive switchin decisions are based on which whether switchin moves first and whether it can win a 1v1
-            isSwitchinFirst = AI_IsPartyMonFaster(battler, opposingBattler, gAiLogicData->switchinCandidate.battleMon, aiMove, bestPlayerMove, CONSIDER_PRIORITY);
-            isSwitchinFirstPriority = AI_IsPartyMonFaster(battler, opposingBattler, gAiLogicData->switchinCandidate.battleMon, aiMove, bestPlayerPriorityMove, CONSIDER_PRIORITY);
+            isSwitchinFirst = IsSwitchinFaster(battler, opposingBattler, aiMove, bestPlayerMove);
+            isSwitchinFirstPriority = IsSwitchinFaster(battler, opposingBattler, aiMove, bestPlayerPriorityMove);
             canSwitchinWin1v1 = CanSwitchinWin1v1(hitsToKOAI, hitsToKOPlayer, isSwitchinFirst, isFreeSwitch) && CanSwitchinWin1v1(hitsToKOAIPriority, hitsToKOPlayer, isSwitchinFirstPriority, isFreeSwitch); // AI must successfully 1v1 with and without priority to be considered a good option
 
             // Check for Baton Pass; hitsToKO requirements mean mon can boost and BP without dying whether it's slower or not
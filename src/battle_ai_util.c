@@ -424,6 +424,7 @@ void SetBattlerData(u32 battlerId)
         // The ability is unknown.
         else
             gBattleMons[battlerId].ability = ABILITY_NONE;
+        InvalidateBattlerAbilityCache();
 
         if (gAiPartyData->mons[side][gBattlerPartyIndexes[battlerId]].heldEffect == 0)
             gBattleMons[battlerId].item = 0;
@@ -444,6 +445,7 @@ void RestoreBattlerData(u32 battlerId)
 
         gAiThinkingStruct->saved[battlerId].saved = FALSE;
         gBattleMons[battlerId].ability = gAiThinkingStruct->saved[battlerId].ability;
+        InvalidateBattlerAbilityCache();
         gBattleMons[battlerId].item = gAiThinkingStruct->saved[battlerId].heldItem;
         gBattleMons[battlerId].species = gAiThinkingStruct->saved[battlerId].species;
         for (i = 0; i < 4; i++)
@@ -4216,6 +4218,7 @@ void FreeRestoreBattleMons(struct BattlePokemon *savedBattleMons)
 {
     memcpy(gBattleMons, savedBattleMons, SIZE_G_BATTLE_MONS);
     Free(savedBattleMons);
+    InvalidateBattlerAbilityCache();
 }
 
 // party logic
@@ -4228,6 +4231,7 @@ s32 AI_CalcPartyMonDamage(u32 move, u32 battlerAtk, u32 battlerDef, struct Battl
     if (calcContext == AI_ATTACKING)
     {
         gBattleMons[battlerAtk] = switchinCandidate;
+        InvalidateBattlerAbilityCache();
         gAiThinkingStruct->saved[battlerDef].saved = TRUE;
         SetBattlerAiData(battlerAtk, gAiLogicData); // set known opposing battler data
         gAiThinkingStruct->saved[battlerDef].saved = FALSE;
@@ -4235,6 +4239,7 @@ s32 AI_CalcPartyMonDamage(u32 move, u32 battlerAtk, u32 battlerDef, struct Battl
     else if (calcContext == AI_DEFENDING)
     {
         gBattleMons[battlerDef] = switchinCandidate;
+        InvalidateBattlerAbilityCache();
         gAiThinkingStruct->saved[battlerAtk].saved = TRUE;
         SetBattlerAiData(battlerDef, gAiLogicData); // set known opposing battler data
         gAiThinkingStruct->saved[battlerAtk].saved = FALSE;
@@ -4273,6 +4278,7 @@ u32 AI_WhoStrikesFirstPartyMon(u32 battlerAtk, u32 battlerDef, struct BattlePoke
 {
     struct BattlePokemon *savedBattleMons = AllocSaveBattleMons();
     gBattleMons[battlerAtk] = switchinCandidate;
+    InvalidateBattlerAbilityCache();
 
     SetBattlerAiData(battlerAtk, gAiLogicData);
     u32 aiWhoStrikesFirst = AI_WhoStrikesFirst(battlerAtk, battlerDef, aiMoveConsidered, playerMoveConsidered, considerPriority);
@@ -1385,6 +1385,7 @@ static u32 GetBattlerMonData(u32 battler, struct Pokemon *party, u32 monId, u8 *
             u32 partyIndex = gBattlerPartyIndexes[battler];
             if (TestRunner_Battle_GetForcedAbility(side, partyIndex))
                 gBattleMons[battler].ability = TestRunner_Battle_GetForcedAbility(side, partyIndex);
+            InvalidateBattlerAbilityCache();
         }
         #endif
         break;
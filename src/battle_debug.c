@@ -1623,6 +1623,7 @@ static void UpdateBattlerValue(struct BattleDebugMenu *data)
         }
         break;
     }
+    InvalidateBattlerAbilityCache();
     data->battlerWasChanged[data->battlerId] = TRUE;
 }
 
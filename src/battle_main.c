@@ -3286,6 +3286,7 @@ void SwitchInClearSetData(u32 battler, struct Volatiles *volatilesCopy)
     }
     #endif // TESTING
 
+    InvalidateBattlerAbilityCache();
     Ai_UpdateSwitchInData(battler);
 }
 
@@ -3479,6 +3480,7 @@ static void DoBattleIntro(void)
             else
             {
                 memcpy(&gBattleMons[battler], &gBattleResources->bufferB[battler][4], sizeof(struct BattlePokemon));
+                InvalidateBattlerAbilityCache();
                 gBattleMons[battler].types[0] = GetSpeciesType(gBattleMons[battler].species, 0);
                 gBattleMons[battler].types[1] = GetSpeciesType(gBattleMons[battler].species, 1);
                 gBattleMons[battler].types[2] = TYPE_MYSTERY;
@@ -3791,6 +3793,7 @@ static void TryDoEventsBeforeFirstTurn(void)
                 if (TestRunner_Battle_GetForcedAbility(side, partyIndex))
                     gBattleMons[i].ability = TestRunner_Battle_GetForcedAbility(side, partyIndex);
             }
+            InvalidateBattlerAbilityCache();
         }
         #endif // TESTING
 
@@ -4168,21 +4171,53 @@ enum
     STATE_SELECTION_SCRIPT_MAY_RUN
 };
 
+static u32 GetAiDecisionsPerFrame(void)
+{
+    if (TESTING && TestRunner_Battle_GetAiDecisionsPerFrame() != 0)
+        return TestRunner_Battle_GetAiDecisionsPerFrame();
+    return AI_DECISIONS_PER_FRAME;
+}
+
 static void HandleTurnActionSelectionState(void)
 {
     s32 i, battler;
+    u32 aiDecisions = 0, aiDecisionsPerFrame = GetAiDecisionsPerFrame();
 
     gBattleCommunication[ACTIONS_CONFIRMED_COUNT] = 0;
+
+    // The AI's work at the start of a turn is spread over several frames so that it doesn't stall
+    // the game: first simulating each battler's moves, then computing each battler's decisions.
+    // No battler chooses its action until all of it is done. Choosing used to be interleaved with
+    // the decisions, but the only thing it changed that the AI reads is monToSwitchIntoId, which
+    // is reset here in the same order. So the decisions are the same as if they had all been made
+    // in one frame.
+    while (gAiLogicData->movesDataPending != 0 || gAiLogicData->predictionsPending != 0)
+    {
+        if (aiDecisions >= aiDecisionsPerFrame)
+            return;
+        SetAiLogicDataForNextBattler(gAiLogicData);
+        aiDecisions++;
+    }
+
+    for (battler = 0; battler < gBattlersCount; battler++)
+    {
+        if (gBattleCommunication[battler] != STATE_TURN_START_RECORD)
+            continue;
+        if (aiDecisions >= aiDecisionsPerFrame)
+            return;
+
+        RecordedBattle_CopyBattlerMoves(battler); // Recorded battle related action on start of every turn.
+        gBattleCommunication[battler] = STATE_BEFORE_ACTION_CHOSEN;
+        if (ComputeBattlerDecisions(battler)) // Do AI score computations here so we can use them in AI_TrySwitchOrUseItem
+            aiDecisions++;
+        gBattleStruct->monToSwitchIntoId[battler] = PARTY_SIZE;
+    }
+
     for (battler = 0; battler < gBattlersCount; battler++)
     {
         u32 position = GetBattlerPosition(battler);
         switch (gBattleCommunication[battler])
         {
-        case STATE_TURN_START_RECORD: // Recorded battle related action on start of every turn.
-            RecordedBattle_CopyBattlerMoves(battler);
-            gBattleCommunication[battler] = STATE_BEFORE_ACTION_CHOSEN;
-            ComputeBattlerDecisions(battler); // Do AI score computations here so we can use them in AI_TrySwitchOrUseItem
-            // fallthrough
         case STATE_BEFORE_ACTION_CHOSEN: // Choose an action.
             gBattleStruct->monToSwitchIntoId[battler] = PARTY_SIZE;
             if (gBattleTypeFlags & BATTLE_TYPE_MULTI
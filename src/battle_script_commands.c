@@ -11182,6 +11182,7 @@ static void Cmd_transformdataexecution(void)
 
         for (i = 0; i < offsetof(struct BattlePokemon, pp); i++)
             battleMonAttacker[i] = battleMonTarget[i];
+        InvalidateBattlerAbilityCache();
 
         gDisableStructs[gBattlerAttacker].overwrittenAbility = GetBattlerAbility(gBattlerTarget);
         for (i = 0; i < MAX_MON_MOVES; i++)
@@ -12943,6 +12944,7 @@ static void Cmd_trycopyability(void)
         gBattleScripting.abilityPopupOverwrite = gBattleMons[battler].ability;
         gBattleMons[battler].ability = gDisableStructs[battler].overwrittenAbility = defAbility;
         gLastUsedAbility = defAbility;
+        InvalidateBattlerAbilityCache();
         gBattlescriptCurrInstr = cmd->nextInstr;
     }
 }
@@ -13117,6 +13119,7 @@ static void Cmd_tryswapabilities(void)
             gLastUsedAbility = gBattleMons[gBattlerTarget].ability;
             gBattleMons[gBattlerTarget].ability = gDisableStructs[gBattlerTarget].overwrittenAbility = gBattleMons[gBattlerAttacker].ability;
             gBattleMons[gBattlerAttacker].ability = gDisableStructs[gBattlerAttacker].overwrittenAbility = gLastUsedAbility;
+            InvalidateBattlerAbilityCache();
 
             gBattlescriptCurrInstr = cmd->nextInstr;
         }
@@ -15086,6 +15089,7 @@ void BS_ItemRestoreHP(void)
                 gAbsentBattlerFlags &= ~(1u << battler);
                 gBattleMons[battler].hp = hp;
                 gBattleCommunication[MULTIUSE_STATE] = TRUE;
+                InvalidateBattlerAbilityCache();
             }
             gBattlescriptCurrInstr = cmd->nextInstr;
         }
@@ -16856,6 +16860,7 @@ void BS_SetTracedAbility(void)
     NATIVE_ARGS(u8 battler);
     u32 battler = GetBattlerForBattleScript(cmd->battler);
     gBattleMons[battler].ability = gDisableStructs[battler].overwrittenAbility = gBattleStruct->tracedAbility[battler];
+    InvalidateBattlerAbilityCache();
     gBattlescriptCurrInstr = cmd->nextInstr;
 }
 
@@ -17416,6 +17421,7 @@ void BS_TryEntrainment(void)
         else
         {
             gBattleMons[gBattlerTarget].ability = gDisableStructs[gBattlerTarget].overwrittenAbility = gBattleMons[gBattlerAttacker].ability;
+            InvalidateBattlerAbilityCache();
             gBattlescriptCurrInstr = cmd->nextInstr;
         }
     }
@@ -1261,12 +1261,14 @@ void UpdateSentPokesToOpponentValue(u32 battler)
 
 void BattleScriptPush(const u8 *bsPtr)
 {
+    if (gTestRunnerEnabled && gBattleResources->battleScriptsStack->size >= ARRAY_COUNT(gBattleResources->battleScriptsStack->ptr))
+        TestRunner_Battle_ScriptsStackOverflow(bsPtr);
     gBattleResources->battleScriptsStack->ptr[gBattleResources->battleScriptsStack->size++] = bsPtr;
 }
 
 void BattleScriptPushCursor(void)
 {
-    gBattleResources->battleScriptsStack->ptr[gBattleResources->battleScriptsStack->size++] = gBattlescriptCurrInstr;
+    BattleScriptPush(gBattlescriptCurrInstr);
 }
 
 void BattleScriptCall(const u8 *bsPtr)
@@ -4562,6 +4564,7 @@ u32 AbilityBattleEffects(u32 caseID, u32 battler, u32 ability, u32 special, u32
 
                 gLastUsedAbility = gBattleMons[gBattlerAttacker].ability;
                 gBattleMons[gBattlerAttacker].ability = gDisableStructs[gBattlerAttacker].overwrittenAbility = gBattleMons[gBattlerTarget].ability;
+                InvalidateBattlerAbilityCache();
                 BattleScriptCall(BattleScript_MummyActivates);
                 effect++;
                 break;
@@ -4588,6 +4591,7 @@ u32 AbilityBattleEffects(u32 caseID, u32 battler, u32 ability, u32 special, u32
                 gLastUsedAbility = gBattleMons[gBattlerAttacker].ability;
                 gBattleMons[gBattlerAttacker].ability = gDisableStructs[gBattlerAttacker].overwrittenAbility = gBattleMons[gBattlerTarget].ability;
                 gBattleMons[gBattlerTarget].ability = gDisableStructs[gBattlerTarget].overwrittenAbility = gLastUsedAbility;
+                InvalidateBattlerAbilityCache();
                 BattleScriptCall(BattleScript_WanderingSpiritActivates);
                 effect++;
                 break;
@@ -5366,17 +5370,23 @@ bool32 TryPrimalReversion(u32 battler)
     return FALSE;
 }
 
-bool32 IsNeutralizingGasOnField(void)
+// Returns 1 + the first battler whose Neutralizing Gas is active, or 0 if there is none.
+static u32 GetNeutralizingGasBattler(void)
 {
     u32 i;
 
     for (i = 0; i < gBattlersCount; i++)
     {
         if (IsBattlerAlive(i) && gBattleMons[i].ability == ABILITY_NEUTRALIZING_GAS && !gBattleMons[i].volatiles.gastroAcid)
-            return TRUE;
+            return i + 1;
     }
 
-    return FALSE;
+    return 0;
+}
+
+bool32 IsNeutralizingGasOnField(void)
+{
+    return GetNeutralizingGasBattler() != 0;
 }
 
 bool32 IsMoldBreakerTypeAbility(u32 battler, u32 ability)
@@ -5424,34 +5434,116 @@ u32 GetBattlerAbility(u32 battler)
     return GetBattlerAbilityInternal(battler, FALSE, FALSE);
 }
 
-u32 GetBattlerAbilityInternal(u32 battler, u32 ignoreMoldBreaker, u32 noAbilityShield)
+#define ABILITY_CACHE_VALID          (1 << 0)
+#define ABILITY_CACHE_GASTRO_ACID    (1 << 1)
+#define ABILITY_CACHE_TRANSFORMED    (1 << 2)
+#define ABILITY_CACHE_EMBARGO        (1 << 3)
+#define ABILITY_CACHE_MAGIC_ROOM     (1 << 4)
+
+static u32 GetAbilityCacheState(u32 battler)
 {
-    bool32 hasAbilityShield = !noAbilityShield && GetBattlerHoldEffectIgnoreAbility(battler, TRUE) == HOLD_EFFECT_ABILITY_SHIELD;
-    bool32 abilityCantBeSuppressed = gAbilitiesInfo[gBattleMons[battler].ability].cantBeSuppressed;
+    u32 state = ABILITY_CACHE_VALID;
+
+    if (gBattleMons[battler].volatiles.gastroAcid)
+        state |= ABILITY_CACHE_GASTRO_ACID;
+    if (gBattleMons[battler].volatiles.transformed)
+        state |= ABILITY_CACHE_TRANSFORMED;
+    if (gBattleMons[battler].volatiles.embargo)
+        state |= ABILITY_CACHE_EMBARGO;
+    if (gFieldStatuses & STATUS_FIELD_MAGIC_ROOM)
+        state |= ABILITY_CACHE_MAGIC_ROOM;
+    return state;
+}
+
+// Everything GetBattlerAbilityInternal checks except Mold Breaker, which depends on the move being used.
+static void ResolveBattlerAbility(struct AbilityCache *cache, u32 battler, u32 noAbilityShield)
+{
+    u32 ability = gBattleMons[battler].ability;
+
+    cache->epoch = gBattleStruct->abilityCacheEpoch;
+    cache->ability = ability;
+    cache->item = gBattleMons[battler].item;
+    cache->state = GetAbilityCacheState(battler);
+    cache->gasBattler = 0;
+    cache->suppressed = FALSE;
+    cache->hasAbilityShield = !noAbilityShield && GetBattlerHoldEffectIgnoreAbility(battler, TRUE) == HOLD_EFFECT_ABILITY_SHIELD;
 
-    if (abilityCantBeSuppressed)
+    if (gAbilitiesInfo[ability].cantBeSuppressed)
     {
         // Edge case: pokemon under the effect of gastro acid transforms into a pokemon with Comatose (Todo: verify how other unsuppressable abilities behave)
         if (gBattleMons[battler].volatiles.transformed
             && gBattleMons[battler].volatiles.gastroAcid
-            && gBattleMons[battler].ability == ABILITY_COMATOSE)
-                return ABILITY_NONE;
+            && ability == ABILITY_COMATOSE)
+                cache->suppressed = TRUE;
+    }
+    else if (gBattleMons[battler].volatiles.gastroAcid)
+    {
+        cache->suppressed = TRUE;
+    }
+    else if (!cache->hasAbilityShield && ability != ABILITY_NEUTRALIZING_GAS)
+    {
+        cache->gasBattler = GetNeutralizingGasBattler();
+        cache->suppressed = (cache->gasBattler != 0);
+    }
+}
+
+static bool32 IsAbilityCacheValid(struct AbilityCache *cache, u32 battler, u32 state)
+{
+    u32 gasBattler;
 
-        if (CanBreakThroughAbility(gBattlerAttacker, battler, gBattleMons[gBattlerAttacker].ability, hasAbilityShield, ignoreMoldBreaker))
-            return ABILITY_NONE;
+    if (cache->state != state
+     || cache->epoch != gBattleStruct->abilityCacheEpoch
+     || cache->ability != gBattleMons[battler].ability
+     || cache->item != gBattleMons[battler].item)
+        return FALSE;
 
-        return gBattleMons[battler].ability;
+    // Neutralizing Gas can stop without an invalidation, e.g. if its user faints.
+    if (cache->gasBattler != 0)
+    {
+        gasBattler = cache->gasBattler - 1;
+        if (!IsBattlerAlive(gasBattler)
+         || gBattleMons[gasBattler].ability != ABILITY_NEUTRALIZING_GAS
+         || gBattleMons[gasBattler].volatiles.gastroAcid)
+            return FALSE;
     }
+    return TRUE;
+}
 
-    if (gBattleMons[battler].volatiles.gastroAcid)
-        return ABILITY_NONE;
+// Call when a battler may have started to have Neutralizing Gas, e.g. on a switch-in or an ability change.
+// Changes to a battler's own ability, item or volatiles don't need it.
+void InvalidateBattlerAbilityCache(void)
+{
+    if (gBattleStruct != NULL)
+        gBattleStruct->abilityCacheEpoch++;
+}
 
-    if (!hasAbilityShield
-     && IsNeutralizingGasOnField()
-     && gBattleMons[battler].ability != ABILITY_NEUTRALIZING_GAS)
+u32 GetBattlerAbilityInternal(u32 battler, u32 ignoreMoldBreaker, u32 noAbilityShield)
+{
+    struct AbilityCache *cache = &gBattleStruct->abilityCache[battler][noAbilityShield != FALSE];
+    u32 state = GetAbilityCacheState(battler);
+
+    if (!IsAbilityCacheValid(cache, battler, state))
+    {
+        ResolveBattlerAbility(cache, battler, noAbilityShield);
+    }
+    else
+    {
+        // Checking for Ability Shield sets this, see GetBattlerHoldEffectInternal.
+        if (!noAbilityShield && !(state & (ABILITY_CACHE_EMBARGO | ABILITY_CACHE_MAGIC_ROOM)))
+            gPotentialItemEffectBattler = battler;
+
+    #if TESTING
+        struct AbilityCache resolved;
+        ResolveBattlerAbility(&resolved, battler, noAbilityShield);
+        if (resolved.suppressed != cache->suppressed || resolved.hasAbilityShield != cache->hasAbilityShield)
+            TestRunner_Battle_StaleAbilityCache(battler);
+    #endif // TESTING
+    }
+
+    if (cache->suppressed)
         return ABILITY_NONE;
 
-    if (CanBreakThroughAbility(gBattlerAttacker, battler, gBattleMons[gBattlerAttacker].ability, hasAbilityShield, ignoreMoldBreaker))
+    if (CanBreakThroughAbility(gBattlerAttacker, battler, gBattleMons[gBattlerAttacker].ability, cache->hasAbilityShield, ignoreMoldBreaker))
         return ABILITY_NONE;
 
     return gBattleMons[battler].ability;
@@ -9696,17 +9788,84 @@ void UpdateMoveResultFlags(uq4_12_t modifier, u16 *resultFlags)
     }
 }
 
+// Whether MulByTypeEffectiveness would only apply the type chart for this move and defender.
+static bool32 CanUseBattlerTypeEffectiveness(struct DamageContext *ctx, u32 types[static 3])
+{
+    if (ctx->holdEffectDef == HOLD_EFFECT_RING_TARGET
+     || ctx->abilityDef == ABILITY_TERA_SHELL
+     || gSpecialStatuses[ctx->battlerDef].distortedTypeMatchups
+     || GetMoveEffect(ctx->move) == EFFECT_SUPER_EFFECTIVE_ON_ARG
+     || (gBattleWeather & B_WEATHER_STRONG_WINDS && HasWeatherEffect()))
+        return FALSE;
+
+    switch (ctx->moveType)
+    {
+    case TYPE_NORMAL:
+    case TYPE_FIGHTING:
+        return !gBattleMons[ctx->battlerDef].volatiles.foresight
+            && ctx->abilityAtk != ABILITY_SCRAPPY
+            && ctx->abilityAtk != ABILITY_MINDS_EYE;
+    case TYPE_PSYCHIC:
+        return !gBattleMons[ctx->battlerDef].volatiles.miracleEye;
+    case TYPE_GROUND:
+        return types[0] != TYPE_FLYING && types[1] != TYPE_FLYING && types[2] != TYPE_FLYING;
+    case TYPE_STELLAR:
+        return FALSE;
+    default:
+        return TRUE;
+    }
+}
+
+// Returns the type chart multiplier of moveType against types, which are battlerDef's.
+static uq4_12_t GetBattlerTypeEffectiveness(u32 battlerDef, u32 moveType, u32 types[static 3])
+{
+    struct TypeEffectivenessCache *cache = &gBattleStruct->typeEffectiveness[battlerDef];
+    bool32 isInverse = B_FLAG_INVERSE_BATTLE != 0 && FlagGet(B_FLAG_INVERSE_BATTLE);
+
+    if (!cache->isValid
+     || cache->isInverse != isInverse
+     || cache->types[0] != types[0]
+     || cache->types[1] != types[1]
+     || cache->types[2] != types[2])
+    {
+        u32 atkType;
+        for (atkType = 0; atkType < NUMBER_OF_MON_TYPES; atkType++)
+        {
+            uq4_12_t modifier = GetTypeModifier(atkType, types[0]);
+            if (types[1] != types[0])
+                modifier = uq4_12_multiply(modifier, GetTypeModifier(atkType, types[1]));
+            if (types[2] != TYPE_MYSTERY && types[2] != types[1] && types[2] != types[0])
+                modifier = uq4_12_multiply(modifier, GetTypeModifier(atkType, types[2]));
+            cache->modifiers[atkType] = modifier;
+        }
+        cache->types[0] = types[0];
+        cache->types[1] = types[1];
+        cache->types[2] = types[2];
+        cache->isInverse = isInverse;
+        cache->isValid = TRUE;
+    }
+
+    return cache->modifiers[moveType];
+}
+
 static inline uq4_12_t CalcTypeEffectivenessMultiplierInternal(struct DamageContext *ctx, uq4_12_t modifier)
 {
     u32 illusionSpecies;
     u32 types[3];
     GetBattlerTypes(ctx->battlerDef, FALSE, types);
 
-    MulByTypeEffectiveness(ctx, &modifier, types[0]);
-    if (types[1] != types[0])
-        MulByTypeEffectiveness(ctx, &modifier, types[1]);
-    if (types[2] != TYPE_MYSTERY && types[2] != types[1] && types[2] != types[0])
-        MulByTypeEffectiveness(ctx, &modifier, types[2]);
+    if (CanUseBattlerTypeEffectiveness(ctx, types))
+    {
+        modifier = uq4_12_multiply(modifier, GetBattlerTypeEffectiveness(ctx->battlerDef, ctx->moveType, types));
+    }
+    else
+    {
+        MulByTypeEffectiveness(ctx, &modifier, types[0]);
+        if (types[1] != types[0])
+            MulByTypeEffectiveness(ctx, &modifier, types[1]);
+        if (types[2] != TYPE_MYSTERY && types[2] != types[1] && types[2] != types[0])
+            MulByTypeEffectiveness(ctx, &modifier, types[2]);
+    }
     if (ctx->moveType == TYPE_FIRE && gDisableStructs[ctx->battlerDef].tarShot)
         modifier = uq4_12_multiply(modifier, UQ_4_12(2.0));
 
@@ -10929,6 +11088,7 @@ void CopyMonAbilityAndTypesToBattleMon(u32 battler, struct Pokemon *mon)
     gBattleMons[battler].types[0] = GetSpeciesType(gBattleMons[battler].species, 0);
     gBattleMons[battler].types[1] = GetSpeciesType(gBattleMons[battler].species, 1);
     gBattleMons[battler].types[2] = TYPE_MYSTERY;
+    InvalidateBattlerAbilityCache();
 }
 
 void RecalcBattlerStats(u32 battler, struct Pokemon *mon, bool32 isDynamaxing)
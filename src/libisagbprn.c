@@ -227,6 +227,12 @@ void MgbaClose(void)
 void MgbaPrintf(s32 level, const char *ptr, ...)
 {
     va_list args;
+#if TESTING
+    // The test runner's profiler sends its samples from a Timer1
+    // interrupt, so hold them off until this line is sent.
+    u16 profileIntr = REG_IE & INTR_FLAG_TIMER1;
+    REG_IE &= ~INTR_FLAG_TIMER1;
+#endif
 
     level &= 0x7;
     va_start(args, ptr);
@@ -239,6 +245,9 @@ void MgbaPrintf(s32 level, const char *ptr, ...)
     #endif
     va_end(args);
     *REG_DEBUG_FLAGS = level | 0x100;
+#if TESTING
+    REG_IE |= profileIntr;
+#endif
 }
 
 void MgbaAssert(const char *pFile, s32 nLine, const char *pExpression, bool32 nStopProgram)
@@ -0,0 +1,48 @@
+#include "global.h"
+#include "test/battle.h"
+#include "battle_ai_util.h"
+
+// UINT8_MAX makes the AI do all of its work at the start of a turn in one frame.
+
+AI_DOUBLE_BATTLE_TEST("AI makes the same decisions when its work is spread over frames (recharging or locked partner)")
+{
+    u32 move, decisionsPerFrame;
+
+    PARAMETRIZE { move = MOVE_HYPER_BEAM; decisionsPerFrame = 1; }
+    PARAMETRIZE { move = MOVE_HYPER_BEAM; decisionsPerFrame = UINT8_MAX; }
+    PARAMETRIZE { move = MOVE_OUTRAGE;    decisionsPerFrame = 1; }
+    PARAMETRIZE { move = MOVE_OUTRAGE;    decisionsPerFrame = UINT8_MAX; }
+
+    GIVEN {
+        ASSUME(MoveHasAdditionalEffectSelf(MOVE_HYPER_BEAM, MOVE_EFFECT_RECHARGE) == TRUE);
+        ASSUME(MoveHasAdditionalEffectSelf(MOVE_OUTRAGE, MOVE_EFFECT_THRASH) == TRUE);
+        AI_FLAGS(AI_FLAG_CHECK_BAD_MOVE | AI_FLAG_CHECK_VIABILITY | AI_FLAG_TRY_TO_FAINT);
+        AIDecisionsPerFrame(decisionsPerFrame);
+        PLAYER(SPECIES_WOBBUFFET) { Moves(MOVE_CELEBRATE); }
+        PLAYER(SPECIES_WOBBUFFET) { Moves(MOVE_CELEBRATE); }
+        OPPONENT(SPECIES_WOBBUFFET) { Moves(move); }
+        OPPONENT(SPECIES_WOBBUFFET) { Moves(MOVE_CELEBRATE, MOVE_SCRATCH); }
+    } WHEN {
+        TURN { MOVE(playerLeft, MOVE_CELEBRATE); MOVE(playerRight, MOVE_CELEBRATE); EXPECT_MOVE(opponentLeft, move); EXPECT_MOVE(opponentRight, MOVE_SCRATCH); }
+        TURN { MOVE(playerLeft, MOVE_CELEBRATE); MOVE(playerRight, MOVE_CELEBRATE); EXPECT_MOVE(opponentRight, MOVE_SCRATCH); }
+    }
+}
+
+AI_SINGLE_BATTLE_TEST("AI predicts the player's move the same way when its work is spread over frames")
+{
+    u32 decisionsPerFrame;
+
+    PARAMETRIZE { decisionsPerFrame = 1; }
+    PARAMETRIZE { decisionsPerFrame = UINT8_MAX; }
+
+    PASSES_RANDOMLY(PREDICT_MOVE_CHANCE, 100, RNG_AI_PREDICT_MOVE);
+    GIVEN {
+        AI_FLAGS(AI_FLAG_CHECK_BAD_MOVE | AI_FLAG_TRY_TO_FAINT | AI_FLAG_CHECK_VIABILITY | AI_FLAG_OMNISCIENT | AI_FLAG_SMART_SWITCHING | AI_FLAG_SMART_MON_CHOICES | AI_FLAG_PREDICT_MOVE);
+        AIDecisionsPerFrame(decisionsPerFrame);
+        PLAYER(SPECIES_VAPOREON) { Ability(ABILITY_WATER_ABSORB); Moves(MOVE_SURF, MOVE_TACKLE); }
+        OPPONENT(SPECIES_NUMEL) { Moves(MOVE_TACKLE); }
+        OPPONENT(SPECIES_VAPOREON) { Ability(ABILITY_WATER_ABSORB); Moves(MOVE_TACKLE); }
+    } WHEN {
+        TURN { MOVE(player, MOVE_SURF); EXPECT_SWITCH(opponent, 1); }
+    }
+}
@@ -287,6 +287,29 @@ AI_SINGLE_BATTLE_TEST("AI_FLAG_SMART_MON_CHOICES: AI considers hazard damage whe
     }
 }
 
+AI_SINGLE_BATTLE_TEST("AI_FLAG_SMART_MON_CHOICES: AI's switch-in damage calcs aren't reused across the status it expects from Toxic Spikes")
+{
+    u32 species, ability, move;
+
+    PARAMETRIZE { species = SPECIES_MACHAMP; ability = ABILITY_GUTS;         move = MOVE_FACADE; }
+    PARAMETRIZE { species = SPECIES_MILOTIC; ability = ABILITY_MARVEL_SCALE; move = MOVE_SURF; }
+
+    GIVEN {
+        ASSUME(GetMoveEffect(MOVE_TOXIC_SPIKES) == EFFECT_TOXIC_SPIKES);
+        ASSUME(GetMovePriority(MOVE_QUICK_ATTACK) > 0);
+        AI_FLAGS(AI_FLAG_CHECK_BAD_MOVE | AI_FLAG_CHECK_VIABILITY | AI_FLAG_TRY_TO_FAINT | AI_FLAG_SMART_SWITCHING | AI_FLAG_SMART_MON_CHOICES);
+        PLAYER(SPECIES_WEAVILE) { Moves(MOVE_TOXIC_SPIKES, MOVE_QUICK_ATTACK, MOVE_FACADE); }
+        OPPONENT(SPECIES_WOBBUFFET) { Moves(MOVE_SCRATCH); }
+        OPPONENT(species) { Ability(ability); Moves(move); }
+    } WHEN {
+        // The second turn's switch-in calcs give the candidate a hypothetical poison status
+        // partway through, which changes the damage it deals and takes.
+        TURN { MOVE(player, MOVE_TOXIC_SPIKES); }
+        TURN { MOVE(player, MOVE_TOXIC_SPIKES); }
+        TURN { MOVE(player, MOVE_QUICK_ATTACK); }
+    }
+}
+
 AI_SINGLE_BATTLE_TEST("AI_FLAG_SMART_MON_CHOICES: Mid-battle switches prioritize type matchup + SE move, then type matchup")
 {
     u32 aiSmartSwitchFlags = 0;
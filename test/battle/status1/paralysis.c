@@ -45,6 +45,21 @@ SINGLE_BATTLE_TEST("Paralysis has a 25% chance of skipping the turn")
     }
 }
 
+SINGLE_BATTLE_TEST("Paralysis has a 25% chance of skipping each turn")
+{
+    PASSES_RANDOMLY(1, 16, RNG_PARALYSIS, .independent = TRUE);
+    GIVEN {
+        PLAYER(SPECIES_WOBBUFFET) { Status1(STATUS1_PARALYSIS); }
+        OPPONENT(SPECIES_WOBBUFFET);
+    } WHEN {
+        TURN { MOVE(player, MOVE_CELEBRATE); }
+        TURN { MOVE(player, MOVE_CELEBRATE); }
+    } SCENE {
+        MESSAGE("Wobbuffet couldn't move because it's paralyzed!");
+        MESSAGE("Wobbuffet couldn't move because it's paralyzed!");
+    }
+}
+
 AI_SINGLE_BATTLE_TEST("AI avoids Thunder Wave when it can not paralyse target")
 {
     u32 species, ability;
@@ -0,0 +1,27 @@
+#include "global.h"
+#include "test/battle.h"
+#include "battle_ai_util.h"
+
+static const u16 sDamagingMoves[] = { MOVE_TACKLE, MOVE_FLAMETHROWER, MOVE_EARTHQUAKE, MOVE_PSYCHIC };
+
+AI_SINGLE_BATTLE_TEST("Benchmark: AI_CalcDamage")
+{
+    GIVEN {
+        AI_FLAGS(AI_FLAG_CHECK_BAD_MOVE | AI_FLAG_CHECK_VIABILITY | AI_FLAG_TRY_TO_FAINT);
+        PLAYER(SPECIES_WOBBUFFET);
+        OPPONENT(SPECIES_WOBBUFFET) { Moves(MOVE_TACKLE, MOVE_FLAMETHROWER, MOVE_EARTHQUAKE, MOVE_PSYCHIC); }
+    } WHEN {
+        TURN { MOVE(player, MOVE_CELEBRATE); }
+    } THEN {
+        u32 i;
+        uq4_12_t effectiveness;
+        struct Benchmark aiCalcDamage;
+
+        BENCHMARK(&aiCalcDamage)
+        {
+            for (i = 0; i < ARRAY_COUNT(sDamagingMoves); i++)
+                AI_CalcDamage(sDamagingMoves[i], B_POSITION_OPPONENT_LEFT, B_POSITION_PLAYER_LEFT, &effectiveness, NO_GIMMICK, NO_GIMMICK, AI_GetWeather());
+        }
+        REPORT_BENCHMARK(aiCalcDamage);
+    }
+}
@@ -0,0 +1,34 @@
+#include "global.h"
+#include "decompress.h"
+#include "malloc.h"
+#include "test/test.h"
+
+TEST("Benchmark: SmolDecompressData (tileset)")
+{
+    static const u32 tileset[] = INCBIN_U32("test/compression/tilesetTest.4bpp.smol");
+    struct Benchmark smolDecompressData;
+    void *buffer = Alloc(GetDecompressedDataSize(tileset));
+
+    BENCHMARK(&smolDecompressData)
+    {
+        DecompressDataWithHeaderWram(tileset, buffer);
+    }
+    REPORT_BENCHMARK(smolDecompressData);
+
+    Free(buffer);
+}
+
+TEST("Benchmark: SmolDecompressData (battle sprite)")
+{
+    static const u32 sprite[] = INCBIN_U32("test/compression/complex_battle_sprite.4bpp.smol");
+    struct Benchmark smolDecompressData;
+    void *buffer = Alloc(GetDecompressedDataSize(sprite));
+
+    BENCHMARK(&smolDecompressData)
+    {
+        DecompressDataWithHeaderWram(sprite, buffer);
+    }
+    REPORT_BENCHMARK(smolDecompressData);
+
+    Free(buffer);
+}
@@ -0,0 +1,38 @@
+#include "global.h"
+#include "fieldmap.h"
+#include "malloc.h"
+#include "test/test.h"
+
+#define MAP_WIDTH  64
+#define MAP_HEIGHT 64
+
+TEST("Benchmark: MapGridGetMetatileIdAt")
+{
+    s32 x, y;
+    u32 sum = 0;
+    struct Benchmark mapGridGetMetatileIdAt;
+    struct BackupMapLayout backupMapLayout = gBackupMapLayout;
+    u16 *map = Alloc(MAP_WIDTH * MAP_HEIGHT * sizeof(*map));
+
+    for (x = 0; x < MAP_WIDTH * MAP_HEIGHT; x++)
+        map[x] = x % (MAPGRID_METATILE_ID_MASK - 1);
+    gBackupMapLayout.width = MAP_WIDTH;
+    gBackupMapLayout.height = MAP_HEIGHT;
+    gBackupMapLayout.map = map;
+
+    BENCHMARK(&mapGridGetMetatileIdAt)
+    {
+        for (y = 0; y < MAP_HEIGHT; y++)
+        {
+            for (x = 0; x < MAP_WIDTH; x++)
+                sum += MapGridGetMetatileIdAt(x, y);
+        }
+    }
+    REPORT_BENCHMARK(mapGridGetMetatileIdAt);
+
+    gBackupMapLayout = backupMapLayout;
+    Free(map);
+
+    // Reference sum to prevent optimization.
+    EXPECT_NE(sum, 0);
+}
@@ -0,0 +1,43 @@
+#include "global.h"
+#include "pokemon.h"
+#include "test/test.h"
+#include "constants/species.h"
+
+static const u8 sMonDataFields[] =
+{
+    MON_DATA_SPECIES,
+    MON_DATA_HELD_ITEM,
+    MON_DATA_EXP,
+    MON_DATA_FRIENDSHIP,
+    MON_DATA_MOVE1,
+    MON_DATA_MOVE2,
+    MON_DATA_MOVE3,
+    MON_DATA_MOVE4,
+    MON_DATA_PP1,
+    MON_DATA_HP_EV,
+    MON_DATA_HP_IV,
+    MON_DATA_ABILITY_NUM,
+    MON_DATA_STATUS,
+    MON_DATA_LEVEL,
+    MON_DATA_HP,
+    MON_DATA_MAX_HP,
+    MON_DATA_ATK,
+};
+
+TEST("Benchmark: GetMonData")
+{
+    u32 i, sum = 0;
+    struct Benchmark getMonData;
+
+    CreateMon(&gPlayerParty[0], SPECIES_WOBBUFFET, 50, 0, FALSE, 0, OT_ID_PRESET, 0x12345678);
+
+    BENCHMARK(&getMonData)
+    {
+        for (i = 0; i < ARRAY_COUNT(sMonDataFields); i++)
+            sum += GetMonData(&gPlayerParty[0], sMonDataFields[i]);
+    }
+    REPORT_BENCHMARK(getMonData);
+
+    // Reference sum to prevent optimization.
+    EXPECT_NE(sum, 0);
+}
@@ -0,0 +1,22 @@
+#include "global.h"
+#include "main.h"
+#include "sprite.h"
+#include "test/test.h"
+
+TEST("Benchmark: BuildOamBuffer with max sprites")
+{
+    u32 i;
+    struct Benchmark buildOamBuffer;
+
+    ResetSpriteData();
+    for (i = 0; i < MAX_SPRITES; i++)
+        CreateSprite(&gDummySpriteTemplate, (i * 37) % DISPLAY_WIDTH, (i * 23) % DISPLAY_HEIGHT, i % 4);
+
+    BENCHMARK(&buildOamBuffer)
+    {
+        BuildOamBuffer();
+    }
+    REPORT_BENCHMARK(buildOamBuffer);
+
+    ResetSpriteData();
+}
@@ -0,0 +1,48 @@
+#include "global.h"
+#include "bg.h"
+#include "text.h"
+#include "window.h"
+#include "test/test.h"
+
+static const struct BgTemplate sBgTemplates[] =
+{
+    {
+        .bg = 0,
+        .charBaseIndex = 0,
+        .mapBaseIndex = 31,
+        .priority = 0,
+    },
+};
+
+static const struct WindowTemplate sWindowTemplates[] =
+{
+    {
+        .bg = 0,
+        .tilemapLeft = 0,
+        .tilemapTop = 0,
+        .width = DISPLAY_TILE_WIDTH,
+        .height = 4,
+        .paletteNum = 15,
+        .baseBlock = 1,
+    },
+    DUMMY_WIN_TEMPLATE,
+};
+
+TEST("Benchmark: RunTextPrinters")
+{
+    struct Benchmark runTextPrinters;
+
+    ResetBgsAndClearDma3BusyFlags(0);
+    InitBgsFromTemplates(0, sBgTemplates, ARRAY_COUNT(sBgTemplates));
+    InitWindows(sWindowTemplates);
+    AddTextPrinterParameterized(0, FONT_NORMAL, COMPOUND_STRING("The quick brown fox jumps over the lazy dog."), 0, 1, 1, NULL);
+
+    BENCHMARK(&runTextPrinters)
+    {
+        while (IsTextPrinterActive(0))
+            RunTextPrinters();
+    }
+    REPORT_BENCHMARK(runTextPrinters);
+
+    FreeAllWindowBuffers();
+}
@@ -0,0 +1,57 @@
+#include "global.h"
+#include "test/battle.h"
+
+// Test n runs cases n, n + FUZZ_TESTS, n + 2 * FUZZ_TESTS, ... so that
+// hydra can spread the cases between its runners. A crash or timeout
+// skips the rest of the test's cases.
+static void FuzzBattle(u32 i, u32 test, bool32 isDouble)
+{
+    u32 j, cases = 0;
+    struct FuzzCase fuzzCase = {0};
+    struct FuzzCase nextCase;
+
+    for (j = test; GetFuzzCase(j, isDouble, &nextCase); j += FUZZ_TESTS)
+    {
+        cases++;
+        PARAMETRIZE { fuzzCase = nextCase; }
+    }
+
+    GIVEN {
+        ASSUME(cases != 0);
+        FUZZ(fuzzCase);
+    }
+}
+
+SINGLE_BATTLE_TEST("Fuzz: Singles 1") { FuzzBattle(i, 0, FALSE); }
+SINGLE_BATTLE_TEST("Fuzz: Singles 2") { FuzzBattle(i, 1, FALSE); }
+SINGLE_BATTLE_TEST("Fuzz: Singles 3") { FuzzBattle(i, 2, FALSE); }
+SINGLE_BATTLE_TEST("Fuzz: Singles 4") { FuzzBattle(i, 3, FALSE); }
+SINGLE_BATTLE_TEST("Fuzz: Singles 5") { FuzzBattle(i, 4, FALSE); }
+SINGLE_BATTLE_TEST("Fuzz: Singles 6") { FuzzBattle(i, 5, FALSE); }
+SINGLE_BATTLE_TEST("Fuzz: Singles 7") { FuzzBattle(i, 6, FALSE); }
+SINGLE_BATTLE_TEST("Fuzz: Singles 8") { FuzzBattle(i, 7, FALSE); }
+SINGLE_BATTLE_TEST("Fuzz: Singles 9") { FuzzBattle(i, 8, FALSE); }
+SINGLE_BATTLE_TEST("Fuzz: Singles 10") { FuzzBattle(i, 9, FALSE); }
+SINGLE_BATTLE_TEST("Fuzz: Singles 11") { FuzzBattle(i, 10, FALSE); }
+SINGLE_BATTLE_TEST("Fuzz: Singles 12") { FuzzBattle(i, 11, FALSE); }
+SINGLE_BATTLE_TEST("Fuzz: Singles 13") { FuzzBattle(i, 12, FALSE); }
+SINGLE_BATTLE_TEST("Fuzz: Singles 14") { FuzzBattle(i, 13, FALSE); }
+SINGLE_BATTLE_TEST("Fuzz: Singles 15") { FuzzBattle(i, 14, FALSE); }
+SINGLE_BATTLE_TEST("Fuzz: Singles 16") { FuzzBattle(i, 15, FALSE); }
+
+DOUBLE_BATTLE_TEST("Fuzz: Doubles 1") { FuzzBattle(i, 0, TRUE); }
+DOUBLE_BATTLE_TEST("Fuzz: Doubles 2") { FuzzBattle(i, 1, TRUE); }
+DOUBLE_BATTLE_TEST("Fuzz: Doubles 3") { FuzzBattle(i, 2, TRUE); }
+DOUBLE_BATTLE_TEST("Fuzz: Doubles 4") { FuzzBattle(i, 3, TRUE); }
+DOUBLE_BATTLE_TEST("Fuzz: Doubles 5") { FuzzBattle(i, 4, TRUE); }
+DOUBLE_BATTLE_TEST("Fuzz: Doubles 6") { FuzzBattle(i, 5, TRUE); }
+DOUBLE_BATTLE_TEST("Fuzz: Doubles 7") { FuzzBattle(i, 6, TRUE); }
+DOUBLE_BATTLE_TEST("Fuzz: Doubles 8") { FuzzBattle(i, 7, TRUE); }
+DOUBLE_BATTLE_TEST("Fuzz: Doubles 9") { FuzzBattle(i, 8, TRUE); }
+DOUBLE_BATTLE_TEST("Fuzz: Doubles 10") { FuzzBattle(i, 9, TRUE); }
+DOUBLE_BATTLE_TEST("Fuzz: Doubles 11") { FuzzBattle(i, 10, TRUE); }
+DOUBLE_BATTLE_TEST("Fuzz: Doubles 12") { FuzzBattle(i, 11, TRUE); }
+DOUBLE_BATTLE_TEST("Fuzz: Doubles 13") { FuzzBattle(i, 12, TRUE); }
+DOUBLE_BATTLE_TEST("Fuzz: Doubles 14") { FuzzBattle(i, 13, TRUE); }
+DOUBLE_BATTLE_TEST("Fuzz: Doubles 15") { FuzzBattle(i, 14, TRUE); }
+DOUBLE_BATTLE_TEST("Fuzz: Doubles 16") { FuzzBattle(i, 15, TRUE); }
@@ -12,6 +12,12 @@
 
 #define TIMEOUT_SECONDS 60
 
+// Approx. 1000 samples per second with TIMER_64CLK.
+#define PROFILE_INTERVAL 262
+#define PROFILE_MAX_FRAMES 16
+// sp_sys in crt0.s.
+#define SYS_STACK_TOP (IWRAM_END - 0x1C0)
+
 void CB2_TestRunner(void);
 
 EWRAM_DATA struct TestRunnerState gTestRunnerState;
@@ -30,6 +36,7 @@ static bool32 MgbaOpen_(void);
 static void MgbaExit_(u8 exitCode);
 static s32 MgbaVPrintf_(const char *fmt, va_list va);
 static void Intr_Timer2(void);
+static void Intr_Profile(void);
 
 extern const struct Test __start_tests[];
 extern const struct Test __stop_tests[];
@@ -87,45 +94,71 @@ enum
     STATE_EXIT,
 };
 
-static u32 MinCostProcess(void)
+static bool32 ProcessCostLessThan(u32 a, u32 b)
+{
+    if (gTestRunnerState.processCosts[a] != gTestRunnerState.processCosts[b])
+        return gTestRunnerState.processCosts[a] < gTestRunnerState.processCosts[b];
+    return a < b;
+}
+
+static void InitProcessHeap(void)
 {
     u32 i;
-    u32 minCost, minCostProcess;
+    for (i = 0; i < MAX_PROCESSES; i++)
+    {
+        gTestRunnerState.processCosts[i] = 0;
+        gTestRunnerState.processHeap[i] = i;
+    }
+}
 
-    minCost = gTestRunnerState.processCosts[0];
-    minCostProcess = 0;
-    for (i = 1; i < gTestRunnerN; i++)
+// Adds cost to the process with the lowest cost so far (ties go to the
+// lowest index), and returns that process.
+static u32 AddCostToMinCostProcess(u32 cost)
+{
+    u32 i, child;
+    u32 process = gTestRunnerState.processHeap[0];
+
+    gTestRunnerState.processCosts[process] += cost;
+
+    // Only the root's cost changes, so sift it down.
+    i = 0;
+    while ((child = 2 * i + 1) < gTestRunnerN)
     {
-        if (gTestRunnerState.processCosts[i] < minCost)
-        {
-            minCost = gTestRunnerState.processCosts[i];
-            minCostProcess = i;
-        }
+        if (child + 1 < gTestRunnerN && ProcessCostLessThan(gTestRunnerState.processHeap[child + 1], gTestRunnerState.processHeap[child]))
+            child++;
+        if (!ProcessCostLessThan(gTestRunnerState.processHeap[child], process))
+            break;
+        gTestRunnerState.processHeap[i] = gTestRunnerState.processHeap[child];
+        i = child;
     }
+    gTestRunnerState.processHeap[i] = process;
 
-    return minCostProcess;
+    return process;
 }
 
 // Greedily assign tests to processes based on estimated cost.
-// TODO: Make processCosts a min heap.
 static u32 AssignCostToRunner(void)
 {
-    u32 minCostProcess;
-
     if (gTestRunnerState.test->runner == &gAssumptionsRunner)
         return gTestRunnerI;
 
-    minCostProcess = MinCostProcess();
-
     // XXX: If estimateCost returns only on some processes, or
     // returns inconsistent results then processCosts will be
     // inconsistent and some tests may not run.
     if (gTestRunnerState.test->runner->estimateCost)
-        gTestRunnerState.processCosts[minCostProcess] += gTestRunnerState.test->runner->estimateCost(gTestRunnerState.test->data);
+        return AddCostToMinCostProcess(gTestRunnerState.test->runner->estimateCost(gTestRunnerState.test->data));
     else
-        gTestRunnerState.processCosts[minCostProcess] += 1;
+        return AddCostToMinCostProcess(1);
+}
 
-    return minCostProcess;
+// Hydra hands out ranges of tests, which may start part way through a
+// file, so also run the assumptions for the file the range starts in.
+static bool32 IsTestInRange(const struct Test *test)
+{
+    u32 i = test - __start_tests;
+    if (test->runner == &gAssumptionsRunner && i < gTestRunnerStart)
+        return test->filename == __start_tests[gTestRunnerStart].filename;
+    return gTestRunnerStart <= i && i < gTestRunnerEnd;
 }
 
 void TestRunner_CheckMemory(void)
@@ -205,12 +238,25 @@ top:
         ClearSav2();
         ClearSav3();
 
+        gIntrTable[6] = Intr_Profile;
         gIntrTable[7] = Intr_Timer2;
 
         gSaveBlock2Ptr->optionsBattleStyle = OPTIONS_BATTLE_STYLE_SET;
 
+        InitProcessHeap();
+
         // The current test restarted the ROM (e.g. by jumping to NULL).
-        if (gPersistentTestRunnerState.address != 0)
+        if (gPersistentTestRunnerState.address != 0 && gTestRunnerEnd != 0)
+        {
+            // Only tests in the range are run, so the current test must have been one of them.
+            gTestRunnerState.test = (const struct Test *)(uintptr_t)gPersistentTestRunnerState.address;
+            gTestRunnerState.state = STATE_REPORT_RESULT;
+            gTestRunnerState.result = TEST_RESULT_CRASH;
+
+            if (gPersistentTestRunnerState.expectCrash)
+                gTestRunnerState.expectedResult = TEST_RESULT_CRASH;
+        }
+        else if (gPersistentTestRunnerState.address != 0)
         {
             gTestRunnerState.test = __start_tests;
             while ((uintptr_t)gTestRunnerState.test != gPersistentTestRunnerState.address)
@@ -221,9 +267,7 @@ top:
 
             if (gPersistentTestRunnerState.state == CURRENT_TEST_STATE_ESTIMATE)
             {
-                u32 runner = MinCostProcess();
-                gTestRunnerState.processCosts[runner] += 1;
-                if (runner == gTestRunnerI)
+                if (AddCostToMinCostProcess(1) == gTestRunnerI)
                 {
                     gTestRunnerState.state = STATE_REPORT_RESULT;
                     gTestRunnerState.result = TEST_RESULT_CRASH;
@@ -257,16 +301,24 @@ top:
     case STATE_ASSIGN_TEST:
         while (1)
         {
-            if (gTestRunnerState.test == __stop_tests)
+            if (gTestRunnerState.test == __stop_tests
+             || (gTestRunnerEnd != 0 && gTestRunnerState.test >= &__start_tests[gTestRunnerEnd]))
             {
                 gTestRunnerState.state = STATE_EXIT;
                 return;
             }
+            if (gTestRunnerEnd != 0 && !IsTestInRange(gTestRunnerState.test))
+            {
+                ++gTestRunnerState.test;
+                continue;
+            }
             if (gTestRunnerState.test->runner != &gAssumptionsRunner)
             {
                 if ((gTestRunnerState.filterMode == TEST_FILTER_MODE_TEST_NAME_PREFIX && !PrefixMatch(gTestRunnerArgv, gTestRunnerState.test->name))
                  || (gTestRunnerState.filterMode == TEST_FILTER_MODE_TEST_NAME_INFIX && !InfixMatch(gTestRunnerArgv, gTestRunnerState.test->name))
-                 || (gTestRunnerState.filterMode == TEST_FILTER_MODE_FILENAME_EXACT && !ExactMatch(gTestRunnerArgv, gTestRunnerState.test->filename)))
+                 || (gTestRunnerState.filterMode == TEST_FILTER_MODE_FILENAME_EXACT && !ExactMatch(gTestRunnerArgv, gTestRunnerState.test->filename))
+                 // The fuzz tests only run under 'make fuzz'.
+                 || (gTestRunnerFuzz[0] == '\0' && PrefixMatch("Fuzz:", gTestRunnerState.test->name)))
                 {
                     ++gTestRunnerState.test;
                     continue;
@@ -276,7 +328,8 @@ top:
         }
 
         Test_MgbaPrintf(":N%s", gTestRunnerState.test->name);
-        Test_MgbaPrintf(":L%s:%d", gTestRunnerState.test->filename);
+        Test_MgbaPrintf(":L%s:%d", gTestRunnerState.test->filename, SourceLine(0));
+        gTestRunnerState.startFrame = gMain.vblankCounter2;
         gTestRunnerState.result = TEST_RESULT_PASS;
         gTestRunnerState.expectedResult = TEST_RESULT_PASS;
         gTestRunnerState.expectLeaks = FALSE;
@@ -289,13 +342,19 @@ top:
         EnableInterrupts(INTR_FLAG_TIMER2);
         REG_TM2CNT_L = UINT16_MAX - (274 * 60); // Approx. 1 second.
         REG_TM2CNT_H = TIMER_ENABLE | TIMER_INTR_ENABLE | TIMER_1024CLK;
+        if (gTestRunnerProfile)
+        {
+            EnableInterrupts(INTR_FLAG_TIMER1);
+            REG_TM1CNT_L = UINT16_MAX - PROFILE_INTERVAL;
+            REG_TM1CNT_H = TIMER_ENABLE | TIMER_INTR_ENABLE | TIMER_64CLK;
+        }
 
         gPersistentTestRunnerState.address = (uintptr_t)gTestRunnerState.test;
         gPersistentTestRunnerState.state = CURRENT_TEST_STATE_ESTIMATE;
 
         // If AssignCostToRunner fails, we want to report the failure.
         gTestRunnerState.state = STATE_REPORT_RESULT;
-        if (AssignCostToRunner() == gTestRunnerI)
+        if (gTestRunnerEnd != 0 || AssignCostToRunner() == gTestRunnerI)
             gTestRunnerState.state = STATE_RUN_TEST;
         else
             gTestRunnerState.state = STATE_NEXT_TEST;
@@ -328,6 +387,7 @@ top:
 
     case STATE_REPORT_RESULT:
         REG_TM2CNT_H = 0;
+        REG_TM1CNT_H = 0;
 
         gTestRunnerState.state = STATE_NEXT_TEST;
 
@@ -351,6 +411,7 @@ top:
             const char *color;
             const char *result;
 
+            Test_MgbaPrintf(":D%d", gMain.vblankCounter2 - gTestRunnerState.startFrame);
             if (gTestRunnerState.result == gTestRunnerState.expectedResult
              || (gTestRunnerState.result == TEST_RESULT_FAIL
               && gTestRunnerState.expectedResult == TEST_RESULT_KNOWN_FAIL))
@@ -597,7 +658,7 @@ void Test_ExitWithResult(enum TestResult result, u32 stopLine, const char *fmt,
 
 #define REG_DEBUG_ENABLE (*(vu16 *)0x4FFF780)
 #define REG_DEBUG_FLAGS  (*(vu16 *)0x4FFF700)
-#define REG_DEBUG_STRING ((char *)0x4FFF600)
+#define REG_DEBUG_STRING ((volatile char *)0x4FFF600)
 
 static bool32 MgbaOpen_(void)
 {
@@ -630,6 +691,23 @@ static s32 MgbaPutchar_(s32 i, s32 c)
     return i;
 }
 
+static s32 MgbaPutPointer_(s32 i, u32 p)
+{
+    s32 n;
+    i = MgbaPutchar_(i, '<');
+    i = MgbaPutchar_(i, '0');
+    i = MgbaPutchar_(i, 'x');
+    for (n = 0; n < 7; n++)
+    {
+        unsigned nybble = (p >> (24 - (4*n))) & 0xF;
+        if (nybble <= 9)
+            i = MgbaPutchar_(i, '0' + nybble);
+        else
+            i = MgbaPutchar_(i, 'a' + nybble - 10);
+    }
+    return MgbaPutchar_(i, '>');
+}
+
 extern const u8 gWireless_RSEtoASCIITable[];
 
 // Bare-bones, only supports plain %s, %S, and %d.
@@ -640,6 +718,10 @@ static s32 MgbaVPrintf_(const char *fmt, va_list va)
     u32 p;
     const char *s;
     const u8 *pokeS;
+    u16 profileIntr = REG_IE & INTR_FLAG_TIMER1;
+    // Hold off profiler samples until the line is sent, so that they
+    // don't interleave with it.
+    REG_IE &= ~INTR_FLAG_TIMER1;
     while (*fmt)
     {
         switch ((c = *fmt++))
@@ -651,6 +733,7 @@ static s32 MgbaVPrintf_(const char *fmt, va_list va)
                 i = MgbaPutchar_(i, '%');
                 break;
             case 'd':
+            case 'u':
                 d = va_arg(va, int);
                 if (d == 0)
                 {
@@ -660,9 +743,12 @@ static s32 MgbaVPrintf_(const char *fmt, va_list va)
                 {
                     char buffer[10];
                     s32 n = 0;
-                    u32 u = abs(d);
-                    if (d < 0)
+                    u32 u = d;
+                    if (fmt[-1] == 'd' && d < 0)
+                    {
                         i = MgbaPutchar_(i, '-');
+                        u = -u;
+                    }
                     while (u > 0)
                     {
                         buffer[n++] = '0' + (u % 10);
@@ -674,21 +760,7 @@ static s32 MgbaVPrintf_(const char *fmt, va_list va)
                 break;
             case 'p':
                 p = va_arg(va, unsigned);
-                {
-                    s32 n;
-                    i = MgbaPutchar_(i, '<');
-                    i = MgbaPutchar_(i, '0');
-                    i = MgbaPutchar_(i, 'x');
-                    for (n = 0; n < 7; n++)
-                    {
-                        unsigned nybble = (p >> (24 - (4*n))) & 0xF;
-                        if (nybble <= 9)
-                            i = MgbaPutchar_(i, '0' + nybble);
-                        else
-                            i = MgbaPutchar_(i, 'a' + nybble - 10);
-                    }
-                    i = MgbaPutchar_(i, '>');
-                }
+                i = MgbaPutPointer_(i, p);
                 break;
             case 'q':
                 d = va_arg(va, int);
@@ -772,9 +844,54 @@ static s32 MgbaVPrintf_(const char *fmt, va_list va)
     {
         REG_DEBUG_FLAGS = MGBA_LOG_INFO | 0x100;
     }
+    REG_IE |= profileIntr;
     return i;
 }
 
+static bool32 IsThumbReturnAddress(u32 address)
+{
+    const u16 *bl;
+    if (!(address & 1) || address < ROM_START + 4 || address >= ROM_END)
+        return FALSE;
+    bl = (const u16 *)(address - 1) - 2;
+    return (bl[0] & 0xF800) == 0xF000 && (bl[1] & 0xF800) == 0xF800;
+}
+
+/* Sends ":S<pc> <lr> <return addresses...>" for the interrupted code to
+ * hydra. The return addresses are whatever on the stack points just
+ * after a BL, so they may include some stale frames. */
+__attribute__((used)) static void Profile_Sample(const u32 *sp)
+{
+    const u32 *stackTop = (const u32 *)SYS_STACK_TOP;
+    s32 i, frames;
+
+    i = MgbaPutchar_(0, ':');
+    i = MgbaPutchar_(i, 'S');
+    i = MgbaPutPointer_(i, IRQ_LR - 4);
+    i = MgbaPutchar_(i, ' ');
+    i = MgbaPutPointer_(i, sp[0]);
+    for (sp++, frames = 0; sp < stackTop && frames < PROFILE_MAX_FRAMES; sp++)
+    {
+        if (IsThumbReturnAddress(*sp))
+        {
+            i = MgbaPutchar_(i, ' ');
+            i = MgbaPutPointer_(i, *sp);
+            frames++;
+        }
+    }
+    REG_DEBUG_FLAGS = MGBA_LOG_INFO | 0x100;
+}
+
+/* IntrMain pushes the interrupted code's lr just before calling the
+ * handler, so sp points at it and the interrupted stack is above it. */
+static NAKED void Intr_Profile(void)
+{
+    asm("mov r0, sp\n\
+         ldr r1, =Profile_Sample\n\
+         bx r1\n\
+         .pool");
+}
+
 /* Entry point for the Debugging and Control System. Handles illegal
  * instructions, which are typically caused by branching to an invalid
  * address. */
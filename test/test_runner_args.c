@@ -5,4 +5,8 @@
 const bool8 gTestRunnerEnabled = TRUE;
 const u8 gTestRunnerN = 0;
 const u8 gTestRunnerI = 0;
+const u32 gTestRunnerStart = 0;
+const u32 gTestRunnerEnd = 0;
 const char gTestRunnerArgv[256] = {'\0'};
+const bool8 gTestRunnerProfile = FALSE;
+const char gTestRunnerFuzz[32] = {'\0'};
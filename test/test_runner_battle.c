@@ -14,6 +14,7 @@
 #include "test/battle.h"
 #include "window.h"
 #include "constants/characters.h"
+#include "constants/party_menu.h"
 #include "constants/trainers.h"
 
 #if defined(__INTELLISENSE__)
@@ -24,6 +25,7 @@
 #undef TestRunner_Battle_RecordStatus1
 #undef TestRunner_Battle_AfterLastTurn
 #undef TestRunner_Battle_CheckBattleRecordActionType
+#undef TestRunner_Battle_FuzzBattleRecordAction
 #undef TestRunner_Battle_GetForcedAbility
 #endif
 
@@ -41,8 +43,11 @@ static inline bool32 RngSeedNotDefault(const rng_value_t *seed)
     return (seed->a | seed->b | seed->c | seed->ctr) != 0;
 
 }
-#undef Q_4_12
-#define Q_4_12(n) (s32)((n) * 4096)
+// Ratios of passes/successes. These have more precision than Q_4_12 so
+// that the product of several independent branches is still accurate.
+#define RATIO_SHIFT 24
+#define RATIO(n, d) ((u32)(((u64)(n) << RATIO_SHIFT) / (d)))
+#define RATIO_TO_Q_4_12(r) ((r) >> (RATIO_SHIFT - 12))
 
 // Alias sBackupMapData to avoid using heap.
 struct BattleTestRunnerState *const gBattleTestRunnerState = (void *)sBackupMapData;
@@ -186,7 +191,13 @@ static void BattleTest_SetUp(void *data)
 
 static void PrintTestName(void)
 {
-    if (STATE->trials && STATE->parameters)
+    if (DATA.fuzzCase.turns)
+    {
+        // Hydra reports a crash or timeout with the last name printed.
+        Test_MgbaPrintf(":N%s %d/%d FUZZ_CASE=%s%d-%d-%d", gTestRunnerState.test->name, STATE->runParameter + 1, STATE->parameters,
+            STATE->battlersCount == 4 ? "d" : "s", DATA.fuzzCase.seed, DATA.fuzzCase.turns, DATA.fuzzCase.reductions);
+    }
+    else if (STATE->trials && STATE->parameters)
     {
         if (STATE->trials == 1)
             Test_MgbaPrintf(":N%s %d/%d (%d/?)", gTestRunnerState.test->name, STATE->runParameter + 1, STATE->parameters, STATE->runTrial + 1);
@@ -333,7 +344,7 @@ static void BattleTest_Run(void *data)
             Test_ExitWithResult(TEST_RESULT_INVALID, SourceLine(0), ":LSpeed required for all PLAYERs and OPPONENTs");
         }
     }
-    else
+    else if (!DATA.fuzzCase.turns)
     {
         SetImplicitSpeeds();
     }
@@ -354,6 +365,50 @@ static void BattleTest_Run(void *data)
     PrintTestName();
 }
 
+// Returns which of the 'n' outcomes the next call with the tag takes in
+// this trial. Each call is a level of a tree whose leaves are the trials,
+// which are enumerated depth-first by AdvanceRngBranches.
+static u32 NextRngBranch(u32 n)
+{
+    u32 depth = STATE->rngDepth++;
+    if (depth == STATE->rngBranchesCount)
+    {
+        if (depth == MAX_RNG_BRANCHES)
+            Test_ExitWithResult(TEST_RESULT_ERROR, SourceLine(0), ":L%s:%d: PASSES_RANDOMLY with .independent supports at most %d calls with the tag", gTestRunnerState.test->filename, SourceLine(0), MAX_RNG_BRANCHES);
+        STATE->rngBranches[depth].value = 0;
+        STATE->rngBranches[depth].count = n;
+        STATE->rngBranchesCount++;
+    }
+    else if (STATE->rngBranches[depth].count != n)
+    {
+        Test_ExitWithResult(TEST_RESULT_ERROR, SourceLine(0), ":L%s:%d: Random call %d with the tag has inconsistent outcomes %d and %d", gTestRunnerState.test->filename, SourceLine(0), depth + 1, STATE->rngBranches[depth].count, n);
+    }
+    return STATE->rngBranches[depth].value;
+}
+
+static bool32 AdvanceRngBranches(void)
+{
+    // Branches past the last call that this trial made are not reached.
+    STATE->rngBranchesCount = STATE->rngDepth;
+    while (STATE->rngBranchesCount > 0)
+    {
+        struct RngBranch *branch = &STATE->rngBranches[STATE->rngBranchesCount - 1];
+        if (++branch->value < branch->count)
+            return TRUE;
+        STATE->rngBranchesCount--;
+    }
+    return FALSE;
+}
+
+// Narrows the trial's ratio to the outcomes [lo, hi) out of sum. Both
+// bounds are rounded rather than the outcome's own ratio, so the ratios
+// of all of a call's outcomes add up to exactly the ratio they split, and
+// the trials' ratios add up to exactly RATIO(1, 1).
+static void MultiplyTrialRatio(u32 lo, u32 hi, u32 sum)
+{
+    STATE->trialRatio = (u64)STATE->trialRatio * hi / sum - (u64)STATE->trialRatio * lo / sum;
+}
+
 u32 RandomUniform(enum RandomTag tag, u32 lo, u32 hi)
 {
     const struct BattlerTurn *turn = NULL;
@@ -366,7 +421,14 @@ u32 RandomUniform(enum RandomTag tag, u32 lo, u32 hi)
             return turn->rng.value;
     }
 
-    if (tag == STATE->rngTag)
+    if (tag == STATE->rngTag && STATE->rngIndependent)
+    {
+        u32 branch = NextRngBranch(hi - lo + 1);
+        STATE->didRunRandomly = TRUE;
+        MultiplyTrialRatio(branch, branch + 1, hi - lo + 1);
+        return branch + lo;
+    }
+    else if (tag == STATE->rngTag)
     {
         STATE->didRunRandomly = TRUE;
         u32 n = hi - lo + 1;
@@ -379,7 +441,7 @@ u32 RandomUniform(enum RandomTag tag, u32 lo, u32 hi)
         {
             Test_ExitWithResult(TEST_RESULT_ERROR, SourceLine(0), ":LRandomUniform called from %p with tag %d and inconsistent trials %d and %d", __builtin_extract_return_addr(__builtin_return_address(0)), tag, STATE->trials, n);
         }
-        STATE->trialRatio = Q_4_12(1) / STATE->trials;
+        STATE->trialRatio = RATIO(1, STATE->trials);
         return STATE->runTrial + lo;
     }
 
@@ -403,7 +465,22 @@ u32 RandomUniformExcept(enum RandomTag tag, u32 lo, u32 hi, bool32 (*reject)(u32
         }
     }
 
-    if (tag == STATE->rngTag)
+    if (tag == STATE->rngTag && STATE->rngIndependent)
+    {
+        u32 n = 0, i, branch;
+        STATE->didRunRandomly = TRUE;
+        for (i = lo; i <= hi; i++)
+            if (!reject(i))
+                n++;
+        if (n == 0)
+            Test_ExitWithResult(TEST_RESULT_ERROR, SourceLine(0), ":LRandomUniformExcept called from %p with tag %d rejected all values", __builtin_extract_return_addr(__builtin_return_address(0)), tag);
+        branch = NextRngBranch(n);
+        MultiplyTrialRatio(branch, branch + 1, n);
+        for (i = lo; reject(i) || branch-- > 0; i++)
+            ;
+        return i;
+    }
+    else if (tag == STATE->rngTag)
     {
         STATE->didRunRandomly = TRUE;
         if (STATE->trials == 1)
@@ -415,7 +492,7 @@ u32 RandomUniformExcept(enum RandomTag tag, u32 lo, u32 hi, bool32 (*reject)(u32
             STATE->trials = n;
             PrintTestName();
         }
-        STATE->trialRatio = Q_4_12(1) / STATE->trials;
+        STATE->trialRatio = RATIO(1, STATE->trials);
 
         while (reject(STATE->runTrial + lo + STATE->rngTrialOffset))
         {
@@ -452,7 +529,21 @@ u32 RandomWeightedArray(enum RandomTag tag, u32 sum, u32 n, const u8 *weights)
             return turn->rng.value;
     }
 
-    if (tag == STATE->rngTag)
+    if (tag == STATE->rngTag && STATE->rngIndependent)
+    {
+        // Outcomes with a weight of 0 can't happen, so aren't branches.
+        u32 nonZero = 0, i, branch, below = 0;
+        STATE->didRunRandomly = TRUE;
+        for (i = 0; i < n; i++)
+            if (weights[i] != 0)
+                nonZero++;
+        branch = NextRngBranch(nonZero);
+        for (i = 0; weights[i] == 0 || branch-- > 0; i++)
+            below += weights[i];
+        MultiplyTrialRatio(below, below + weights[i], sum);
+        return i;
+    }
+    else if (tag == STATE->rngTag)
     {
         STATE->didRunRandomly = TRUE;
         if (STATE->trials == 1)
@@ -465,7 +556,7 @@ u32 RandomWeightedArray(enum RandomTag tag, u32 sum, u32 n, const u8 *weights)
             Test_ExitWithResult(TEST_RESULT_ERROR, SourceLine(0), ":LRandomWeighted called from %p with tag %d and inconsistent trials %d and %d", __builtin_extract_return_addr(__builtin_return_address(0)), tag, STATE->trials, n);
         }
         // TODO: Detect inconsistent sum.
-        STATE->trialRatio = Q_4_12(weights[STATE->runTrial]) / sum;
+        STATE->trialRatio = RATIO(weights[STATE->runTrial], sum);
         return STATE->runTrial;
     }
 
@@ -526,7 +617,14 @@ const void *RandomElementArray(enum RandomTag tag, const void *array, size_t siz
         }
     }
 
-    if (tag == STATE->rngTag)
+    if (tag == STATE->rngTag && STATE->rngIndependent)
+    {
+        u32 branch = NextRngBranch(count);
+        STATE->didRunRandomly = TRUE;
+        MultiplyTrialRatio(branch, branch + 1, count);
+        return (const u8 *)array + size * branch;
+    }
+    else if (tag == STATE->rngTag)
     {
         STATE->didRunRandomly = TRUE;
         if (STATE->trials == 1)
@@ -538,7 +636,7 @@ const void *RandomElementArray(enum RandomTag tag, const void *array, size_t siz
         {
             Test_ExitWithResult(TEST_RESULT_ERROR, SourceLine(0), ":LRandomElement called from %p with tag %d and inconsistent trials %d and %d", __builtin_extract_return_addr(__builtin_return_address(0)), tag, STATE->trials, count);
         }
-        STATE->trialRatio = Q_4_12(1) / count;
+        STATE->trialRatio = RATIO(1, count);
         return (const u8 *)array + size * STATE->runTrial;
     }
     return (const u8 *)array + size * index;
@@ -879,6 +977,18 @@ void TestRunner_Battle_InvalidNoHPMon(u32 battlerId, u32 partyIndex)
                         gTestRunnerState.test->filename, BattlerIdentifier(battlerId), gBattlerPartyIndexes[battlerId]);
 }
 
+void TestRunner_Battle_ScriptsStackOverflow(const u8 *bsPtr)
+{
+    Test_ExitWithResult(TEST_RESULT_ERROR, SourceLine(0), ":L%s:%d: Battle script stack overflow pushing %p from %p",
+                        gTestRunnerState.test->filename, SourceLine(0), bsPtr, gBattlescriptCurrInstr);
+}
+
+void TestRunner_Battle_StaleAbilityCache(u32 battlerId)
+{
+    Test_ExitWithResult(TEST_RESULT_ERROR, SourceLine(0), ":L%s:%d: Cached ability of %s is stale, a change is missing InvalidateBattlerAbilityCache",
+                        gTestRunnerState.test->filename, SourceLine(0), BattlerIdentifier(battlerId));
+}
+
 static bool32 CheckComparision(s32 val1, s32 val2, u32 cmp)
 {
     switch (cmp)
@@ -1313,7 +1423,7 @@ void TestRunner_Battle_AfterLastTurn(void)
 {
     const struct BattleTest *test = GetBattleTest();
 
-    if (DATA.turns - 1 != DATA.trial.lastActionTurn)
+    if (!DATA.fuzzCase.turns && DATA.turns - 1 != DATA.trial.lastActionTurn)
     {
         const char *filename = gTestRunnerState.test->filename;
         Test_ExitWithResult(TEST_RESULT_FAIL, SourceLine(0), ":L%s:%d: %d TURNs specified, but %d ran", filename, SourceLine(0), DATA.turns, DATA.trial.lastActionTurn + 1);
@@ -1378,8 +1488,38 @@ static inline rng_value_t MakeRngValue(const u16 seed)
     return result;
 }
 
+// The observed ratio will end up between observedRatio and observedRatio
+// plus the ratio of the outcomes that haven't been tried yet.
+static u32 UnexploredRatio(void)
+{
+    return STATE->exploredRatio < RATIO(1, 1) ? RATIO(1, 1) - STATE->exploredRatio : 0;
+}
+
+// This is a tolerance of +/- ~2%.
+static bool32 WithinTolerance(u32 observedRatio)
+{
+    return abs((s32)(observedRatio - STATE->expectedRatio)) <= RATIO(2, 100);
+}
+
+static bool32 RandomlyPasses(void)
+{
+    return WithinTolerance(STATE->observedRatio) && WithinTolerance(STATE->observedRatio + UnexploredRatio());
+}
+
+// Whether the remaining trials can't change the result.
+static bool32 RandomlyIsDecided(void)
+{
+    u32 lo = STATE->observedRatio;
+    u32 hi = STATE->observedRatio + UnexploredRatio();
+    return RandomlyPasses()
+        || hi + RATIO(2, 100) < STATE->expectedRatio
+        || lo > STATE->expectedRatio + RATIO(2, 100);
+}
+
 static void CB2_BattleTest_NextTrial(void)
 {
+    bool32 decided;
+
     TearDownBattle();
 
     SetMainCallback2(CB2_BattleTest_NextParameter);
@@ -1394,29 +1534,45 @@ static void CB2_BattleTest_NextTrial(void)
     default:
         return;
     }
-    if (STATE->rngTag)
+    STATE->exploredRatio += STATE->trialRatio;
+    if (STATE->rngIndependent)
+        STATE->trialRatio = RATIO(1, 1);
+    else if (STATE->rngTag)
         STATE->trialRatio = 0;
 
-    if (++STATE->runTrial < STATE->trials)
+    decided = RandomlyIsDecided();
+    if (STATE->rngIndependent ? AdvanceRngBranches() : STATE->runTrial + 1 < STATE->trials)
     {
-        PrintTestName();
-        gTestRunnerState.result = TEST_RESULT_PASS;
-        DATA.recordedBattle.rngSeed = MakeRngValue(STATE->runTrial);
-        memset(&DATA.trial, 0, sizeof(DATA.trial));
-        SetVariablesForRecordedBattle(&DATA.recordedBattle);
-        SetMainCallback2(CB2_InitBattle);
+        if (!decided)
+        {
+            STATE->runTrial++;
+            STATE->rngDepth = 0;
+            PrintTestName();
+            gTestRunnerState.result = TEST_RESULT_PASS;
+            // The branches are only a tree if everything else is the same.
+            if (!STATE->rngIndependent)
+                DATA.recordedBattle.rngSeed = MakeRngValue(STATE->runTrial);
+            memset(&DATA.trial, 0, sizeof(DATA.trial));
+            SetVariablesForRecordedBattle(&DATA.recordedBattle);
+            SetMainCallback2(CB2_InitBattle);
+            return;
+        }
     }
     else
     {
-        if (STATE->rngTag && !STATE->didRunRandomly && STATE->expectedRatio != Q_4_12(0.0) && STATE->expectedRatio != Q_4_12(1.0))
-            Test_ExitWithResult(TEST_RESULT_INVALID, SourceLine(0), ":L%s:%d: PASSES_RANDOMLY specified but no Random* call with that tag executed", gTestRunnerState.test->filename, SourceLine(0));
-
-        // This is a tolerance of +/- ~2%.
-        if (abs(STATE->observedRatio - STATE->expectedRatio) <= Q_4_12(0.02))
-            gTestRunnerState.result = TEST_RESULT_PASS;
-        else
-            Test_ExitWithResult(TEST_RESULT_FAIL, SourceLine(0), ":L%s:%d: Expected %q passes/successes, observed %q", gTestRunnerState.test->filename, SourceLine(0), STATE->expectedRatio, STATE->observedRatio);
+        // Every outcome has been tried, so only the observed ratio matters.
+        decided = FALSE;
     }
+
+    if (STATE->rngTag && !STATE->didRunRandomly && STATE->expectedRatio != RATIO(0, 1) && STATE->expectedRatio != RATIO(1, 1))
+        Test_ExitWithResult(TEST_RESULT_INVALID, SourceLine(0), ":L%s:%d: PASSES_RANDOMLY specified but no Random* call with that tag executed", gTestRunnerState.test->filename, SourceLine(0));
+
+    if (decided ? RandomlyPasses() : WithinTolerance(STATE->observedRatio))
+        gTestRunnerState.result = TEST_RESULT_PASS;
+    else if (decided)
+        Test_ExitWithResult(TEST_RESULT_FAIL, SourceLine(0), ":L%s:%d: Expected %q passes/successes, observed %q after %q of the outcomes", gTestRunnerState.test->filename, SourceLine(0), RATIO_TO_Q_4_12(STATE->expectedRatio), RATIO_TO_Q_4_12(STATE->observedRatio), RATIO_TO_Q_4_12(STATE->exploredRatio));
+    else
+        Test_ExitWithResult(TEST_RESULT_FAIL, SourceLine(0), ":L%s:%d: Expected %q passes/successes, observed %q", gTestRunnerState.test->filename, SourceLine(0), RATIO_TO_Q_4_12(STATE->expectedRatio), RATIO_TO_Q_4_12(STATE->observedRatio));
 }
 
 static void BattleTest_TearDown(void *data)
@@ -1467,22 +1623,27 @@ void Randomly(u32 sourceLine, u32 passes, u32 trials, struct RandomlyContext ctx
     INVALID_IF(STATE->trials != 0, "PASSES_RANDOMLY can only be used once per test");
     INVALID_IF(test->resultsSize > 0 && STATE->parametersCount > 1, "PASSES_RANDOMLY is incompatible with results");
     INVALID_IF(passes > trials, "%d passes specified, but only %d trials", passes, trials);
+    INVALID_IF(ctx.independent && !ctx.tag, "PASSES_RANDOMLY with .independent requires a tag");
     STATE->rngTag = ctx.tag;
+    STATE->rngIndependent = ctx.independent;
     STATE->rngTrialOffset = 0;
+    STATE->rngDepth = 0;
+    STATE->rngBranchesCount = 0;
     STATE->runTrial = 0;
-    STATE->expectedRatio = Q_4_12(passes) / trials;
+    STATE->expectedRatio = RATIO(passes, trials);
     STATE->observedRatio = 0;
+    STATE->exploredRatio = 0;
     if (STATE->rngTag)
     {
         STATE->trials = 1;
-        STATE->trialRatio = Q_4_12(1);
+        STATE->trialRatio = RATIO(1, 1);
     }
     else
     {
         const rng_value_t defaultSeed = RNG_SEED_DEFAULT;
         INVALID_IF(RngSeedNotDefault(&DATA.recordedBattle.rngSeed), "RNG seed already set");
         STATE->trials = 50;
-        STATE->trialRatio = Q_4_12(1) / STATE->trials;
+        STATE->trialRatio = RATIO(1, STATE->trials);
         DATA.recordedBattle.rngSeed = defaultSeed;
     }
 }
@@ -1506,6 +1667,13 @@ void AILogScores(u32 sourceLine)
     DATA.logAI = TRUE;
 }
 
+void AIDecisionsPerFrame_(u32 sourceLine, u32 decisions)
+{
+    INVALID_IF(!IsAITest(), "AIDecisionsPerFrame is usable only in AI_SINGLE_BATTLE_TEST & AI_DOUBLE_BATTLE_TEST");
+    INVALID_IF(decisions == 0, "AIDecisionsPerFrame must be at least 1");
+    DATA.aiDecisionsPerFrame = decisions;
+}
+
 const struct TestRunner gBattleTestRunner =
 {
     .estimateCost = BattleTest_EstimateCost,
@@ -1859,6 +2027,209 @@ void Shadow_(u32 sourceLine, bool32 isShadow)
     SetMonData(DATA.currentMon, MON_DATA_IS_SHADOW, &isShadow);
 }
 
+static u32 FuzzRandom(rng_value_t *rng, u32 n)
+{
+    return LocalRandom32(rng) % n;
+}
+
+static u32 FuzzDropReduction(u32 side, u32 partyIndex)
+{
+    return side == B_SIDE_PLAYER ? FUZZ_DROP_PLAYER(partyIndex) : FUZZ_DROP_OPPONENT(partyIndex);
+}
+
+// Any species that can start a battle, i.e. not a form that only exists
+// during one.
+static bool32 IsFuzzSpecies(u32 species)
+{
+    const struct SpeciesInfo *info = &gSpeciesInfo[species];
+    return IsSpeciesEnabled(species)
+        && !info->isTotem
+        && !info->isMegaEvolution
+        && !info->isPrimalReversion
+        && !info->isUltraBurst
+        && !info->isGigantamax
+        && !info->isTeraForm;
+}
+
+static bool32 IsFuzzMove(u32 move, const u16 *moves, u32 movesCount)
+{
+    u32 i;
+    if (move == MOVE_STRUGGLE)
+        return FALSE;
+    for (i = 0; i < movesCount; i++)
+    {
+        if (moves[i] == move)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+// The party sizes are drawn first so that ReduceFuzzCase can find them
+// without generating the Pokémon.
+static void FuzzPartySizes(rng_value_t *rng, bool32 isDouble, u32 partySizes[NUM_BATTLE_SIDES])
+{
+    u32 minPartySize = isDouble ? 2 : 1;
+    partySizes[B_SIDE_PLAYER] = minPartySize + FuzzRandom(rng, PARTY_SIZE - minPartySize + 1);
+    partySizes[B_SIDE_OPPONENT] = minPartySize + FuzzRandom(rng, PARTY_SIZE - minPartySize + 1);
+}
+
+void Fuzz_(u32 sourceLine, struct FuzzCase fuzzCase)
+{
+    s32 i, j;
+    u32 side;
+    u32 partySizes[NUM_BATTLE_SIDES];
+    rng_value_t rng = LocalRandomSeed(fuzzCase.seed);
+
+    INVALID_IF(fuzzCase.turns == 0 || fuzzCase.turns > MAX_FUZZ_TURNS, "Illegal FUZZ turns: %d", fuzzCase.turns);
+    INVALID_IF(DATA.playerPartySize != 0 || DATA.opponentPartySize != 0, "FUZZ with PLAYER/OPPONENT");
+
+    FuzzPartySizes(&rng, STATE->battlersCount == 4, partySizes);
+    for (side = 0; side < NUM_BATTLE_SIDES; side++)
+    {
+        for (i = 0; i < partySizes[side]; i++)
+        {
+            u32 species, level, nature, movesCount, ability, item;
+            u16 moves[MAX_MON_MOVES] = {MOVE_NONE};
+
+            // Everything is drawn even if it is reduced away, so that
+            // reducing one part of the case leaves the rest unchanged.
+            do
+                species = 1 + FuzzRandom(&rng, SPECIES_EGG - 1);
+            while (!IsFuzzSpecies(species));
+            level = 1 + FuzzRandom(&rng, MAX_LEVEL);
+            nature = FuzzRandom(&rng, NUM_NATURES);
+            movesCount = 1 + FuzzRandom(&rng, MAX_MON_MOVES);
+            for (j = 0; j < movesCount; j++)
+            {
+                do
+                    moves[j] = 1 + FuzzRandom(&rng, MOVES_COUNT - 1);
+                while (!IsFuzzMove(moves[j], moves, j));
+            }
+            // Half of the Pokémon keep their own ability and no item.
+            ability = FuzzRandom(&rng, 2) ? 1 + FuzzRandom(&rng, ABILITIES_COUNT - 1) : ABILITY_NONE;
+            item = FuzzRandom(&rng, 2) ? 1 + FuzzRandom(&rng, ITEMS_COUNT - 1) : ITEM_NONE;
+
+            if (fuzzCase.reductions & FuzzDropReduction(side, i))
+                continue;
+            if (fuzzCase.reductions & FUZZ_ONE_MOVE)
+                moves[1] = MOVE_NONE;
+
+            OpenPokemon(sourceLine, side, species);
+            Level_(sourceLine, level);
+            Nature_(sourceLine, nature);
+            Moves_(sourceLine, moves);
+            if (ability != ABILITY_NONE && !(fuzzCase.reductions & FUZZ_NO_ABILITIES))
+                Ability_(sourceLine, ability);
+            if (item != ITEM_NONE && !(fuzzCase.reductions & FUZZ_NO_ITEMS))
+                Item_(sourceLine, item);
+            ClosePokemon(sourceLine);
+        }
+    }
+
+    DATA.fuzzCase = fuzzCase;
+    DATA.fuzzRng = rng;
+}
+
+static struct FuzzCase NewFuzzCase(u32 seed, u32 n, bool32 isDouble)
+{
+    rng_value_t rng = LocalRandomSeed(seed ^ ((2 * n + isDouble) * 0x9E3779B9));
+    // Kept positive because the seed is printed with %d.
+    seed = LocalRandom32(&rng) & 0x7FFFFFFF;
+    return (struct FuzzCase) { .seed = seed, .turns = 1 + seed % MAX_FUZZ_TURNS };
+}
+
+// Finds the n-th case that is one step smaller than fuzzCase, if there
+// are that many.
+static bool32 ReduceFuzzCase(struct FuzzCase fuzzCase, bool32 isDouble, u32 n, struct FuzzCase *reduced)
+{
+    static const u16 sReductions[] = { FUZZ_NO_ITEMS, FUZZ_NO_ABILITIES, FUZZ_ONE_MOVE };
+    u32 i, side, partySize;
+    u32 partySizes[NUM_BATTLE_SIDES];
+    rng_value_t rng = LocalRandomSeed(fuzzCase.seed);
+
+    *reduced = fuzzCase;
+    if (fuzzCase.turns > 1 && n-- == 0)
+    {
+        reduced->turns = fuzzCase.turns / 2;
+        return TRUE;
+    }
+    if (fuzzCase.turns > 2 && n-- == 0)
+    {
+        reduced->turns = fuzzCase.turns - 1;
+        return TRUE;
+    }
+    for (i = 0; i < ARRAY_COUNT(sReductions); i++)
+    {
+        if (!(fuzzCase.reductions & sReductions[i]) && n-- == 0)
+        {
+            reduced->reductions |= sReductions[i];
+            return TRUE;
+        }
+    }
+
+    FuzzPartySizes(&rng, isDouble, partySizes);
+    for (side = 0; side < NUM_BATTLE_SIDES; side++)
+    {
+        partySize = 0;
+        for (i = 0; i < partySizes[side]; i++)
+        {
+            if (!(fuzzCase.reductions & FuzzDropReduction(side, i)))
+                partySize++;
+        }
+        for (i = 0; partySize > (isDouble ? 2 : 1) && i < partySizes[side]; i++)
+        {
+            if (!(fuzzCase.reductions & FuzzDropReduction(side, i)) && n-- == 0)
+            {
+                reduced->reductions |= FuzzDropReduction(side, i);
+                return TRUE;
+            }
+        }
+    }
+    return FALSE;
+}
+
+static u32 ParseFuzzNumber(const char **string)
+{
+    u32 n = 0;
+    while (**string >= '0' && **string <= '9')
+        n = n * 10 + *(*string)++ - '0';
+    if (**string == '-' || **string == '/')
+        (*string)++;
+    return n;
+}
+
+bool32 GetFuzzCase(u32 n, bool32 isDouble, struct FuzzCase *fuzzCase)
+{
+    const char *string = gTestRunnerFuzz;
+
+    if (*string == 's' || *string == 'd')
+    {
+        // Reproduce a case, and try each of the cases one step smaller
+        // so that the smallest that still fails can be found.
+        struct FuzzCase failed;
+        if ((*string++ == 'd') != isDouble)
+            return FALSE;
+        failed.seed = ParseFuzzNumber(&string);
+        failed.turns = ParseFuzzNumber(&string);
+        failed.reductions = ParseFuzzNumber(&string);
+        if (n == 0)
+        {
+            *fuzzCase = failed;
+            return TRUE;
+        }
+        return ReduceFuzzCase(failed, isDouble, n - 1, fuzzCase);
+    }
+    else
+    {
+        u32 seed = ParseFuzzNumber(&string);
+        u32 cases = *string != '\0' ? ParseFuzzNumber(&string) : FUZZ_TESTS;
+        if (n >= cases)
+            return FALSE;
+        *fuzzCase = NewFuzzCase(seed, n, isDouble);
+        return TRUE;
+    }
+}
+
 static const char *const sBattlerIdentifiersSingles[] =
 {
     "player",
@@ -1902,6 +2273,10 @@ static void PushBattlerAction(u32 sourceLine, s32 battlerId, u32 actionType, u32
 
 void TestRunner_Battle_CheckBattleRecordActionType(u32 battlerId, u32 recordIndex, u32 actionType)
 {
+    // The actions are chosen as they are needed instead.
+    if (DATA.fuzzCase.turns)
+        return;
+
     // An illegal move choice will cause the battle to request a new
     // move slot and target. This detects the move slot.
     if (actionType == RECORDED_MOVE_SLOT
@@ -1977,6 +2352,80 @@ void TestRunner_Battle_CheckBattleRecordActionType(u32 battlerId, u32 recordInde
     }
 }
 
+// A random Pokémon that could be switched in for the battler, or a random
+// fainted one for Revival Blessing.
+static u32 FuzzPartyIndex(u32 battlerId, bool32 fainted)
+{
+    u32 i, j, partyIndexesCount = 0;
+    u8 partyIndexes[PARTY_SIZE];
+    struct Pokemon *party = GetBattlerParty(battlerId);
+
+    for (i = 0; i < PARTY_SIZE; i++)
+    {
+        u32 species = GetMonData(&party[i], MON_DATA_SPECIES_OR_EGG);
+        if (species == SPECIES_NONE || species == SPECIES_EGG)
+            continue;
+        if (fainted != (GetMonData(&party[i], MON_DATA_HP) == 0))
+            continue;
+        for (j = 0; j < gBattlersCount; j++)
+        {
+            if (GetBattlerSide(j) == GetBattlerSide(battlerId)
+             && (gBattlerPartyIndexes[j] == i
+              || (j != battlerId && gBattleStruct->monToSwitchIntoId[j] == i)))
+                break;
+        }
+        if (j == gBattlersCount)
+            partyIndexes[partyIndexesCount++] = i;
+    }
+
+    if (partyIndexesCount == 0)
+        return PARTY_SIZE;
+    return partyIndexes[FuzzRandom(&DATA.fuzzRng, partyIndexesCount)];
+}
+
+void TestRunner_Battle_FuzzBattleRecordAction(u32 battlerId, u32 actionType, u8 *action)
+{
+    u32 i, unusableMoves, caseId;
+
+    if (!DATA.fuzzCase.turns)
+        return;
+
+    switch (actionType)
+    {
+    case RECORDED_ACTION_TYPE:
+        if (gBattleResults.battleTurnCounter >= DATA.fuzzCase.turns)
+            *action = 0xFF; // End the battle.
+        else if (FuzzRandom(&DATA.fuzzRng, 4) == 0 && FuzzPartyIndex(battlerId, FALSE) != PARTY_SIZE)
+            *action = B_ACTION_SWITCH;
+        else
+            *action = B_ACTION_USE_MOVE;
+        break;
+    case RECORDED_MOVE_SLOT:
+        // The battle does not ask for a move if none are usable.
+        unusableMoves = CheckMoveLimitations(battlerId, 0, MOVE_LIMITATIONS_ALL);
+        do
+            i = FuzzRandom(&DATA.fuzzRng, MAX_MON_MOVES);
+        while (unusableMoves & (1u << i) && unusableMoves != ALL_MOVES_MASK);
+        *action = i;
+        break;
+    case RECORDED_MOVE_TARGET:
+        i = FuzzRandom(&DATA.fuzzRng, gBattlersCount - 1);
+        *action = i < battlerId ? i : i + 1;
+        break;
+    case RECORDED_PARTY_INDEX:
+        // Answer in the way the party menu would.
+        caseId = gBattleResources->bufferA[battlerId][1];
+        if (caseId == PARTY_ACTION_CANT_SWITCH || caseId == PARTY_ACTION_ABILITY_PREVENTS)
+            *action = PARTY_SIZE;
+        else
+            *action = FuzzPartyIndex(battlerId, caseId == PARTY_ACTION_CHOOSE_FAINTED_MON);
+        break;
+    default:
+        *action = 0;
+        break;
+    }
+}
+
 void OpenTurn(u32 sourceLine)
 {
     INVALID_IF(DATA.turnState != TURN_CLOSED, "Nested TURN");
@@ -2785,6 +3234,11 @@ u32 TestRunner_Battle_GetChosenGimmick(u32 side, u32 partyIndex)
     return DATA.chosenGimmick[side][partyIndex];
 }
 
+u32 TestRunner_Battle_GetAiDecisionsPerFrame(void)
+{
+    return DATA.aiDecisionsPerFrame;
+}
+
 // TODO: Consider storing the last successful i and searching from i+1
 // to improve performance.
 struct AILogLine *GetLogLine(u32 battlerId, u32 moveIndex)
@@ -0,0 +1,643 @@
+// assetcache: a content-addressed cache for generated assets.
+//
+// Runs a command whose outputs depend only on its arguments, the tool
+// that runs it and the contents of its declared inputs. The outputs are
+// stored under a key computed from all of those, so the next time the
+// same command is run on the same inputs (from any checkout or branch)
+// they're copied out of the cache instead of being regenerated.
+//
+// Cache layout:
+//   <dir>/objects/<2 hex digits>/<62 hex digits>/<n>   n-th output of an entry
+//   <dir>/tmp/                                          entries being written
+//   <dir>/stats                                         one "H <tool>" or "M <tool>" line per lookup
+//
+// Entries are written to tmp/ and renamed into objects/ once complete,
+// so concurrent builds sharing a cache never see a partial entry.
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sha256.h"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Bump this when the key or the layout changes to ignore old entries.
+#define CACHE_VERSION "assetcache 1"
+#define PATH_SIZE 4096
+
+static void usage(FILE *file, char *argv0)
+{
+    fprintf(file, "Usage: %s -d <dir> [-i <input>]... [-o <output>]... [-s] [-u] -- <command> [<args>...]\n", argv0);
+    fprintf(file, "       %s -d <dir> -stats\n", argv0);
+    fprintf(file, "       %s -d <dir> -reset-stats\n", argv0);
+    fprintf(file, "Options:\n");
+    fprintf(file, "  -d <dir>     cache directory; if empty, the command is just run\n");
+    fprintf(file, "  -i <input>   a file the command reads\n");
+    fprintf(file, "  -o <output>  a file the command writes\n");
+    fprintf(file, "  -s           the command also reads stdin\n");
+    fprintf(file, "  -u           when restoring, don't rewrite outputs that are already up to date\n");
+    fprintf(file, "  -stats       print the hit and miss counts, and the size of the cache\n");
+    fprintf(file, "  -reset-stats clear the hit and miss counts\n");
+}
+
+#ifdef _WIN32
+
+// There's no cache on Windows; the command is just run.
+int main(int argc, char *argv[])
+{
+    int i;
+    for (i = 1; i < argc && strcmp(argv[i], "--") != 0; i++)
+        ;
+    if (i + 1 >= argc)
+    {
+        usage(stderr, argv[0]);
+        return 1;
+    }
+    return _spawnvp(_P_WAIT, argv[i + 1], (const char *const *)&argv[i + 1]);
+}
+
+#else
+
+struct Buffer
+{
+    unsigned char *data;
+    size_t size;
+};
+
+static bool read_stream(int fd, struct Buffer *buffer)
+{
+    size_t capacity = 65536;
+    buffer->data = malloc(capacity);
+    buffer->size = 0;
+    if (!buffer->data)
+        return false;
+    for (;;)
+    {
+        if (buffer->size == capacity)
+        {
+            capacity *= 2;
+            unsigned char *data = realloc(buffer->data, capacity);
+            if (!data)
+                return false;
+            buffer->data = data;
+        }
+        ssize_t n = read(fd, buffer->data + buffer->size, capacity - buffer->size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return false;
+        if (n == 0)
+            return true;
+        buffer->size += n;
+    }
+}
+
+static bool hash_file(struct Sha256 *sha, const char *path)
+{
+    unsigned char buffer[65536];
+    size_t n;
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return false;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        sha256_update(sha, buffer, n);
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+// Length-prefixed, so that adjacent strings can't run together.
+static void hash_string(struct Sha256 *sha, const char *s)
+{
+    size_t n = strlen(s);
+    unsigned char length[4] = { n >> 24, n >> 16, n >> 8, n };
+    sha256_update(sha, length, sizeof(length));
+    sha256_update(sha, s, n);
+}
+
+// Finds the executable that execvp would run for 'name'.
+static bool find_executable(const char *name, char *path, size_t path_size)
+{
+    if (strchr(name, '/'))
+    {
+        snprintf(path, path_size, "%s", name);
+        return access(path, X_OK) == 0;
+    }
+
+    const char *dirs = getenv("PATH");
+    if (!dirs)
+        dirs = "/usr/bin:/bin";
+    while (*dirs)
+    {
+        const char *end = strchr(dirs, ':');
+        size_t n = end ? (size_t)(end - dirs) : strlen(dirs);
+        if (n == 0)
+            snprintf(path, path_size, "%s", name);
+        else
+            snprintf(path, path_size, "%.*s/%s", (int)n, dirs, name);
+        if (access(path, X_OK) == 0)
+            return true;
+        dirs += n;
+        if (*dirs == ':')
+            dirs++;
+    }
+    return false;
+}
+
+// Formats a path into a PATH_SIZE buffer, failing if it doesn't fit.
+static bool make_path(char *path, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(path, PATH_SIZE, format, args);
+    va_end(args);
+    return n >= 0 && n < PATH_SIZE;
+}
+
+static const char *base_name(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+static bool make_dir(const char *path)
+{
+    return mkdir(path, 0777) == 0 || errno == EEXIST;
+}
+
+// Copies 'source' to 'dest' through a temporary file, so that 'dest' is
+// either left untouched or completely replaced.
+static bool copy_file(const char *source, const char *dest)
+{
+    char temp_path[PATH_SIZE];
+    unsigned char buffer[65536];
+    bool ok = true;
+    size_t n;
+
+    snprintf(temp_path, sizeof(temp_path), "%s.assetcache.%ld", dest, (long)getpid());
+
+    FILE *in = fopen(source, "rb");
+    if (!in)
+        return false;
+    FILE *out = fopen(temp_path, "wb");
+    if (!out)
+    {
+        fclose(in);
+        return false;
+    }
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+    {
+        if (fwrite(buffer, 1, n, out) != n)
+        {
+            ok = false;
+            break;
+        }
+    }
+    if (ferror(in))
+        ok = false;
+    fclose(in);
+    if (fclose(out) != 0)
+        ok = false;
+    if (ok && rename(temp_path, dest) != 0)
+        ok = false;
+    if (!ok)
+        remove(temp_path);
+    return ok;
+}
+
+static void remove_dir(const char *path)
+{
+    char entry_path[PATH_SIZE];
+    DIR *dir = opendir(path);
+    if (dir)
+    {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+            snprintf(entry_path, sizeof(entry_path), "%s/%s", path, entry->d_name);
+            remove(entry_path);
+        }
+        closedir(dir);
+    }
+    rmdir(path);
+}
+
+static void record_lookup(const char *cache_dir, bool hit, const char *tool)
+{
+    char path[PATH_SIZE];
+    char line[256];
+
+    snprintf(path, sizeof(path), "%s/stats", cache_dir);
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0666);
+    if (fd < 0)
+        return;
+    // A single short O_APPEND write, so lines from parallel jobs don't interleave.
+    int n = snprintf(line, sizeof(line), "%c %s\n", hit ? 'H' : 'M', tool);
+    if (n >= (int)sizeof(line))
+        n = sizeof(line) - 1;
+    if (write(fd, line, n) != n)
+        fprintf(stderr, "assetcache: could not write '%s'\n", path);
+    close(fd);
+}
+
+static bool files_equal(const char *path_a, const char *path_b)
+{
+    unsigned char buffer_a[65536], buffer_b[65536];
+    bool equal = false;
+    FILE *a = fopen(path_a, "rb");
+    FILE *b = fopen(path_b, "rb");
+    if (a && b)
+    {
+        for (;;)
+        {
+            size_t n_a = fread(buffer_a, 1, sizeof(buffer_a), a);
+            size_t n_b = fread(buffer_b, 1, sizeof(buffer_b), b);
+            if (n_a != n_b || memcmp(buffer_a, buffer_b, n_a) != 0 || ferror(a) || ferror(b))
+                break;
+            if (n_a == 0)
+            {
+                equal = true;
+                break;
+            }
+        }
+    }
+    if (a)
+        fclose(a);
+    if (b)
+        fclose(b);
+    return equal;
+}
+
+static bool restore_entry(const char *entry_dir, int outputs_n, char *outputs[], bool keep_unchanged)
+{
+    char path[PATH_SIZE];
+    for (int i = 0; i < outputs_n; i++)
+    {
+        if (!make_path(path, "%s/%d", entry_dir, i))
+            return false;
+        if (keep_unchanged && files_equal(path, outputs[i]))
+            continue;
+        if (!copy_file(path, outputs[i]))
+            return false;
+    }
+    return true;
+}
+
+static void store_entry(const char *cache_dir, const char *entry_dir, int outputs_n, char *outputs[])
+{
+    char temp_dir[PATH_SIZE];
+    char path[PATH_SIZE];
+
+    snprintf(temp_dir, sizeof(temp_dir), "%s/tmp", cache_dir);
+    make_dir(temp_dir);
+    snprintf(temp_dir, sizeof(temp_dir), "%s/tmp/XXXXXX", cache_dir);
+    if (!mkdtemp(temp_dir))
+    {
+        fprintf(stderr, "assetcache: could not create a directory in '%s/tmp'\n", cache_dir);
+        return;
+    }
+
+    for (int i = 0; i < outputs_n; i++)
+    {
+        if (!make_path(path, "%s/%d", temp_dir, i) || !copy_file(outputs[i], path))
+        {
+            fprintf(stderr, "assetcache: could not store '%s'\n", outputs[i]);
+            remove_dir(temp_dir);
+            return;
+        }
+    }
+
+    // Another job may have stored the same entry in the meantime, in
+    // which case theirs is kept.
+    snprintf(path, sizeof(path), "%.*s", (int)(strrchr(entry_dir, '/') - entry_dir), entry_dir);
+    make_dir(path);
+    if (rename(temp_dir, entry_dir) != 0)
+        remove_dir(temp_dir);
+}
+
+static int run_command(char *command[], const struct Buffer *input)
+{
+    int pipe_fds[2];
+
+    fflush(stdout);
+    fflush(stderr);
+    if (input && pipe(pipe_fds) != 0)
+    {
+        fprintf(stderr, "assetcache: could not create a pipe\n");
+        return 1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        fprintf(stderr, "assetcache: could not fork\n");
+        return 1;
+    }
+    if (pid == 0)
+    {
+        if (input)
+        {
+            dup2(pipe_fds[0], STDIN_FILENO);
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+        }
+        execvp(command[0], command);
+        fprintf(stderr, "assetcache: could not run '%s'\n", command[0]);
+        _exit(127);
+    }
+
+    if (input)
+    {
+        // The command may exit without reading all of its input.
+        signal(SIGPIPE, SIG_IGN);
+        close(pipe_fds[0]);
+        size_t written = 0;
+        while (written < input->size)
+        {
+            ssize_t n = write(pipe_fds[1], input->data + written, input->size - written);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            written += n;
+        }
+        close(pipe_fds[1]);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+            return 1;
+    }
+    if (WIFEXITED(status))
+        return WEXITSTATUS(status);
+    return 128 + WTERMSIG(status);
+}
+
+struct ToolStats
+{
+    char name[128];
+    unsigned long hits;
+    unsigned long misses;
+};
+
+static void count_entries(const char *cache_dir, unsigned long *entries_n, unsigned long long *size)
+{
+    char path[PATH_SIZE];
+    DIR *objects;
+    struct dirent *prefix;
+
+    *entries_n = 0;
+    *size = 0;
+    snprintf(path, sizeof(path), "%s/objects", cache_dir);
+    if (!(objects = opendir(path)))
+        return;
+    while ((prefix = readdir(objects)) != NULL)
+    {
+        if (prefix->d_name[0] == '.')
+            continue;
+        snprintf(path, sizeof(path), "%s/objects/%s", cache_dir, prefix->d_name);
+        DIR *entries = opendir(path);
+        if (!entries)
+            continue;
+        struct dirent *entry;
+        while ((entry = readdir(entries)) != NULL)
+        {
+            if (entry->d_name[0] == '.')
+                continue;
+            (*entries_n)++;
+            snprintf(path, sizeof(path), "%s/objects/%s/%s", cache_dir, prefix->d_name, entry->d_name);
+            DIR *outputs = opendir(path);
+            if (!outputs)
+                continue;
+            struct dirent *output;
+            while ((output = readdir(outputs)) != NULL)
+            {
+                char output_path[PATH_SIZE];
+                struct stat st;
+                if (output->d_name[0] != '.' && make_path(output_path, "%s/%s", path, output->d_name) && stat(output_path, &st) == 0)
+                    *size += st.st_size;
+            }
+            closedir(outputs);
+        }
+        closedir(entries);
+    }
+    closedir(objects);
+}
+
+static int print_stats(const char *cache_dir)
+{
+    static struct ToolStats tools[64];
+    int tools_n = 0;
+    unsigned long hits = 0, misses = 0;
+    char path[PATH_SIZE];
+    char line[256];
+
+    snprintf(path, sizeof(path), "%s/stats", cache_dir);
+    FILE *file = fopen(path, "r");
+    if (file)
+    {
+        while (fgets(line, sizeof(line), file))
+        {
+            line[strcspn(line, "\n")] = '\0';
+            if ((line[0] != 'H' && line[0] != 'M') || line[1] != ' ')
+                continue;
+            int i;
+            for (i = 0; i < tools_n; i++)
+            {
+                if (strcmp(tools[i].name, line + 2) == 0)
+                    break;
+            }
+            if (i == tools_n && tools_n < (int)(sizeof(tools) / sizeof(tools[0])))
+                snprintf(tools[tools_n++].name, sizeof(tools[0].name), "%.127s", line + 2);
+            if (line[0] == 'H')
+            {
+                hits++;
+                if (i < tools_n)
+                    tools[i].hits++;
+            }
+            else
+            {
+                misses++;
+                if (i < tools_n)
+                    tools[i].misses++;
+            }
+        }
+        fclose(file);
+    }
+
+    unsigned long entries_n;
+    unsigned long long size;
+    count_entries(cache_dir, &entries_n, &size);
+
+    printf("%s: %lu hits, %lu misses", cache_dir, hits, misses);
+    if (hits + misses > 0)
+        printf(" (%.1f%% hit rate)", 100.0 * hits / (hits + misses));
+    printf("\n");
+    for (int i = 0; i < tools_n; i++)
+    {
+        printf("  %-20s %8lu hits %8lu misses", tools[i].name, tools[i].hits, tools[i].misses);
+        printf(" (%.1f%%)\n", 100.0 * tools[i].hits / (tools[i].hits + tools[i].misses));
+    }
+    printf("%lu entries, %.1f MiB\n", entries_n, size / (1024.0 * 1024.0));
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *cache_dir = NULL;
+    char **inputs = malloc(sizeof(*inputs) * argc);
+    char **outputs = malloc(sizeof(*outputs) * argc);
+    int inputs_n = 0, outputs_n = 0;
+    bool read_stdin = false;
+    bool keep_unchanged = false;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        const char *option = argv[i];
+        if (strcmp(option, "--") == 0)
+        {
+            i++;
+            break;
+        }
+        else if (strcmp(option, "-d") == 0 && i + 1 < argc)
+        {
+            cache_dir = argv[++i];
+        }
+        else if (strcmp(option, "-i") == 0 && i + 1 < argc)
+        {
+            inputs[inputs_n++] = argv[++i];
+        }
+        else if (strcmp(option, "-o") == 0 && i + 1 < argc)
+        {
+            outputs[outputs_n++] = argv[++i];
+        }
+        else if (strcmp(option, "-s") == 0)
+        {
+            read_stdin = true;
+        }
+        else if (strcmp(option, "-u") == 0)
+        {
+            keep_unchanged = true;
+        }
+        else if (strcmp(option, "-stats") == 0 && cache_dir)
+        {
+            return print_stats(cache_dir);
+        }
+        else if (strcmp(option, "-reset-stats") == 0 && cache_dir)
+        {
+            char path[PATH_SIZE];
+            snprintf(path, sizeof(path), "%s/stats", cache_dir);
+            if (remove(path) != 0 && errno != ENOENT)
+            {
+                fprintf(stderr, "assetcache: could not remove '%s'\n", path);
+                return 1;
+            }
+            return 0;
+        }
+        else
+        {
+            usage(stderr, argv[0]);
+            return 1;
+        }
+    }
+
+    char **command = &argv[i];
+    if (i >= argc)
+    {
+        usage(stderr, argv[0]);
+        return 1;
+    }
+
+    struct Buffer input = { NULL, 0 };
+    if (read_stdin && !read_stream(STDIN_FILENO, &input))
+    {
+        fprintf(stderr, "assetcache: could not read stdin\n");
+        return 1;
+    }
+
+    // Without a cache, or outputs to cache, this is just a wrapper.
+    if (!cache_dir || cache_dir[0] == '\0' || outputs_n == 0)
+        return run_command(command, read_stdin ? &input : NULL);
+
+    // The key covers the tool's executable, the whole command line, and
+    // the contents of every input. If anything can't be hashed, the
+    // command is run uncached.
+    struct Sha256 sha;
+    char tool_path[PATH_SIZE];
+    bool cacheable = true;
+
+    sha256_init(&sha);
+    hash_string(&sha, CACHE_VERSION);
+    if (find_executable(command[0], tool_path, sizeof(tool_path)))
+        cacheable &= hash_file(&sha, tool_path);
+    else
+        cacheable = false;
+    for (char **arg = command; *arg; arg++)
+        hash_string(&sha, *arg);
+    for (int j = 0; j < inputs_n; j++)
+    {
+        hash_string(&sha, inputs[j]);
+        struct Sha256 file_sha;
+        unsigned char file_digest[SHA256_DIGEST_SIZE];
+        sha256_init(&file_sha);
+        cacheable &= hash_file(&file_sha, inputs[j]);
+        sha256_final(&file_sha, file_digest);
+        sha256_update(&sha, file_digest, sizeof(file_digest));
+    }
+    if (read_stdin)
+    {
+        hash_string(&sha, "-");
+        sha256_update(&sha, input.data, input.size);
+    }
+    for (int j = 0; j < outputs_n; j++)
+        hash_string(&sha, outputs[j]);
+
+    if (!cacheable)
+        return run_command(command, read_stdin ? &input : NULL);
+
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char hex[SHA256_DIGEST_SIZE * 2 + 1];
+    char entry_dir[PATH_SIZE];
+    sha256_final(&sha, digest);
+    for (int j = 0; j < SHA256_DIGEST_SIZE; j++)
+        sprintf(&hex[j * 2], "%02x", digest[j]);
+
+    make_dir(cache_dir);
+    snprintf(entry_dir, sizeof(entry_dir), "%s/objects", cache_dir);
+    make_dir(entry_dir);
+    snprintf(entry_dir, sizeof(entry_dir), "%s/objects/%.2s/%s", cache_dir, hex, hex + 2);
+
+    const char *tool = base_name(command[0]);
+    struct stat st;
+    if (stat(entry_dir, &st) == 0 && S_ISDIR(st.st_mode) && restore_entry(entry_dir, outputs_n, outputs, keep_unchanged))
+    {
+        record_lookup(cache_dir, true, tool);
+        return 0;
+    }
+
+    record_lookup(cache_dir, false, tool);
+    int status = run_command(command, read_stdin ? &input : NULL);
+    if (status == 0)
+        store_entry(cache_dir, entry_dir, outputs_n, outputs);
+    free(input.data);
+    return status;
+}
+
+#endif // _WIN32
@@ -0,0 +1,129 @@
+// SHA-256, as specified in FIPS 180-4.
+
+#include <string.h>
+#include "sha256.h"
+
+static const uint32_t k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(struct Sha256 *sha, const unsigned char *block)
+{
+    uint32_t w[64];
+    uint32_t a, b, c, d, e, f, g, h;
+    int i;
+
+    for (i = 0; i < 16; i++)
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    for (; i < 64; i++)
+    {
+        uint32_t s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    a = sha->state[0];
+    b = sha->state[1];
+    c = sha->state[2];
+    d = sha->state[3];
+    e = sha->state[4];
+    f = sha->state[5];
+    g = sha->state[6];
+    h = sha->state[7];
+
+    for (i = 0; i < 64; i++)
+    {
+        uint32_t t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+        uint32_t t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    sha->state[0] += a;
+    sha->state[1] += b;
+    sha->state[2] += c;
+    sha->state[3] += d;
+    sha->state[4] += e;
+    sha->state[5] += f;
+    sha->state[6] += g;
+    sha->state[7] += h;
+}
+
+void sha256_init(struct Sha256 *sha)
+{
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(sha->state, initial, sizeof(initial));
+    sha->length = 0;
+    sha->block_n = 0;
+}
+
+void sha256_update(struct Sha256 *sha, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+
+    sha->length += size;
+
+    if (sha->block_n > 0)
+    {
+        size_t n = 64 - sha->block_n;
+        if (n > size)
+            n = size;
+        memcpy(sha->block + sha->block_n, bytes, n);
+        sha->block_n += n;
+        bytes += n;
+        size -= n;
+        if (sha->block_n < 64)
+            return;
+        sha256_block(sha, sha->block);
+        sha->block_n = 0;
+    }
+
+    for (; size >= 64; bytes += 64, size -= 64)
+        sha256_block(sha, bytes);
+
+    memcpy(sha->block, bytes, size);
+    sha->block_n = size;
+}
+
+void sha256_final(struct Sha256 *sha, unsigned char digest[SHA256_DIGEST_SIZE])
+{
+    uint64_t bits = sha->length * 8;
+    int i;
+
+    sha->block[sha->block_n++] = 0x80;
+    if (sha->block_n > 56)
+    {
+        memset(sha->block + sha->block_n, 0, 64 - sha->block_n);
+        sha256_block(sha, sha->block);
+        sha->block_n = 0;
+    }
+    memset(sha->block + sha->block_n, 0, 56 - sha->block_n);
+    for (i = 0; i < 8; i++)
+        sha->block[56 + i] = bits >> (56 - i * 8);
+    sha256_block(sha, sha->block);
+
+    for (i = 0; i < 8; i++)
+    {
+        digest[i * 4] = sha->state[i] >> 24;
+        digest[i * 4 + 1] = sha->state[i] >> 16;
+        digest[i * 4 + 2] = sha->state[i] >> 8;
+        digest[i * 4 + 3] = sha->state[i];
+    }
+}
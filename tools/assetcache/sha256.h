@@ -0,0 +1,21 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE 32
+
+struct Sha256
+{
+    uint32_t state[8];
+    uint64_t length;
+    unsigned char block[64];
+    size_t block_n;
+};
+
+void sha256_init(struct Sha256 *sha);
+void sha256_update(struct Sha256 *sha, const void *data, size_t size);
+void sha256_final(struct Sha256 *sha, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+#endif // SHA256_H
@@ -4,6 +4,8 @@
 #include <fstream>
 #include <iterator>
 #include <algorithm>
+#include <atomic>
+#include <sstream>
 #include "fileDispatcher.h"
 #include "compressAlgo.h"
 
@@ -21,9 +23,131 @@ enum Option {
     WRITE,
     FRAME_WRITE,
     DECODE,
+    BATCH_WRITE,
+    DIRECTORY_WRITE,
     USAGE,
 };
 
+struct BatchJob {
+    std::string input;
+    std::string output;
+    InputSettings settings;
+};
+
+void readSettings(std::string setting1, std::string setting2, std::string setting3, InputSettings *pSettings)
+{
+    if (setting1.compare("true") == 0)
+        pSettings->canEncodeLO = true;
+    else if (setting1.compare("false") == 0)
+        pSettings->canEncodeLO = false;
+    else
+        fprintf(stderr, "Unrecognized setting1 \"%s\", defaulting to \"true\"\n", setting1.c_str());
+    if (setting2.compare("true") == 0)
+        pSettings->canEncodeSyms = true;
+    else if (setting2.compare("false") == 0)
+        pSettings->canEncodeSyms = false;
+    else
+        fprintf(stderr, "Unrecognized setting2 \"%s\", defaulting to \"true\"\n", setting2.c_str());
+    if (setting3.compare("true") == 0)
+        pSettings->canDeltaSyms = true;
+    else if (setting3.compare("false") == 0)
+        pSettings->canDeltaSyms = false;
+    else
+        fprintf(stderr, "Unrecognized setting3 \"%s\", defaulting to \"true\"\n", setting3.c_str());
+}
+
+bool writeImage(std::string input, std::string output, InputSettings settings)
+{
+    if (!std::filesystem::exists(input))
+    {
+        fprintf(stderr, "Input file %s doesn't exist\n", input.c_str());
+        return false;
+    }
+    CompressedImage image;
+    if (settings.useFrames)
+        image = processImageFrames(input, settings);
+    else
+        image = processImage(input, settings);
+    if (!image.isValid)
+    {
+        fprintf(stderr, "Failed to compress image %s\n", image.fileName.c_str());
+        return false;
+    }
+    std::ofstream fileOut(output.c_str(), std::ios::out | std::ios::binary);
+    fileOut.write(reinterpret_cast<const char *>(image.writeVec.data()), image.writeVec.size()*4);
+    fileOut.close();
+    return true;
+}
+
+//  Each line of the list is "input output", optionally followed by the three settings
+bool readBatchList(std::string listPath, InputSettings defaultSettings, std::vector<BatchJob> *pJobs)
+{
+    std::ifstream fileIn;
+    if (listPath.compare("-") != 0)
+    {
+        fileIn.open(listPath.c_str());
+        if (!fileIn.is_open())
+        {
+            fprintf(stderr, "Error: Couldn't open %s for reading\n", listPath.c_str());
+            return false;
+        }
+    }
+    std::istream &listIn = listPath.compare("-") == 0 ? std::cin : fileIn;
+    std::string line;
+    while (std::getline(listIn, line))
+    {
+        std::istringstream fields(line);
+        std::vector<std::string> words;
+        std::string word;
+        while (fields >> word)
+            words.push_back(word);
+        if (words.size() == 0)
+            continue;
+        BatchJob job;
+        job.settings = defaultSettings;
+        if (words.size() == 2)
+        {
+            job.input = words[0];
+            job.output = words[1];
+        }
+        else if (words.size() == 5)
+        {
+            job.input = words[0];
+            job.output = words[1];
+            readSettings(words[2], words[3], words[4], &job.settings);
+        }
+        else
+        {
+            fprintf(stderr, "Malformed batch line \"%s\"\n", line.c_str());
+            return false;
+        }
+        pJobs->push_back(job);
+    }
+    return true;
+}
+
+bool isUpToDate(std::string input, std::string output)
+{
+    std::error_code error;
+    std::filesystem::file_time_type outputTime = std::filesystem::last_write_time(output, error);
+    if (error)
+        return false;
+    return outputTime >= std::filesystem::last_write_time(input, error) && !error;
+}
+
+//  Whole images are spread over the threads here, so each image is searched on a single thread
+bool writeImages(std::vector<BatchJob> *pJobs, size_t numThreads)
+{
+    std::atomic<bool> allWritten(true);
+    runParallel(pJobs->size(), numThreads, [&](size_t jobIndex) {
+        BatchJob &job = (*pJobs)[jobIndex];
+        job.settings.numThreads = pJobs->size() == 1 ? numThreads : 1;
+        if (!writeImage(job.input, job.output, job.settings))
+            allWritten = false;
+    });
+    return allWritten;
+}
+
 int main(int argc, char *argv[])
 {
     Option option = USAGE;
@@ -31,6 +155,19 @@ int main(int argc, char *argv[])
     std::string input;
     std::string output;
     InputSettings settings(true, true, true);
+    const char *programName = argv[0];
+
+    if (argc > 2 && std::string(argv[1]).compare("-j") == 0)
+    {
+        if (!isNumber(argv[2]))
+        {
+            fprintf(stderr, "Thread count \"%s\" isn't a number\n", argv[2]);
+            return 1;
+        }
+        settings.numThreads = std::stoul(argv[2]);
+        argc -= 2;
+        argv += 2;
+    }
 
     if (argc > 1)
     {
@@ -41,6 +178,10 @@ int main(int argc, char *argv[])
             option = FRAME_WRITE;
         else if (argument.compare("-d") == 0)
             option = DECODE;
+        else if (argument.compare("-b") == 0)
+            option = BATCH_WRITE;
+        else if (argument.compare("-r") == 0)
+            option = DIRECTORY_WRITE;
     }
     switch (option)
     {
@@ -56,29 +197,20 @@ int main(int argc, char *argv[])
                 input = argv[2];
                 output = argv[3];
                 if (argc > 6)
-                {
-                    std::string setting1 = argv[4];
-                    std::string setting2 = argv[5];
-                    std::string setting3 = argv[6];
-                    if (setting1.compare("true") == 0)
-                        settings.canEncodeLO = true;
-                    else if (setting1.compare("false") == 0)
-                        settings.canEncodeLO = false;
-                    else
-                        fprintf(stderr, "Unrecognized setting1 \"%s\", defaulting to \"true\"\n", setting1.c_str());
-                    if (setting2.compare("true") == 0)
-                        settings.canEncodeSyms = true;
-                    else if (setting2.compare("false") == 0)
-                        settings.canEncodeSyms = false;
-                    else
-                        fprintf(stderr, "Unrecognized setting2 \"%s\", defaulting to \"true\"\n", setting2.c_str());
-                    if (setting3.compare("true") == 0)
-                        settings.canDeltaSyms = true;
-                    else if (setting3.compare("false") == 0)
-                        settings.canDeltaSyms = false;
-                    else
-                        fprintf(stderr, "Unrecognized setting3 \"%s\", defaulting to \"true\"\n", setting3.c_str());
-                }
+                    readSettings(argv[4], argv[5], argv[6], &settings);
+            }
+            else
+            {
+                printUsage = true;
+            }
+            break;
+        case BATCH_WRITE:
+        case DIRECTORY_WRITE:
+            if (argc > 2)
+            {
+                input = argv[2];
+                if (argc > 5)
+                    readSettings(argv[3], argv[4], argv[5], &settings);
             }
             else
             {
@@ -111,35 +243,51 @@ int main(int argc, char *argv[])
                     - If the compression instructions can be delta encoded.\n\
                     - If the raw symbols in the compression ca be delta encoded.\n\
                 %s -d \"path/to/some/file.4bpp.smol\" \"path/to/some/file.4bpp\"\n\
-                    Decompresses the first argument and writes it to the second argument.", argv[0], argv[0]);
+                    Decompresses the first argument and writes it to the second argument.\n\
+                %s -b \"path/to/list\"\n\
+                    Compresses every \"input output\" pair listed one per line in the file, or stdin if it's \"-\".\n\
+                    A line can end with its own 3 true/false settings, otherwise the ones given after the list are used.\n\
+                %s -r \"path/to/directory\"\n\
+                    Compresses every .4bpp file under the directory to a .4bpp.smol next to it, skipping up to date ones.\n\
+                    This can also be followed by the 3 true/false settings.\n\
+                Any mode can be preceded by -j N to use N threads, the default is one per core.\n", programName, programName, programName, programName);
 
         return 0;
     }
 
     if (option == WRITE)
     {
-        if (std::filesystem::exists(input))
+        writeImage(input, output, settings);
+    }
+    if (option == BATCH_WRITE)
+    {
+        std::vector<BatchJob> jobs;
+        if (!readBatchList(input, settings, &jobs))
+            return 1;
+        if (!writeImages(&jobs, settings.numThreads))
+            return 1;
+    }
+    if (option == DIRECTORY_WRITE)
+    {
+        if (!std::filesystem::is_directory(input))
         {
-            CompressedImage image;
-            if (settings.useFrames)
-                image = processImageFrames(input, settings);
-            else
-                image = processImage(input, settings);
-            if (image.isValid)
-            {
-                std::ofstream fileOut(output.c_str(), std::ios::out | std::ios::binary);
-                fileOut.write(reinterpret_cast<const char *>(image.writeVec.data()), image.writeVec.size()*4);
-                fileOut.close();
-            }
-            else
-            {
-                fprintf(stderr, "Failed to compress image %s\n", image.fileName.c_str());
-            }
+            fprintf(stderr, "Input directory %s doesn't exist\n", input.c_str());
+            return 1;
         }
-        else
+        FileDispatcher dispatcher(input);
+        dispatcher.initFileList(".4bpp");
+        std::vector<BatchJob> jobs;
+        for (std::string fileName = dispatcher.requestFileName(); !fileName.empty(); fileName = dispatcher.requestFileName())
         {
-            fprintf(stderr, "Input file %s doesn't exist\n", input.c_str());
+            BatchJob job;
+            job.input = fileName;
+            job.output = fileName + ".smol";
+            job.settings = settings;
+            if (!isUpToDate(job.input, job.output))
+                jobs.push_back(job);
         }
+        if (!writeImages(&jobs, settings.numThreads))
+            return 1;
     }
     if (option == DECODE)
     {
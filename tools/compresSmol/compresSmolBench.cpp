@@ -0,0 +1,390 @@
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "compressAlgo.h"
+
+extern "C" {
+#include "lz.h"
+#include "huff.h"
+}
+
+//  Rough cycle costs used to estimate how long each format takes to decode on the GBA.
+//  They're meant for comparing codecs against each other, not as exact timings,
+//  so adjust them if you've measured the decoders in an emulator.
+
+//  smol, decoded by SmolDecompressData in src/decompress.c
+#define SMOL_SETUP_CYCLES           400     //  Header parsing and copying the decoders to IWRAM
+#define SMOL_TABLE_CYCLES           1200    //  Building one tANS decoding table
+#define SMOL_NIBBLE_CYCLES          10      //  Decoding one tANS nibble
+#define SMOL_DELTA_NIBBLE_CYCLES    12      //  Decoding one delta encoded tANS nibble
+#define SMOL_INSTRUCTION_CYCLES     24      //  Reading one instruction in DecodeInstructions
+#define SMOL_COPY_CYCLES            6       //  Per halfword copied from earlier output
+#define SMOL_LITERAL_CYCLES         3       //  Per halfword copied from the symbol vector
+
+//  LZ77, decoded by the BIOS LZ77UnComp functions
+#define LZ_SETUP_CYCLES             60
+#define LZ_FLAG_CYCLES              12      //  Per flag byte
+#define LZ_LITERAL_CYCLES           14      //  Per literal byte
+#define LZ_COPY_CYCLES              24      //  Per back reference
+#define LZ_COPY_BYTE_CYCLES         8       //  Per byte copied by a back reference
+
+//  Huffman, decoded by the BIOS HuffUnComp function
+#define HUFF_SETUP_CYCLES           100
+#define HUFF_BIT_CYCLES             10      //  Per encoded bit, one step down the tree
+#define HUFF_SYMBOL_CYCLES          16      //  Per decoded symbol
+
+#define HUFF_BIT_DEPTH              4
+#define LZ_MIN_DISTANCE             2       //  Same as gbagfx's default, for LZ77UnCompVram compatibility
+
+enum Codec {
+    CODEC_SMOL,
+    CODEC_FAST_SMOL,
+    CODEC_LZ,
+    CODEC_HUFF,
+    NUM_CODECS,
+};
+
+static const char *const sCodecNames[NUM_CODECS] = {"smol", "fastSmol", "lz", "huff"};
+
+struct CodecResult {
+    bool supported = false;
+    bool verified = false;
+    size_t compressedSize = 0;
+    double encodeMs = 0;
+    double decodeCycles = 0;
+};
+
+struct CodecTotals {
+    size_t numFiles = 0;
+    size_t numFailures = 0;
+    size_t rawSize = 0;
+    size_t compressedSize = 0;
+    double encodeMs = 0;
+    double decodeCycles = 0;
+};
+
+//  The gbagfx codecs exit on errors, so say which file was being worked on when that happens
+static std::string sCurrentFile;
+static const char *sCurrentCodec = NULL;
+
+static void reportAbortedRun()
+{
+    if (sCurrentCodec != NULL)
+        fprintf(stderr, "Benchmark aborted while running %s on %s\n", sCurrentCodec, sCurrentFile.c_str());
+}
+
+static double getElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static double estimateSmolCycles(CompressedImage *pImage)
+{
+    double cycles = SMOL_SETUP_CYCLES;
+    if (isModeLoEncoded(pImage->mode))
+        cycles += SMOL_TABLE_CYCLES + 2 * pImage->loVec.size() * SMOL_NIBBLE_CYCLES;
+    if (isModeSymEncoded(pImage->mode))
+        cycles += SMOL_TABLE_CYCLES + 4 * pImage->symVec.size() * (isModeSymDelta(pImage->mode) ? SMOL_DELTA_NIBBLE_CYCLES : SMOL_NIBBLE_CYCLES);
+
+    //  Walk the instructions the same way DecodeInstructions does
+    std::vector<unsigned char> &loVec = pImage->loVec;
+    size_t loIndex = 0;
+    while (loIndex < loVec.size())
+    {
+        size_t length = loVec[loIndex] & LO_LOW_BITS_MASK;
+        if (loVec[loIndex++] & LO_CONTINUE_BIT)
+            length += loVec[loIndex++] << LO_NUM_LOW_BITS;
+        size_t offset = loVec[loIndex] & LO_LOW_BITS_MASK;
+        if (loVec[loIndex++] & LO_CONTINUE_BIT)
+            offset += loVec[loIndex++] << LO_NUM_LOW_BITS;
+
+        cycles += SMOL_INSTRUCTION_CYCLES;
+        if (length != 0)
+            cycles += SMOL_LITERAL_CYCLES + length * SMOL_COPY_CYCLES;
+        else
+            cycles += offset * SMOL_LITERAL_CYCLES;
+    }
+    return cycles;
+}
+
+static CodecResult benchSmol(std::vector<unsigned char> *pInput, std::string fileName, bool isFast)
+{
+    CodecResult result;
+    //  The header stores the image size in 14 bits, in units of 4 bytes
+    if (pInput->size() == 0 || pInput->size() % IMAGE_SIZE_MODIFIER != 0 || pInput->size() / IMAGE_SIZE_MODIFIER > IMAGE_SIZE_MASK)
+        return result;
+    result.supported = true;
+
+    InputSettings settings(!isFast, !isFast, !isFast);
+    settings.numThreads = 1;
+    CompressedImage image;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    processImageData(pInput, &image, settings, fileName);
+    result.encodeMs = getElapsedMs(start);
+    if (!image.isValid)
+        return result;
+
+    std::vector<unsigned short> usBase(pInput->size() / 2);
+    memcpy(usBase.data(), pInput->data(), pInput->size());
+    std::vector<unsigned short> decodedImage;
+    readRawDataVecs(&image.writeVec, &decodedImage);
+    result.verified = verifyCompressionShort(&image, &usBase) && compareVectorsShort(&decodedImage, &usBase);
+    result.compressedSize = image.writeVec.size() * 4;
+    result.decodeCycles = estimateSmolCycles(&image);
+    return result;
+}
+
+static CodecResult benchLZ(std::vector<unsigned char> *pInput)
+{
+    CodecResult result;
+    //  The header stores the size in 24 bits
+    if (pInput->size() == 0 || pInput->size() >= (1 << 24))
+        return result;
+    result.supported = true;
+
+    int compressedSize;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned char *compressed = LZCompress(pInput->data(), pInput->size(), &compressedSize, LZ_MIN_DISTANCE);
+    result.encodeMs = getElapsedMs(start);
+    result.compressedSize = compressedSize;
+
+    int decompressedSize;
+    unsigned char *decompressed = LZDecompress(compressed, compressedSize, &decompressedSize);
+    result.verified = decompressedSize == (int)pInput->size() && memcmp(decompressed, pInput->data(), decompressedSize) == 0;
+    free(decompressed);
+
+    //  Walk the tokens the same way the BIOS does
+    double cycles = LZ_SETUP_CYCLES;
+    size_t srcPos = 4;
+    size_t destPos = 0;
+    while (destPos < pInput->size())
+    {
+        unsigned char flags = compressed[srcPos++];
+        cycles += LZ_FLAG_CYCLES;
+        for (int i = 0; i < 8 && destPos < pInput->size(); i++)
+        {
+            if (flags & (0x80 >> i))
+            {
+                size_t blockSize = (compressed[srcPos] >> 4) + 3;
+                srcPos += 2;
+                destPos += blockSize;
+                cycles += LZ_COPY_CYCLES + blockSize * LZ_COPY_BYTE_CYCLES;
+            }
+            else
+            {
+                srcPos++;
+                destPos++;
+                cycles += LZ_LITERAL_CYCLES;
+            }
+        }
+    }
+    result.decodeCycles = cycles;
+    free(compressed);
+    return result;
+}
+
+static CodecResult benchHuff(std::vector<unsigned char> *pInput)
+{
+    CodecResult result;
+    if (pInput->size() == 0 || pInput->size() % 4 != 0 || pInput->size() >= (1 << 24))
+        return result;
+    result.supported = true;
+
+    int compressedSize;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned char *compressed = HuffCompress(pInput->data(), pInput->size(), &compressedSize, HUFF_BIT_DEPTH);
+    result.encodeMs = getElapsedMs(start);
+    result.compressedSize = compressedSize;
+
+    int decompressedSize;
+    unsigned char *decompressed = HuffDecompress(compressed, compressedSize, &decompressedSize);
+    result.verified = decompressedSize == (int)pInput->size() && memcmp(decompressed, pInput->data(), decompressedSize) == 0;
+    free(decompressed);
+
+    //  Every bit after the header and tree is one step down the tree
+    size_t treeSize = (compressed[4] + 1) * 2;
+    size_t numBits = (compressedSize - 4 - treeSize) * 8;
+    size_t numSymbols = pInput->size() * 8 / HUFF_BIT_DEPTH;
+    result.decodeCycles = HUFF_SETUP_CYCLES + numBits * HUFF_BIT_CYCLES + numSymbols * HUFF_SYMBOL_CYCLES;
+    free(compressed);
+    return result;
+}
+
+static CodecResult benchCodec(Codec codec, std::vector<unsigned char> *pInput, std::string fileName)
+{
+    switch (codec)
+    {
+        case CODEC_SMOL:
+            return benchSmol(pInput, fileName, false);
+        case CODEC_FAST_SMOL:
+            return benchSmol(pInput, fileName, true);
+        case CODEC_LZ:
+            return benchLZ(pInput);
+        case CODEC_HUFF:
+            return benchHuff(pInput);
+        default:
+            return CodecResult();
+    }
+}
+
+static bool readFile(std::string filePath, std::vector<unsigned char> *pFileData)
+{
+    FILE *fp = fopen(filePath.c_str(), "rb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error: Couldn't open %s for reading bytes\n", filePath.c_str());
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    pFileData->resize(size);
+    bool success = fread(pFileData->data(), 1, size, fp) == (size_t)size;
+    fclose(fp);
+    return success;
+}
+
+static void printUsage(const char *programName)
+{
+    printf("Usage: %s [options] PATH...\n\
+Compresses every file with each codec and reports compressed size, encode time and estimated decode cycles.\n\
+Directories are searched recursively for files with the chosen extension.\n\
+Options:\n\
+    -e EXT      Extension to look for in directories, defaults to \".4bpp\"\n\
+    -c LIST     Comma separated codecs to run, from smol, fastSmol, lz and huff, defaults to all of them\n\
+    -q          Only print the totals for each codec\n", programName);
+}
+
+int main(int argc, char *argv[])
+{
+    std::string extension = ".4bpp";
+    bool useCodec[NUM_CODECS] = {true, true, true, true};
+    bool quiet = false;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument.compare("-e") == 0 && i + 1 < argc)
+        {
+            extension = argv[++i];
+        }
+        else if (argument.compare("-c") == 0 && i + 1 < argc)
+        {
+            std::string codecList = argv[++i];
+            for (int codec = 0; codec < NUM_CODECS; codec++)
+                useCodec[codec] = false;
+            std::stringstream listStream(codecList);
+            std::string codecName;
+            while (std::getline(listStream, codecName, ','))
+            {
+                int codec;
+                for (codec = 0; codec < NUM_CODECS; codec++)
+                    if (codecName.compare(sCodecNames[codec]) == 0)
+                        break;
+                if (codec == NUM_CODECS)
+                {
+                    fprintf(stderr, "Unknown codec \"%s\"\n", codecName.c_str());
+                    return 1;
+                }
+                useCodec[codec] = true;
+            }
+        }
+        else if (argument.compare("-q") == 0)
+        {
+            quiet = true;
+        }
+        else if (argument.size() > 1 && argument[0] == '-')
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            paths.push_back(argument);
+        }
+    }
+    if (paths.size() == 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> fileNames;
+    for (std::string path : paths)
+    {
+        if (std::filesystem::is_directory(path))
+        {
+            FileDispatcher dispatcher(path);
+            dispatcher.initFileList(extension);
+            for (std::string fileName = dispatcher.requestFileName(); !fileName.empty(); fileName = dispatcher.requestFileName())
+                fileNames.push_back(fileName);
+        }
+        else if (std::filesystem::exists(path))
+        {
+            fileNames.push_back(path);
+        }
+        else
+        {
+            fprintf(stderr, "Input %s doesn't exist\n", path.c_str());
+            return 1;
+        }
+    }
+    if (fileNames.size() == 0)
+    {
+        fprintf(stderr, "No %s files found\n", extension.c_str());
+        return 1;
+    }
+
+    CodecTotals totals[NUM_CODECS];
+    atexit(reportAbortedRun);
+    if (!quiet)
+        printf("%-56s %-8s %8s %8s %7s %10s %12s %s\n", "file", "codec", "raw", "size", "ratio", "encode ms", "decode cyc", "check");
+    for (std::string fileName : fileNames)
+    {
+        std::vector<unsigned char> input;
+        if (!readFile(fileName, &input))
+            return 1;
+        for (int codec = 0; codec < NUM_CODECS; codec++)
+        {
+            if (!useCodec[codec])
+                continue;
+            sCurrentFile = fileName;
+            sCurrentCodec = sCodecNames[codec];
+            CodecResult result = benchCodec((Codec)codec, &input, fileName);
+            sCurrentCodec = NULL;
+            if (!result.supported)
+                continue;
+            CodecTotals &total = totals[codec];
+            total.numFiles++;
+            total.rawSize += input.size();
+            total.compressedSize += result.compressedSize;
+            total.encodeMs += result.encodeMs;
+            total.decodeCycles += result.decodeCycles;
+            if (!result.verified)
+                total.numFailures++;
+            if (!quiet)
+                printf("%-56s %-8s %8zu %8zu %6.1f%% %10.2f %12.0f %s\n", fileName.c_str(), sCodecNames[codec], input.size(), result.compressedSize,
+                       100.0 * result.compressedSize / input.size(), result.encodeMs, result.decodeCycles, result.verified ? "ok" : "FAIL");
+        }
+    }
+
+    if (!quiet)
+        printf("\n");
+    printf("%-8s %6s %10s %10s %7s %10s %14s %8s\n", "codec", "files", "raw", "size", "ratio", "encode ms", "decode cyc", "failures");
+    bool allVerified = true;
+    for (int codec = 0; codec < NUM_CODECS; codec++)
+    {
+        CodecTotals &total = totals[codec];
+        if (!useCodec[codec] || total.numFiles == 0)
+            continue;
+        printf("%-8s %6zu %10zu %10zu %6.1f%% %10.1f %14.0f %8zu\n", sCodecNames[codec], total.numFiles, total.rawSize, total.compressedSize,
+               100.0 * total.compressedSize / total.rawSize, total.encodeMs, total.decodeCycles, total.numFailures);
+        if (total.numFailures != 0)
+            allVerified = false;
+    }
+
+    return allVerified ? 0 : 1;
+}
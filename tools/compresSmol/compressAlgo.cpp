@@ -8,32 +8,81 @@ ShortCopy::ShortCopy(size_t index, size_t length, size_t offset, unsigned short
     this->firstSymbol = firstSymbol;
 }
 
-bool getShortCopies(std::vector<unsigned short> *pInput, size_t minLength, std::vector<ShortCopy> *pShortCopies)
+//  Finds the longest earlier match for every position, preferring the closest one on ties.
+//  Only positions sharing the first two symbols can give a match worth using,
+//  so candidates are walked through a hash chain keyed on that pair.
+std::vector<ShortMatch> findShortMatches(std::vector<unsigned short> *pInput)
 {
-    size_t iteration = 0;
-    std::vector<char> checkVec(pInput->size());
-    for (size_t i = 0; i < checkVec.size(); i++)
-        checkVec[i] = ' ';
-    for (size_t startIndex = 1; startIndex < pInput->size(); startIndex++)
+    size_t inputSize = pInput->size();
+    std::vector<ShortMatch> matches(inputSize);
+    if (inputSize < 2)
+        return matches;
+
+    std::vector<size_t> prevPos(inputSize, SIZE_MAX);
+    std::unordered_map<unsigned int, size_t> lastPos;
+    for (size_t startIndex = 0; startIndex + 1 < inputSize; startIndex++)
     {
+        unsigned int key = (*pInput)[startIndex] | ((unsigned int)(*pInput)[startIndex + 1] << 16);
+        auto it = lastPos.find(key);
         size_t longestLength = 0;
-        size_t longestOffset;
-        for (size_t searchOffset = 1; searchOffset <= startIndex && searchOffset < 32767; searchOffset++)
+        size_t longestOffset = 0;
+        if (it != lastPos.end())
         {
-            size_t currLength = 0;
-            while (startIndex + currLength < pInput->size()
-                   && (*pInput)[startIndex + currLength] == (*pInput)[startIndex + currLength - searchOffset])
-                currLength++;
-
-            if (currLength > longestLength)
+            prevPos[startIndex] = it->second;
+            for (size_t searchPos = it->second; searchPos != SIZE_MAX; searchPos = prevPos[searchPos])
             {
-                longestLength = currLength;
-                longestOffset = searchOffset;
+                size_t searchOffset = startIndex - searchPos;
+                if (searchOffset > MAX_COPY_OFFSET)
+                    break;
+                //  A candidate can only be longer if it also matches one past the current best
+                if (longestLength >= 2
+                 && (startIndex + longestLength >= inputSize
+                  || (*pInput)[startIndex + longestLength] != (*pInput)[searchPos + longestLength]))
+                    continue;
+                size_t currLength = 2;
+                while (startIndex + currLength < inputSize
+                       && (*pInput)[startIndex + currLength] == (*pInput)[searchPos + currLength])
+                    currLength++;
+
+                if (currLength > longestLength)
+                {
+                    longestLength = currLength;
+                    longestOffset = searchOffset;
+                    //  Nothing can beat a match that runs to the end of the image
+                    if (startIndex + currLength == inputSize)
+                        break;
+                }
             }
+            it->second = startIndex;
         }
+        else
+        {
+            lastPos[key] = startIndex;
+        }
+        matches[startIndex].length = longestLength;
+        matches[startIndex].offset = longestOffset;
+    }
+    return matches;
+}
 
-        if (longestLength > 32767)
-            longestLength = 32767;
+bool getShortCopies(std::vector<unsigned short> *pInput, size_t minLength, std::vector<ShortCopy> *pShortCopies)
+{
+    std::vector<ShortMatch> matches = findShortMatches(pInput);
+    return getShortCopies(pInput, &matches, minLength, pShortCopies);
+}
+
+bool getShortCopies(std::vector<unsigned short> *pInput, std::vector<ShortMatch> *pMatches, size_t minLength, std::vector<ShortCopy> *pShortCopies)
+{
+    std::vector<char> checkVec(pInput->size());
+    for (size_t i = 0; i < checkVec.size(); i++)
+        checkVec[i] = ' ';
+    for (size_t startIndex = 1; startIndex < pInput->size(); startIndex++)
+    {
+        size_t longestLength = (*pMatches)[startIndex].length;
+        size_t longestOffset = (*pMatches)[startIndex].offset;
+
+        if (longestLength > MAX_COPY_LENGTH)
+            longestLength = MAX_COPY_LENGTH;
         if (longestLength >= minLength)
         {
             //  Handle non-copies
@@ -85,6 +134,105 @@ bool getShortCopies(std::vector<unsigned short> *pInput, size_t minLength, std::
     return verifyShortCopies(pShortCopies, pInput);
 }
 
+static size_t getLoFieldBytes(size_t value)
+{
+    return (value >> LO_NUM_LOW_BITS) != 0 ? 2 : 1;
+}
+
+//  Chooses the copies that minimize the raw size of the lo and sym streams, rather than
+//  greedily taking every long enough match. A copy instruction costs its length and offset
+//  fields plus the symbol in front of it, a run of raw symbols costs 2 bytes per symbol
+//  plus the zero length and the run length fields.
+bool getOptimalShortCopies(std::vector<unsigned short> *pInput, std::vector<ShortMatch> *pMatches, std::vector<ShortCopy> *pShortCopies)
+{
+    struct ParseStep {
+        size_t cost = SIZE_MAX;
+        size_t prevIndex = 0;
+        bool prevIsRaw = false;
+        size_t runLength = 0;
+        size_t copyOffset = 0;
+    };
+    size_t inputSize = pInput->size();
+    //  Best way to encode the first i symbols when the last instruction is a raw run or a copy
+    std::vector<ParseStep> rawSteps(inputSize + 1);
+    std::vector<ParseStep> copySteps(inputSize + 1);
+    copySteps[0].cost = 0;
+
+    for (size_t i = 0; i < inputSize; i++)
+    {
+        bool rawIsBest = rawSteps[i].cost < copySteps[i].cost;
+        size_t bestCost = rawIsBest ? rawSteps[i].cost : copySteps[i].cost;
+        if (bestCost == SIZE_MAX)
+            continue;
+
+        //  Either extend the current raw run by one symbol or start a new one
+        ParseStep step;
+        step.cost = bestCost + 2 * sizeof(unsigned short);
+        step.prevIndex = i;
+        step.prevIsRaw = rawIsBest;
+        step.runLength = 1;
+        if (rawSteps[i].cost != SIZE_MAX && rawSteps[i].runLength < MAX_COPY_LENGTH)
+        {
+            size_t runLength = rawSteps[i].runLength + 1;
+            size_t extendCost = rawSteps[i].cost + sizeof(unsigned short)
+                              + getLoFieldBytes(runLength) - getLoFieldBytes(runLength - 1);
+            if (extendCost <= step.cost)
+            {
+                step.cost = extendCost;
+                step.prevIndex = rawSteps[i].prevIndex;
+                step.prevIsRaw = rawSteps[i].prevIsRaw;
+                step.runLength = runLength;
+            }
+        }
+        if (step.cost < rawSteps[i + 1].cost)
+            rawSteps[i + 1] = step;
+
+        //  A copy writes symbol i itself, then copies from the match at i + 1
+        if (i + 1 >= inputSize)
+            continue;
+        ShortMatch match = (*pMatches)[i + 1];
+        size_t maxLength = match.length < MAX_COPY_LENGTH ? match.length : MAX_COPY_LENGTH;
+        if (maxLength < 2)
+            continue;
+        size_t copyBase = bestCost + sizeof(unsigned short) + getLoFieldBytes(match.offset);
+        //  Every length up to the one byte limit is tried, past it only the full match is worth taking
+        size_t shortLimit = maxLength < LO_LOW_BITS_MASK ? maxLength : LO_LOW_BITS_MASK;
+        for (size_t length = 2; length <= maxLength; length++)
+        {
+            if (length > shortLimit)
+                length = maxLength;
+            size_t end = i + 1 + length;
+            size_t copyCost = copyBase + getLoFieldBytes(length);
+            if (copyCost < copySteps[end].cost)
+            {
+                copySteps[end].cost = copyCost;
+                copySteps[end].prevIndex = i;
+                copySteps[end].prevIsRaw = rawIsBest;
+                copySteps[end].runLength = length;
+                copySteps[end].copyOffset = match.offset;
+            }
+        }
+    }
+
+    std::vector<ShortCopy> reversedCopies;
+    size_t index = inputSize;
+    bool isRaw = rawSteps[inputSize].cost < copySteps[inputSize].cost;
+    while (index != 0)
+    {
+        ParseStep &step = isRaw ? rawSteps[index] : copySteps[index];
+        if (isRaw)
+            reversedCopies.push_back(ShortCopy(step.prevIndex, index - step.prevIndex, 0, 0));
+        else
+            reversedCopies.push_back(ShortCopy(step.prevIndex + 1, step.runLength, step.copyOffset, (*pInput)[step.prevIndex]));
+        index = step.prevIndex;
+        isRaw = step.prevIsRaw;
+    }
+    for (size_t i = reversedCopies.size(); i > 0; i--)
+        pShortCopies->push_back(reversedCopies[i - 1]);
+
+    return verifyShortCopies(pShortCopies, pInput);
+}
+
 bool verifyShortCopies(std::vector<ShortCopy> *pCopies, std::vector<unsigned short> *pImage)
 {
     size_t totalLength = 0;
@@ -114,7 +262,7 @@ bool verifyShortCopies(std::vector<ShortCopy> *pCopies, std::vector<unsigned sho
     return true;
 }
 
-bool getShortInstructions(std::vector<ShortCopy> *pCopies, std::vector<ShortCompressionInstruction> *pInstructions, std::vector<unsigned short> *pInput)
+void getShortInstructions(std::vector<ShortCopy> *pCopies, std::vector<ShortCompressionInstruction> *pInstructions, std::vector<unsigned short> *pInput)
 {
     for (ShortCopy copy : (*pCopies))
     {
@@ -126,7 +274,6 @@ bool getShortInstructions(std::vector<ShortCopy> *pCopies, std::vector<ShortComp
         currInstruction.buildBytes(pInput);
         pInstructions->push_back(currInstruction);
     }
-    return true;
 }
 
 void getLosFromInstructions(std::vector<ShortCompressionInstruction> *pInstructions, std::vector<unsigned char> *pOutput)
@@ -1173,6 +1320,51 @@ CompressedImage processImageFrames(std::string fileName, InputSettings settings)
     return image;
 }
 
+void runParallel(size_t numJobs, size_t numThreads, std::function<void(size_t)> job)
+{
+    if (numThreads == 0)
+        numThreads = std::thread::hardware_concurrency();
+    if (numThreads > numJobs)
+        numThreads = numJobs;
+    if (numThreads <= 1)
+    {
+        for (size_t i = 0; i < numJobs; i++)
+            job(i);
+        return;
+    }
+
+    std::atomic<size_t> nextJob(0);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < numThreads; i++)
+    {
+        workers.emplace_back([&]() {
+            for (size_t jobIndex = nextJob++; jobIndex < numJobs; jobIndex = nextJob++)
+                job(jobIndex);
+        });
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+#define MIN_CODE_LENGTH     2
+#define MAX_CODE_LENGTH     15
+
+//  The copies found for a single minimum code length, shared by every mode tried on them
+struct ParseCandidate {
+    bool isValid = false;
+    bool copyFail = false;
+    bool byteFail = false;
+    std::vector<unsigned char> loVec;
+    std::vector<unsigned short> symVec;
+};
+
+struct ModeCandidate {
+    bool isValid = false;
+    bool compressionFail = false;
+    bool uIntConversionFail = false;
+    CompressedImage image;
+};
+
 bool processImageData(std::vector<unsigned char> *pInput, CompressedImage *pImage, InputSettings settings, std::string fileName)
 {
     CompressionMode someMode;
@@ -1185,125 +1377,142 @@ bool processImageData(std::vector<unsigned char> *pInput, CompressedImage *pImag
     std::vector<unsigned short> usBase(pInput->size() / 2);
     memcpy(usBase.data(), pInput->data(), pInput->size());
 
-    std::vector<unsigned char> bestLO;
-    std::vector<unsigned short> bestSym;
-    std::vector<ShortCompressionInstruction> bestInstructions;
-
-    for (size_t minCodeLength = 2; minCodeLength <= 15; minCodeLength++)
+    std::vector<CompressionMode> modesToUse = {BASE_ONLY, ENCODE_SYMS, ENCODE_DELTA_SYMS, ENCODE_LO, ENCODE_BOTH, ENCODE_BOTH_DELTA_SYMS};
+    if (fileName.find("test/compression/") != std::string::npos)
+    {
+        if (fileName.find("mode_0.4bpp") != std::string::npos)
+            modesToUse = {BASE_ONLY};
+        else if (fileName.find("mode_1.4bpp") != std::string::npos)
+            modesToUse = {ENCODE_SYMS};
+        else if (fileName.find("mode_2.4bpp") != std::string::npos)
+            modesToUse = {ENCODE_DELTA_SYMS};
+        else if (fileName.find("mode_3.4bpp") != std::string::npos)
+            modesToUse = {ENCODE_LO};
+        else if (fileName.find("mode_4.4bpp") != std::string::npos)
+            modesToUse = {ENCODE_BOTH};
+        else if (fileName.find("mode_5.4bpp") != std::string::npos)
+            modesToUse = {ENCODE_BOTH_DELTA_SYMS};
+        else if (fileName.find("test/compression/table_") != std::string::npos)
+            modesToUse = {ENCODE_SYMS};
+
+        if (modesToUse.size() == 1)
+        {
+            settings.canDeltaSyms = true;
+            settings.canEncodeLO = true;
+            settings.canEncodeSyms = true;
+        }
+    }
+    std::vector<CompressionMode> allowedModes;
+    for (CompressionMode mode : modesToUse)
     {
+        if (!settings.canDeltaSyms
+         && (mode == ENCODE_DELTA_SYMS
+          || mode == ENCODE_BOTH_DELTA_SYMS))
+            continue;
+        if (!settings.canEncodeLO
+         && (mode == ENCODE_LO
+          || mode == ENCODE_BOTH
+          || mode == ENCODE_BOTH_DELTA_SYMS))
+            continue;
+        if (!settings.canEncodeSyms
+         && (mode == ENCODE_SYMS
+          || mode == ENCODE_BOTH
+          || mode == ENCODE_DELTA_SYMS
+          || mode == ENCODE_BOTH_DELTA_SYMS))
+            continue;
+        allowedModes.push_back(mode);
+    }
+
+    //  Both the copy search for each minimum code length and the tANS encoding of each
+    //  (length, mode) pair are independent, so they're evaluated on a pool of threads.
+    //  The best result is then picked in the original serial order to keep the output stable.
+    //  The optimal parse goes last, so it's only used when it's strictly smaller.
+    std::vector<ShortMatch> matches = findShortMatches(&usBase);
+    size_t numParses = MAX_CODE_LENGTH - MIN_CODE_LENGTH + 2;
+    std::vector<ParseCandidate> parses(numParses);
+    runParallel(numParses, settings.numThreads, [&](size_t parseIndex) {
+        size_t minCodeLength = MIN_CODE_LENGTH + parseIndex;
+        ParseCandidate &parse = parses[parseIndex];
         std::vector<ShortCopy> shortCopies;
-        if (!getShortCopies(&usBase, minCodeLength, &shortCopies))
+        bool copiesFound;
+        if (minCodeLength <= MAX_CODE_LENGTH)
+            copiesFound = getShortCopies(&usBase, &matches, minCodeLength, &shortCopies);
+        else
+            copiesFound = getOptimalShortCopies(&usBase, &matches, &shortCopies);
+        if (!copiesFound)
         {
-            copyFail = true;
+            parse.copyFail = true;
             printf("ERROR: %zu\n", minCodeLength);
-            continue;
+            return;
         }
 
         std::vector<ShortCompressionInstruction> shortInstructions;
-        if (!getShortInstructions(&shortCopies, &shortInstructions, &usBase))
+        getShortInstructions(&shortCopies, &shortInstructions, &usBase);
+        getLosFromInstructions(&shortInstructions, &parse.loVec);
+        getSymsFromInstructions(&shortInstructions, &parse.symVec);
+        if (!verifyBytesShort(&parse.loVec, &parse.symVec, &usBase))
         {
-            printf("ERROR\n");
-            return false;
+            parse.byteFail = true;
+            printf("Byte veri\n");
+            return;
         }
+        parse.isValid = true;
+    });
+
+    for (ParseCandidate &parse : parses)
+    {
+        copyFail |= parse.copyFail;
+        byteFail |= parse.byteFail;
+    }
 
-        std::vector<unsigned char> loVec;
-        std::vector<unsigned short> symVec;
-        getLosFromInstructions(&shortInstructions, &loVec);
-        getSymsFromInstructions(&shortInstructions, &symVec);
-        if (!verifyBytesShort(&loVec, &symVec, &usBase))
+    size_t numModes = allowedModes.size();
+    std::vector<ModeCandidate> candidates(numParses * numModes);
+    runParallel(candidates.size(), settings.numThreads, [&](size_t candidateIndex) {
+        ParseCandidate &parse = parses[candidateIndex / numModes];
+        CompressionMode mode = allowedModes[candidateIndex % numModes];
+        ModeCandidate &candidate = candidates[candidateIndex];
+        if (!parse.isValid)
+            return;
+
+        CompressedImage &currImg = candidate.image;
+        if (!fillCompressVec(&parse.loVec, &parse.symVec, mode, pInput->size(), fileName, &currImg))
         {
-            byteFail = true;
-            printf("Byte veri\n");
-            continue;
+            printf("ERROR\n");
         }
 
-        CompressionMode mode = BASE_ONLY;
-        std::vector<CompressionMode> modesToUse = {BASE_ONLY, ENCODE_SYMS, ENCODE_DELTA_SYMS, ENCODE_LO, ENCODE_BOTH, ENCODE_BOTH_DELTA_SYMS};
-        if (fileName.find("test/compression/") != std::string::npos)
+        if (!verifyCompressionShort(&currImg, &usBase))
         {
-            if (fileName.find("mode_0.4bpp") != std::string::npos)
-                modesToUse = {BASE_ONLY};
-            else if (fileName.find("mode_1.4bpp") != std::string::npos)
-                modesToUse = {ENCODE_SYMS};
-            else if (fileName.find("mode_2.4bpp") != std::string::npos)
-                modesToUse = {ENCODE_DELTA_SYMS};
-            else if (fileName.find("mode_3.4bpp") != std::string::npos)
-                modesToUse = {ENCODE_LO};
-            else if (fileName.find("mode_4.4bpp") != std::string::npos)
-                modesToUse = {ENCODE_BOTH};
-            else if (fileName.find("mode_5.4bpp") != std::string::npos)
-                modesToUse = {ENCODE_BOTH_DELTA_SYMS};
-            else if (fileName.find("test/compression/table_") != std::string::npos)
-                modesToUse = {ENCODE_SYMS};
-
-            if (modesToUse.size() == 1)
-            {
-                settings.canDeltaSyms = true;
-                settings.canEncodeLO = true;
-                settings.canEncodeSyms = true;
-            }
+            candidate.compressionFail = true;
+            printf("ERROR\n");
+            return;
         }
-        for (CompressionMode currMode : modesToUse)
+        std::vector<unsigned int> uiVec;
+        getUIntVecFromData(&currImg, &uiVec);
+        std::vector<unsigned short> decodedImage;
+        readRawDataVecs(&uiVec, &decodedImage);
+        if (!compareVectorsShort(&decodedImage, &usBase))
         {
-            CompressedImage currImg;
-            mode = currMode;
-            if (!settings.canDeltaSyms
-             && (mode == ENCODE_DELTA_SYMS
-              || mode == ENCODE_BOTH_DELTA_SYMS))
-                continue;
-            if (!settings.canEncodeLO
-             && (mode == ENCODE_LO
-              || mode == ENCODE_BOTH
-              || mode == ENCODE_BOTH_DELTA_SYMS))
-                continue;
-            if (!settings.canEncodeSyms
-             && (mode == ENCODE_SYMS
-              || mode == ENCODE_BOTH
-              || mode == ENCODE_DELTA_SYMS
-              || mode == ENCODE_BOTH_DELTA_SYMS))
-                continue;
-            if (!fillCompressVec(&loVec, &symVec, mode, pInput->size(), fileName, &currImg))
-            {
-                printf("ERROR\n");
-            }
+            candidate.uIntConversionFail = true;
+            printf("ERROR\n");
+            return;
+        }
+        currImg.compressedSize = uiVec.size() * 4;
+        currImg.writeVec = uiVec;
+        currImg.mode = mode;
+        candidate.isValid = true;
+    });
 
-            if (!verifyCompressionShort(&currImg, &usBase))
-            {
-                compressionFail = true;
-                printf("ERROR\n");
-                continue;
-            }
-            std::vector<unsigned int> uiVec;
-            getUIntVecFromData(&currImg, &uiVec);
-            std::vector<unsigned short> decodedImage;
-            readRawDataVecs(&uiVec, &decodedImage);
-            if (!compareVectorsShort(&decodedImage, &usBase))
-            {
-                uIntConversionFail = true;
-                printf("ERROR\n");
-                continue;
-            }
-            currImg.compressedSize = uiVec.size() * 4;
-            if (!hasImage)
-            {
-                bestLO = loVec;
-                bestSym = symVec;
-                bestInstructions = shortInstructions;
-                *pImage = currImg;
-                hasImage = true;
-                pImage->writeVec = uiVec;
-                someMode = mode;
-            }
-            else if (currImg.compressedSize < pImage->compressedSize)
-            {
-                bestLO = loVec;
-                bestSym = symVec;
-                bestInstructions = shortInstructions;
-                *pImage = currImg;
-                hasImage = true;
-                pImage->writeVec = uiVec;
-                someMode = mode;
-            }
+    for (ModeCandidate &candidate : candidates)
+    {
+        compressionFail |= candidate.compressionFail;
+        uIntConversionFail |= candidate.uIntConversionFail;
+        if (!candidate.isValid)
+            continue;
+        if (!hasImage || candidate.image.compressedSize < pImage->compressedSize)
+        {
+            *pImage = candidate.image;
+            hasImage = true;
+            someMode = candidate.image.mode;
         }
     }
     pImage->mode = someMode;
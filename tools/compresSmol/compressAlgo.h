@@ -7,6 +7,10 @@
 #include <iostream>
 #include <mutex>
 #include <thread>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <stdint.h>
 #include <string>
 #include <bitset>
 #include "fileDispatcher.h"
@@ -37,6 +41,9 @@
 
 #define IMAGE_SIZE_MODIFIER     4
 
+#define MAX_COPY_LENGTH         32767
+#define MAX_COPY_OFFSET         32766
+
 enum CompressionMode {
     LZ77 = 0,
     BASE_ONLY = 1,
@@ -57,6 +64,12 @@ struct ShortCopy {
     ShortCopy(size_t index, size_t length, size_t offset, unsigned short firstSymbol);
 };
 
+//  The longest earlier repeat of the data starting at some index
+struct ShortMatch {
+    size_t length = 0;
+    size_t offset = 0;
+};
+
 struct ShortCompressionInstruction {
     size_t length;
     size_t offset;
@@ -93,6 +106,7 @@ struct InputSettings {
     bool canEncodeSyms = true;
     bool canDeltaSyms = true;
     bool useFrames = false;
+    size_t numThreads = 0;  //  0 uses one thread per core
     InputSettings();
     InputSettings(bool canEncodeLO, bool canEncodeSyms, bool canDeltaSyms);
 };
@@ -105,10 +119,14 @@ struct DataVecs {
 CompressedImage processImage(std::string fileName, InputSettings settings);
 CompressedImage processImageFrames(std::string fileName, InputSettings settings);
 bool processImageData(std::vector<unsigned char> *pInput, CompressedImage *pImage, InputSettings settings, std::string fileName);
+void runParallel(size_t numJobs, size_t numThreads, std::function<void(size_t)> job);
 
 bool readFileAsUInt(std::string filePath, std::vector<unsigned int> *pFileData);
 
+std::vector<ShortMatch> findShortMatches(std::vector<unsigned short> *pInput);
 bool getShortCopies(std::vector<unsigned short> *pInput, size_t minLength, std::vector<ShortCopy> *pShortCopies);
+bool getShortCopies(std::vector<unsigned short> *pInput, std::vector<ShortMatch> *pMatches, size_t minLength, std::vector<ShortCopy> *pShortCopies);
+bool getOptimalShortCopies(std::vector<unsigned short> *pInput, std::vector<ShortMatch> *pMatches, std::vector<ShortCopy> *pShortCopies);
 bool verifyShortCopies(std::vector<ShortCopy> *pCopies, std::vector<unsigned short> *pImage);
 
 std::vector<int> getNormalizedCounts(std::vector<size_t> input);
@@ -118,7 +136,7 @@ int findInitialState(EncodeCol *encodeCol, unsigned char firstSymbol);
 
 bool fillCompressVec(std::vector<unsigned char> *pLoVec, std::vector<unsigned short> *pSymVec, CompressionMode mode, size_t imageBytes, std::string name, CompressedImage *pOutput);
 
-bool getShortInstructions(std::vector<ShortCopy> *pCopies, std::vector<ShortCompressionInstruction> *pInstructions, std::vector<unsigned short> *pInput);
+void getShortInstructions(std::vector<ShortCopy> *pCopies, std::vector<ShortCompressionInstruction> *pInstructions, std::vector<unsigned short> *pInput);
 void getLosFromInstructions(std::vector<ShortCompressionInstruction> *pInstructions, std::vector<unsigned char> *pOutput);
 void getSymsFromInstructions(std::vector<ShortCompressionInstruction> *pInstructions, std::vector<unsigned short> *pOutput);
 std::vector<int> unpackFrequencies(unsigned int pInts[3]);
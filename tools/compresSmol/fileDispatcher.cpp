@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "fileDispatcher.h"
 
 FileDispatcher::FileDispatcher(std::filesystem::path inPath)
@@ -10,7 +11,7 @@ void FileDispatcher::setFilePath(std::filesystem::path inPath)
     filePath = inPath;
 }
 
-bool FileDispatcher::initFileList()
+bool FileDispatcher::initFileList(std::string extension)
 {
     std::string fileName;
     for (const std::filesystem::directory_entry &dirEntry : std::filesystem::recursive_directory_iterator(filePath))
@@ -18,7 +19,8 @@ bool FileDispatcher::initFileList()
         if (dirEntry.is_regular_file())
         {
             fileName = dirEntry.path().string();
-            if (fileName.find(".4bpp.lz") == std::string::npos)
+            if (fileName.size() < extension.size()
+             || fileName.compare(fileName.size() - extension.size(), extension.size(), extension) != 0)
                 continue;
         }
         else
@@ -27,6 +29,8 @@ bool FileDispatcher::initFileList()
         }
         fileList.push_back(fileName);
     }
+    //  Directory iteration order is unspecified, sort so runs are reproducible
+    std::sort(fileList.begin(), fileList.end());
 
     if (fileList.size() == 0)
         return false;
@@ -34,12 +38,17 @@ bool FileDispatcher::initFileList()
         return true;
 }
 
+size_t FileDispatcher::getFileCount()
+{
+    return fileList.size();
+}
+
 std::string FileDispatcher::requestFileName()
 {
+    std::lock_guard<std::mutex> lock(requestMutex);
     if (currentIndex >= fileList.size())
         return "";
     std::string returnString = fileList[currentIndex];
-    std::cout << "Dispatching index " << currentIndex << ": " << returnString << "\n";
     currentIndex++;
     return returnString;
 }
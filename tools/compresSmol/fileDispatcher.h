@@ -9,14 +9,15 @@
 
 class FileDispatcher {
     std::vector<std::string> fileList;
-    int currentIndex = 0;
+    size_t currentIndex = 0;
     std::mutex requestMutex;
     std::filesystem::path filePath;
 public:
     FileDispatcher();
     FileDispatcher(std::filesystem::path inPath);
     void setFilePath(std::filesystem::path inPath);
-    bool initFileList();
+    bool initFileList(std::string extension);
+    size_t getFileCount();
     std::string requestFileName();
 };
 #endif
@@ -151,3 +151,168 @@ unsigned char *LZCompress(unsigned char *src, int srcSize, int *compressedSize,
 fail:
 	FATAL_ERROR("Fatal error while compressing LZ file.\n");
 }
+
+#define LZ_MIN_BLOCK_SIZE 3
+#define LZ_MAX_BLOCK_SIZE 18
+#define LZ_MAX_DISTANCE 0x1000
+#define LZ_HASH_BITS 15
+
+// Each token costs its flag bit plus one byte for a literal or two for a block.
+#define LZ_LITERAL_COST 9
+#define LZ_BLOCK_COST 17
+
+static int LZHash(unsigned char *src)
+{
+	unsigned int value = (src[0] << 16) | (src[1] << 8) | src[2];
+	return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// Same format as LZCompress, but instead of greedily taking the longest block
+// at each position, picks the sequence of literals and blocks with the lowest
+// total size. Candidate blocks are found through a hash chain of earlier
+// positions that share the same first three bytes.
+unsigned char *LZCompressOptimal(unsigned char *src, int srcSize, int *compressedSize, const int minDistance)
+{
+	if (srcSize <= 0)
+		goto fail;
+
+	int *head = malloc(sizeof(int) << LZ_HASH_BITS);
+	int *prev = malloc(sizeof(int) * srcSize);
+	unsigned char *blockSizes = malloc(srcSize);
+	short *blockDistances = malloc(sizeof(short) * srcSize);
+	int *costs = malloc(sizeof(int) * (srcSize + 1));
+
+	if (head == NULL || prev == NULL || blockSizes == NULL || blockDistances == NULL || costs == NULL)
+		goto fail;
+
+	for (int i = 0; i < (1 << LZ_HASH_BITS); i++)
+		head[i] = -1;
+
+	// Find the longest block available at every position.
+	for (int srcPos = 0; srcPos < srcSize; srcPos++) {
+		blockSizes[srcPos] = 0;
+		blockDistances[srcPos] = 0;
+
+		if (srcPos + LZ_MIN_BLOCK_SIZE > srcSize) {
+			prev[srcPos] = -1;
+			continue;
+		}
+
+		int hash = LZHash(&src[srcPos]);
+		int maxBlockSize = srcSize - srcPos < LZ_MAX_BLOCK_SIZE ? srcSize - srcPos : LZ_MAX_BLOCK_SIZE;
+		int bestBlockSize = 0;
+
+		for (int blockStart = head[hash]; blockStart >= 0; blockStart = prev[blockStart]) {
+			int blockDistance = srcPos - blockStart;
+
+			if (blockDistance > LZ_MAX_DISTANCE)
+				break;
+			if (blockDistance < minDistance)
+				continue;
+			// A block can only be longer if it also matches one past the current best.
+			if (bestBlockSize != 0 && src[blockStart + bestBlockSize] != src[srcPos + bestBlockSize])
+				continue;
+
+			int blockSize = 0;
+
+			while (blockSize < maxBlockSize && src[blockStart + blockSize] == src[srcPos + blockSize])
+				blockSize++;
+
+			if (blockSize > bestBlockSize) {
+				bestBlockSize = blockSize;
+				blockDistances[srcPos] = blockDistance;
+
+				if (blockSize == maxBlockSize)
+					break;
+			}
+		}
+
+		if (bestBlockSize >= LZ_MIN_BLOCK_SIZE)
+			blockSizes[srcPos] = bestBlockSize;
+
+		prev[srcPos] = head[hash];
+		head[hash] = srcPos;
+	}
+
+	// Work backwards to find the cheapest way to encode everything from each position onwards.
+	// A block can be cut short, so any size from the minimum up to the longest one found is allowed.
+	costs[srcSize] = 0;
+
+	for (int srcPos = srcSize - 1; srcPos >= 0; srcPos--) {
+		int bestCost = LZ_LITERAL_COST + costs[srcPos + 1];
+		int bestBlockSize = 0;
+
+		for (int blockSize = LZ_MIN_BLOCK_SIZE; blockSize <= blockSizes[srcPos]; blockSize++) {
+			int cost = LZ_BLOCK_COST + costs[srcPos + blockSize];
+
+			if (cost <= bestCost) {
+				bestCost = cost;
+				bestBlockSize = blockSize;
+			}
+		}
+
+		costs[srcPos] = bestCost;
+		blockSizes[srcPos] = bestBlockSize;
+	}
+
+	int worstCaseDestSize = 4 + srcSize + ((srcSize + 7) / 8);
+
+	// Round up to the next multiple of four.
+	worstCaseDestSize = (worstCaseDestSize + 3) & ~3;
+
+	unsigned char *dest = malloc(worstCaseDestSize);
+
+	if (dest == NULL)
+		goto fail;
+
+	// header
+	dest[0] = 0x10; // LZ compression type
+	dest[1] = (unsigned char)srcSize;
+	dest[2] = (unsigned char)(srcSize >> 8);
+	dest[3] = (unsigned char)(srcSize >> 16);
+
+	int srcPos = 0;
+	int destPos = 4;
+
+	for (;;) {
+		unsigned char *flags = &dest[destPos++];
+		*flags = 0;
+
+		for (int i = 0; i < 8; i++) {
+			int blockSize = blockSizes[srcPos];
+
+			if (blockSize != 0) {
+				int blockDistance = blockDistances[srcPos] - 1;
+				*flags |= (0x80 >> i);
+				srcPos += blockSize;
+				blockSize -= 3;
+				dest[destPos++] = (blockSize << 4) | ((unsigned int)blockDistance >> 8);
+				dest[destPos++] = (unsigned char)blockDistance;
+			} else {
+				dest[destPos++] = src[srcPos++];
+			}
+
+			if (srcPos == srcSize) {
+				// Pad to multiple of 4 bytes.
+				int remainder = destPos % 4;
+
+				if (remainder != 0) {
+					for (int i = 0; i < 4 - remainder; i++)
+						dest[destPos++] = 0;
+				}
+
+				free(head);
+				free(prev);
+				free(blockSizes);
+				free(blockDistances);
+				free(costs);
+
+				*compressedSize = destPos;
+				return dest;
+			}
+		}
+	}
+
+fail:
+	FATAL_ERROR("Fatal error while compressing LZ file.\n");
+}
@@ -429,6 +429,8 @@ void HandleLZCompressCommand(char *inputPath, char *outputPath, int argc, char *
 {
     int overflowSize = 0;
     int minDistance = 2; // default, for compatibility with LZ77UnCompVram()
+    bool optimal = false;
+    bool printStats = false;
 
     for (int i = 3; i < argc; i++)
     {
@@ -460,6 +462,14 @@ void HandleLZCompressCommand(char *inputPath, char *outputPath, int argc, char *
             if (minDistance < 1)
                 FATAL_ERROR("LZ min search distance must be positive.\n");
         }
+        else if (strcmp(option, "-optimal") == 0)
+        {
+            optimal = true;
+        }
+        else if (strcmp(option, "-stats") == 0)
+        {
+            printStats = true;
+        }
         else
         {
             FATAL_ERROR("Unrecognized option \"%s\".\n", option);
@@ -476,7 +486,31 @@ void HandleLZCompressCommand(char *inputPath, char *outputPath, int argc, char *
     unsigned char *buffer = ReadWholeFileZeroPadded(inputPath, &fileSize, overflowSize);
 
     int compressedSize;
-    unsigned char *compressedData = LZCompress(buffer, fileSize + overflowSize, &compressedSize, minDistance);
+    unsigned char *compressedData;
+
+    if (optimal)
+        compressedData = LZCompressOptimal(buffer, fileSize + overflowSize, &compressedSize, minDistance);
+    else
+        compressedData = LZCompress(buffer, fileSize + overflowSize, &compressedSize, minDistance);
+
+    // Reports how much the optimal parse saves over the greedy one for this file.
+    if (printStats)
+    {
+        int otherSize;
+        unsigned char *otherData;
+
+        if (optimal)
+            otherData = LZCompress(buffer, fileSize + overflowSize, &otherSize, minDistance);
+        else
+            otherData = LZCompressOptimal(buffer, fileSize + overflowSize, &otherSize, minDistance);
+
+        free(otherData);
+
+        int greedySize = optimal ? otherSize : compressedSize;
+        int optimalSize = optimal ? compressedSize : otherSize;
+
+        printf("%s: %d bytes, greedy %d, optimal %d, saved %d\n", outputPath, fileSize, greedySize, optimalSize, greedySize - optimalSize);
+    }
 
     compressedData[1] = (unsigned char)fileSize;
     compressedData[2] = (unsigned char)(fileSize >> 8);
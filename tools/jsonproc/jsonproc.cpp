@@ -12,6 +12,14 @@ using std::string; using std::to_string;
 #include <algorithm>
 using std::replace_if;
 
+#include <chrono>
+#include <fstream>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
 #include <inja.hpp>
 using namespace inja;
 using json = nlohmann::json;
@@ -28,21 +36,94 @@ string get_custom_var(string key)
     return customVars[key];
 }
 
+struct Job
+{
+    string jsonFilepath;
+    string templateFilepath;
+    string outputFilepath;
+};
+
+struct Stats
+{
+    double jsonSeconds = 0;
+    double templateSeconds = 0;
+    double renderSeconds = 0;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Parsing from one contiguous buffer is much faster than nlohmann's istream input adapter.
+json load_json(const string &filepath)
+{
+    FILE *fp = std::fopen(filepath.c_str(), "rb");
+    if (fp == NULL)
+        FATAL_ERROR("JSONPROC_ERROR: failed accessing file at '%s'\n", filepath.c_str());
+
+    std::fseek(fp, 0, SEEK_END);
+    long size = std::ftell(fp);
+    std::rewind(fp);
+
+    string text(size > 0 ? size : 0, '\0');
+    if (size > 0 && std::fread(&text[0], size, 1, fp) != 1)
+        FATAL_ERROR("JSONPROC_ERROR: failed reading file at '%s'\n", filepath.c_str());
+    std::fclose(fp);
+
+    return json::parse(text);
+}
+
+void print_stats(const Stats &stats, size_t numJobs, Clock::time_point start)
+{
+    fprintf(stderr, "jsonproc: %zu output(s) in %.2f ms (json parse %.2f ms, template parse %.2f ms, render %.2f ms)\n",
+            numJobs, seconds_since(start) * 1000, stats.jsonSeconds * 1000, stats.templateSeconds * 1000, stats.renderSeconds * 1000);
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+#ifdef __APPLE__
+        long peakKiB = usage.ru_maxrss / 1024;
+#else
+        long peakKiB = usage.ru_maxrss;
+#endif
+        fprintf(stderr, "jsonproc: peak RSS %ld KiB\n", peakKiB);
+    }
+#endif
+}
+
 int main(int argc, char *argv[])
 {
-    if (argc != 4)
-        FATAL_ERROR("USAGE: jsonproc <json-filepath> <template-filepath> <output-filepath>\n");
+    Clock::time_point start = Clock::now();
+    bool printStats = false;
+
+    if (argc > 1 && string(argv[1]) == "-s")
+    {
+        printStats = true;
+        argc--;
+        argv++;
+    }
 
-    string jsonfilepath = argv[1];
-    string templateFilepath = argv[2];
-    string outputFilepath = argv[3];
+    if (argc < 4 || (argc - 1) % 3 != 0)
+        FATAL_ERROR("USAGE: jsonproc [-s] <json-filepath> <template-filepath> <output-filepath> [<json-filepath> <template-filepath> <output-filepath> ...]\n"
+                    "where -s prints timings and peak memory use\n");
+
+    // Any number of outputs can be generated by one call.
+    // Each JSON file and template is only parsed once, however many outputs use it.
+    std::vector<Job> jobs;
+    for (int i = 1; i < argc; i += 3)
+        jobs.push_back({ argv[i], argv[i + 1], argv[i + 2] });
+
+    const Job *currentJob = nullptr;
 
     Environment env;
     env.set_trim_blocks(true);
 
     // Add custom command callbacks.
-    env.add_callback("doNotModifyHeader", 0, [jsonfilepath, templateFilepath](Arguments& args) {
-        return "//\n// DO NOT MODIFY THIS FILE! It is auto-generated from " + jsonfilepath +" and Inja template " + templateFilepath + "\n//\n";
+    env.add_callback("doNotModifyHeader", 0, [&currentJob](Arguments& args) {
+        return "//\n// DO NOT MODIFY THIS FILE! It is auto-generated from " + currentJob->jsonFilepath +" and Inja template " + currentJob->templateFilepath + "\n//\n";
     });
 
     env.add_callback("subtract", 2, [](Arguments& args) {
@@ -120,14 +201,41 @@ int main(int argc, char *argv[])
         return str;
     });
 
-    try
-    {
-        env.write_with_json_file(templateFilepath, jsonfilepath, outputFilepath);
-    }
-    catch (const std::exception& e)
+    std::map<string, json> jsonCache;
+    std::map<string, Template> templateCache;
+    Stats stats;
+
+    for (const Job &job : jobs)
     {
-        FATAL_ERROR("JSONPROC_ERROR: %s\n", e.what());
+        currentJob = &job;
+        customVars.clear();
+
+        try
+        {
+            Clock::time_point stageStart = Clock::now();
+            auto data = jsonCache.find(job.jsonFilepath);
+            if (data == jsonCache.end())
+                data = jsonCache.emplace(job.jsonFilepath, load_json(job.jsonFilepath)).first;
+            stats.jsonSeconds += seconds_since(stageStart);
+
+            stageStart = Clock::now();
+            auto tmpl = templateCache.find(job.templateFilepath);
+            if (tmpl == templateCache.end())
+                tmpl = templateCache.emplace(job.templateFilepath, env.parse_template(job.templateFilepath)).first;
+            stats.templateSeconds += seconds_since(stageStart);
+
+            stageStart = Clock::now();
+            env.write(tmpl->second, data->second, job.outputFilepath);
+            stats.renderSeconds += seconds_since(stageStart);
+        }
+        catch (const std::exception& e)
+        {
+            FATAL_ERROR("JSONPROC_ERROR: %s\n", e.what());
+        }
     }
 
+    if (printStats)
+        print_stats(stats, jobs.size(), start);
+
     return 0;
 }
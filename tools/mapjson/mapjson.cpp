@@ -24,6 +24,10 @@ using std::ostringstream;
 #include <limits>
 using std::numeric_limits;
 
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
 #include "json11.h"
 using json11::Json;
 
@@ -52,7 +56,17 @@ string read_text_file(string filepath) {
     return text;
 }
 
+// Leaves the file untouched if it already holds this text, so that make doesn't rebuild anything that depends on it.
 void write_text_file(string filepath, string text) {
+    ifstream in_file(filepath, std::ifstream::binary);
+    if (in_file.is_open()) {
+        ostringstream existing;
+        existing << in_file.rdbuf();
+        in_file.close();
+        if (existing.str() == text)
+            return;
+    }
+
     ofstream out_file(filepath, std::ofstream::binary);
 
     if (!out_file.is_open())
@@ -367,20 +381,13 @@ string file_parent(string filename){
     return filename.substr(0, dir_pos + 1);
 }
 
-void process_map(string map_filepath, string layouts_filepath, string output_dir) {
-    string mapdata_err, layouts_err;
-
-    string mapdata_json_text = read_text_file(map_filepath);
-    string layouts_json_text = read_text_file(layouts_filepath);
+void write_map_files(const string &mapdata_json_text, const Json &layouts_data, string output_dir) {
+    string mapdata_err;
 
     Json map_data = Json::parse(mapdata_json_text, mapdata_err);
     if (map_data == Json())
         FATAL_ERROR("%s\n", mapdata_err.c_str());
 
-    Json layouts_data = Json::parse(layouts_json_text, layouts_err);
-    if (layouts_data == Json())
-        FATAL_ERROR("%s\n", layouts_err.c_str());
-
     string header_text = generate_map_header_text(map_data, layouts_data);
     string events_text = generate_map_events_text(map_data);
     string connections_text = generate_map_connections_text(map_data);
@@ -391,6 +398,97 @@ void process_map(string map_filepath, string layouts_filepath, string output_dir
     write_text_file(out_dir + "connections.inc", connections_text);
 }
 
+void process_map(string map_filepath, string layouts_filepath, string output_dir) {
+    string layouts_err;
+
+    string mapdata_json_text = read_text_file(map_filepath);
+    string layouts_json_text = read_text_file(layouts_filepath);
+
+    Json layouts_data = Json::parse(layouts_json_text, layouts_err);
+    if (layouts_data == Json())
+        FATAL_ERROR("%s\n", layouts_err.c_str());
+
+    write_map_files(mapdata_json_text, layouts_data, output_dir);
+}
+
+// 64-bit FNV-1a, continuing from a previous hash if one is given.
+uint64_t hash_text(const string &text, uint64_t hash = 0xCBF29CE484222325ULL) {
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+bool file_exists(const string &filepath) {
+    ifstream file(filepath);
+    return file.is_open();
+}
+
+// Processes every map in one go, each into the directory containing its map.json.
+// The cache file records a hash of each map's inputs from the last run, and maps whose
+// inputs haven't changed (and whose outputs still exist) aren't regenerated at all.
+void process_maps(string layouts_filepath, string cache_filepath, const vector<string> &map_filepaths) {
+    string layouts_json_text = read_text_file(layouts_filepath);
+    uint64_t layouts_hash = hash_text(layouts_json_text, hash_text(version));
+
+    map<string, uint64_t> cached_hashes;
+    ifstream cache_file(cache_filepath);
+    if (cache_file.is_open()) {
+        uint64_t hash;
+        string filepath;
+        while (cache_file >> std::hex >> hash && cache_file.get() == '\t' && std::getline(cache_file, filepath))
+            cached_hashes[filepath] = hash;
+        cache_file.close();
+    }
+
+    vector<string> map_texts(map_filepaths.size());
+    vector<uint64_t> map_hashes(map_filepaths.size());
+    vector<size_t> stale_maps;
+
+    for (size_t i = 0; i < map_filepaths.size(); i++) {
+        const string &filepath = map_filepaths[i];
+        string out_dir = file_parent(filepath);
+        map_texts[i] = read_text_file(filepath);
+        map_hashes[i] = hash_text(map_texts[i], layouts_hash);
+
+        auto cached = cached_hashes.find(filepath);
+        if (cached == cached_hashes.end() || cached->second != map_hashes[i]
+         || !file_exists(out_dir + "header.inc") || !file_exists(out_dir + "events.inc") || !file_exists(out_dir + "connections.inc"))
+            stale_maps.push_back(i);
+    }
+
+    if (!stale_maps.empty()) {
+        string layouts_err;
+        Json layouts_data = Json::parse(layouts_json_text, layouts_err);
+        if (layouts_data == Json())
+            FATAL_ERROR("%s\n", layouts_err.c_str());
+
+        std::atomic<size_t> next(0);
+        auto worker = [&]() {
+            size_t i;
+            while ((i = next++) < stale_maps.size()) {
+                size_t index = stale_maps[i];
+                write_map_files(map_texts[index], layouts_data, file_parent(map_filepaths[index]));
+            }
+        };
+
+        size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+        num_threads = std::min(num_threads, stale_maps.size());
+        vector<std::thread> threads;
+        for (size_t i = 1; i < num_threads; i++)
+            threads.emplace_back(worker);
+        worker();
+        for (auto &thread : threads)
+            thread.join();
+    }
+
+    ostringstream cache_text;
+    for (size_t i = 0; i < map_filepaths.size(); i++)
+        cache_text << std::hex << map_hashes[i] << "\t" << map_filepaths[i] << "\n";
+    write_text_file(cache_filepath, cache_text.str());
+}
+
 void process_event_constants(const vector<string> &map_filepaths, string output_ids_file) {
     string warning = get_generated_warning("data/maps/*/map.json", false);
 
@@ -711,6 +809,21 @@ int main(int argc, char *argv[]) {
 
         process_map(filepath, layouts_filepath, output_dir);
     }
+    else if (mode == "maps") {
+        if (argc < 6)
+            FATAL_ERROR("USAGE: mapjson maps <game-version> <layouts_file> <cache_file> <map_file> [additional_map_files]\n");
+
+        infer_separator(argv[5]);
+        string layouts_filepath(argv[3]);
+        string cache_filepath(argv[4]);
+
+        vector<string> filepaths;
+        for (int i = 5; i < argc; i++) {
+            filepaths.push_back(argv[i]);
+        }
+
+        process_maps(layouts_filepath, cache_filepath, filepaths);
+    }
     else if (mode == "groups") {
         if (argc != 6)
             FATAL_ERROR("USAGE: mapjson groups <game-version> <groups_file> <output_asm_dir> <output_c_dir>\n");
@@ -750,7 +863,7 @@ int main(int argc, char *argv[]) {
         process_event_constants(filepaths, output_ids_file);
     }
     else {
-        FATAL_ERROR("ERROR: <mode> must be 'layouts', 'map', 'event_constants', or 'groups'.\n");
+        FATAL_ERROR("ERROR: <mode> must be 'layouts', 'map', 'maps', 'event_constants', or 'groups'.\n");
     }
 
     return 0;
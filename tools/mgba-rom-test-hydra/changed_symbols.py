@@ -0,0 +1,350 @@
+#!/usr/bin/env python3
+
+"""
+Usage: python3 changed_symbols.py BASE
+
+Lists what has changed in the working tree since the git revision BASE, for
+'mgba-rom-test-hydra -a', which runs only the tests that the changes could
+affect. Each line is one of the following, with tab-separated fields:
+    S <file> <symbol>   A function or variable whose definition changed.
+    F <file> <symbol>   A function or variable that <file> defines. Hydra
+                        uses these in place of any S symbol from <file>
+                        that isn't in the ELF, e.g. because it was inlined.
+    T <file>            A test file that changed. All its tests are run.
+    * <reason>          A change that can't be traced to symbols, e.g. to
+                        a macro, a type, or a file that isn't C. All the
+                        tests are run.
+
+Top-level declarations are found with a simple scan of the source rather
+than by preprocessing it, so anything unusual is reported as '*'.
+Declarations without a definition (e.g. prototypes) are ignored, because
+any change that matters also changes the definition. Untracked files are
+not diffed, but hydra always runs tests that it has no coverage for.
+"""
+
+import os
+import re
+import subprocess
+import sys
+
+# Host tools' C sources aren't part of the ROM, so they have no symbols.
+IGNORED = re.compile(r"^(docs/|\.github/)|^tools/.*\.[ch]$|\.md$")
+IDENTIFIER = re.compile(r"[A-Za-z_]\w*")
+TYPE = re.compile(r"\s*(typedef|struct|union|enum)\b")
+HUNK = re.compile(r"^@@ -(\d+)(?:,(\d+))? \+(\d+)(?:,(\d+))? @@")
+INCLUDE = re.compile(r'\s*#\s*include\s+"([^"]+)"')
+TEST = re.compile(r"^\w*TEST\s*\(", re.MULTILINE)
+
+
+class Construct:
+    def __init__(self, first):
+        self.first = first
+        self.last = first
+        self.header = ""
+        self.header_done = False
+        self.initialized = False
+        self.body = False
+        self.directive = False
+
+    def kind(self):
+        """Returns 'definition', 'declaration' or None if neither."""
+        if self.directive:
+            return None
+        header = strip_attributes(self.header).strip()
+        words = IDENTIFIER.findall(header)
+        if not words or words[0] == "typedef":
+            return None
+        if re.match(r"^(struct|union|enum)\s*\w*$", header):
+            return None
+        if not self.body and not self.initialized:
+            if words[0] == "extern" or "(" in header:
+                return "declaration"
+        return "definition"
+
+    def name(self):
+        header = strip_attributes(self.header)
+        match = re.search(r"\(\s*\*\s*(?:const\s+)?(\w+)", header)
+        if match is None:
+            match = re.search(r"(\w+)\s*\(", header)
+        if match is None:
+            match = re.search(r"(\w+)\s*$", re.sub(r"\[[^\]]*\]", "", header))
+        # e.g. 'SINGLE_BATTLE_TEST("...")' or 'ASSUMPTIONS'.
+        if match is None or IDENTIFIER.match(header.strip()).group(0) == match.group(1):
+            return None
+        return match.group(1)
+
+
+def strip_attributes(header):
+    while True:
+        start = header.find("__attribute__")
+        if start == -1:
+            return header
+        end = header.find("(", start)
+        if end == -1:
+            return header[:start]
+        depth = 0
+        for end in range(end, len(header)):
+            depth += {"(": 1, ")": -1}.get(header[end], 0)
+            if depth == 0:
+                break
+        header = header[:start] + " " + header[end + 1:]
+
+
+def scan(source):
+    """Returns the top-level constructs in source, in order, and the set of
+    lines that have code on them (i.e. aren't blank or only comments)."""
+    constructs = []
+    code_lines = set()
+    current = None
+    braces = parens = 0
+    line = 1
+    at_line_start = True
+    space = False
+    i, n = 0, len(source)
+
+    def code(c):
+        nonlocal current, space
+        code_lines.add(line)
+        if current is None:
+            current = Construct(line)
+            constructs.append(current)
+        current.last = line
+        if not current.header_done:
+            current.header += " " + c if space else c
+        space = False
+
+    while i < n:
+        c = source[i]
+        if c == "\n":
+            line += 1
+            at_line_start = True
+            space = True
+            i += 1
+            continue
+        if c in " \t\r\f\v":
+            space = True
+            i += 1
+            continue
+        if source.startswith("//", i):
+            i = source.find("\n", i)
+            i = n if i == -1 else i
+            continue
+        if source.startswith("/*", i):
+            end = source.find("*/", i + 2)
+            end = n if end == -1 else end + 2
+            line += source.count("\n", i, end)
+            space = True
+            i = end
+            continue
+        if c == "#" and at_line_start:
+            # Directives between constructs are constructs of their own.
+            # Includes don't change any code by themselves, so they aren't
+            # counted as code.
+            if current is None:
+                constructs.append(Construct(line))
+                constructs[-1].directive = True
+            directive = constructs[-1] if current is None else current
+            is_code = INCLUDE.match(source, i) is None
+            while True:
+                end = source.find("\n", i)
+                end = n if end == -1 else end
+                if is_code:
+                    code_lines.add(line)
+                directive.last = line
+                if end == n or source[end - 1] != "\\":
+                    break
+                line += 1
+                i = end + 1
+            i = end
+            continue
+        at_line_start = False
+        if c in "\"'":
+            end = i + 1
+            while end < n and source[end] != c and source[end] != "\n":
+                end += 2 if source[end] == "\\" else 1
+            code(c + c)
+            i = end + 1
+            continue
+
+        code(c)
+        i += 1
+        if c in "([":
+            parens += 1
+        elif c in ")]":
+            parens -= 1
+        elif parens > 0:
+            continue
+        elif c == "=" and braces == 0 and not current.header_done:
+            current.header = current.header[:-1]
+            current.header_done = True
+            current.initialized = True
+        elif c == "{":
+            if braces == 0 and not current.header_done:
+                current.header = current.header[:-1]
+                current.header_done = True
+                current.body = True
+            braces += 1
+        elif c == "}":
+            braces -= 1
+            if braces == 0 and not current.initialized and ("(" in current.header or not TYPE.match(current.header)):
+                current = None
+        elif c == ";" and braces == 0:
+            if not current.header_done:
+                current.header = current.header[:-1]
+                current.header_done = True
+            current = None
+    return constructs, code_lines
+
+
+def git(*args):
+    result = subprocess.run(["git", *args], stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+    if result.returncode != 0:
+        return None
+    return result.stdout.decode("utf-8", "replace")
+
+
+def changed_lines(base):
+    """Returns {path: [old path, old lines, new path, new lines]}."""
+    changes = {}
+    old_path = None
+    change = None
+    for path in git("diff", "--no-renames", "--name-only", base, "--").splitlines():
+        changes[path] = [None, set(), None, set()]
+    for line in git("diff", "--no-renames", "-U0", base, "--").splitlines():
+        if line.startswith("--- "):
+            old_path = None if line == "--- /dev/null" else line[6:]
+        elif line.startswith("+++ "):
+            new_path = None if line == "+++ /dev/null" else line[6:]
+            change = changes.setdefault(new_path or old_path, [None, set(), None, set()])
+            change[0] = old_path
+            change[2] = new_path
+        elif change is not None and (match := HUNK.match(line)):
+            old_start, old_n, new_start, new_n = match.groups()
+            old_n = 1 if old_n is None else int(old_n)
+            new_n = 1 if new_n is None else int(new_n)
+            change[1].update(range(int(old_start), int(old_start) + old_n))
+            change[3].update(range(int(new_start), int(new_start) + new_n))
+    return changes
+
+
+def enclosing(constructs, line):
+    for construct in constructs:
+        if construct.first <= line <= construct.last:
+            return construct
+    return None
+
+
+def includers(path, sources):
+    """Yields (file, line) for each #include of path in sources."""
+    for source_path, source in sources.items():
+        for n, text in enumerate(source.splitlines(), 1):
+            match = INCLUDE.match(text)
+            if match is None:
+                continue
+            name = match.group(1)
+            for directory in (os.path.dirname(source_path), "src", "include"):
+                if os.path.normpath(os.path.join(directory, name)) == path:
+                    yield source_path, n
+                    break
+
+
+def main(base):
+    output = {}
+    sources = None
+    scans = {}
+    traces = {}
+
+    def read(path):
+        try:
+            with open(path, encoding="utf-8", errors="replace") as f:
+                return f.read()
+        except OSError:
+            return None
+
+    def scan_source(source_path):
+        if source_path not in scans:
+            scans[source_path] = scan(sources[source_path])
+        return scans[source_path]
+
+    def trace_include(path, depth=0):
+        """Returns the symbols of the definitions that include path, or None
+        if it's included anywhere else."""
+        if (path, depth) not in traces:
+            traces[path, depth] = trace_include_uncached(path, depth)
+        return traces[path, depth]
+
+    def trace_include_uncached(path, depth):
+        nonlocal sources
+        if sources is None:
+            sources = {}
+            for directory, _, files in os.walk("src"):
+                for f in files:
+                    if f.endswith((".c", ".h")):
+                        sources[os.path.join(directory, f)] = read(os.path.join(directory, f)) or ""
+        symbols = []
+        for source_path, line in includers(path, sources):
+            constructs, _ = scan_source(source_path)
+            construct = enclosing(constructs, line)
+            if construct is not None and construct.kind() == "definition" and construct.name():
+                symbols.append((source_path, construct.name()))
+            elif construct is not None and construct.directive is False and source_path.endswith(".h") and depth < 4:
+                traced = trace_include(source_path, depth + 1)
+                if traced is None:
+                    return None
+                symbols += traced
+            else:
+                return None
+        return symbols or None
+
+    for path, (old_path, old_lines, new_path, new_lines) in changed_lines(base).items():
+        if IGNORED.search(path):
+            continue
+        if not path.endswith((".c", ".h")) or not (old_path or new_path):
+            output["*\t" + path] = None
+            continue
+
+        old_source = git("show", f"{base}:{old_path}") if old_path else None
+        new_source = read(new_path) if new_path else None
+        is_test = path.startswith("test/") and TEST.search(new_source or old_source or "")
+        if is_test:
+            output["T\t" + path] = None
+
+        for source, lines in ((old_source, old_lines), (new_source, new_lines)):
+            if source is None:
+                continue
+            constructs, code_lines = scan(source)
+            for construct in constructs:
+                if construct.kind() == "definition" and construct.name():
+                    output[f"F\t{path}\t{construct.name()}"] = None
+            for line in sorted(lines & code_lines):
+                construct = enclosing(constructs, line)
+                kind = construct.kind() if construct else None
+                name = construct.name() if construct else None
+                if kind == "declaration":
+                    continue
+                elif kind == "definition" and name:
+                    output[f"S\t{path}\t{name}"] = None
+                elif is_test:
+                    continue
+                elif path.endswith(".c"):
+                    # e.g. a struct or macro, which only this file can use.
+                    for construct in constructs:
+                        if construct.kind() == "definition" and construct.name():
+                            output[f"S\t{path}\t{construct.name()}"] = None
+                else:
+                    traced = trace_include(path) if path.startswith("src/") and path.endswith(".h") else None
+                    if traced is None:
+                        output[f"*\t{path}:{line}"] = None
+                        break
+                    for includer, symbol in traced:
+                        output[f"S\t{includer}\t{symbol}"] = None
+
+    sys.stdout.write("".join(line + "\n" for line in output))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2:
+        sys.exit(__doc__.strip())
+    if git("rev-parse", "--verify", sys.argv[1]) is None:
+        sys.exit(f"{sys.argv[0]}: unknown revision '{sys.argv[1]}'")
+    main(sys.argv[1])
@@ -14,7 +14,68 @@
  * P/K/F/A: Sets the result to the remaining of the line, flushes any
  *    output since the previous P/K/F/A and increment the number of
  *    passes/known fails/assumption fails/fails.
+ * D: Sets the number of frames the current test took to the remainder
+ *    of the line.
+ * S: Records a profiler sample of the current test from the remainder of
+ *    the line, "<pc> <lr> <return addresses...>", innermost first.
+ * B: Records a benchmark of the current test from the remainder of the
+ *    line, "<cycles> <benchmark>". If a baselines file is given, the
+ *    benchmarks are compared against it at the end of the run, and any
+ *    that are slower by more than the tolerance fail the run.
+ *
+ * SCHEDULING
+ * Hydra reads the tests from the ELF and hands them out in chunks from a
+ * central queue. Each runner is patched to run one range of tests and
+ * exits when it's done, at which point a new runner is started on the
+ * next chunk. Chunks shrink as the queue empties, so that one slow test
+ * near the end can't hold up the whole run. Each runner keeps its ROM
+ * between chunks, and only the range is rewritten in place, so it's
+ * only the first chunk that has to copy and patch the whole ELF. If the
+ * ELF doesn't have the symbols that needs, the tests are instead split
+ * between the runners up front by estimated cost, as test_runner.c does
+ * on its own.
+ *
+ * TIMINGS
+ * If a timings file is given, the time from each test's first N to its
+ * result is recorded there, one "<microseconds>\t<filename>\t<name>" line
+ * per test. On the next run chunks are sized by the recorded times rather
+ * than by the number of tests (tests without a recorded time count as the
+ * average), and the most expensive chunks are handed out first.
+ *
+ * RESULTS
+ * If results files are given, each test's result is appended to them as
+ * soon as it arrives, as JSON lines and/or JUnit XML, with its name,
+ * file and line, result, time, frames, and the runner that ran it. The
+ * JUnit XML is rewritten to be well-formed after each test, so it can be
+ * read while the tests are still running.
+ *
+ * PROFILE
+ * If a profile file is given (and the ROM has gTestRunnerProfile set),
+ * the samples are written there as folded stacks for flamegraph.pl, with
+ * each test as a root frame, and the functions with the most samples are
+ * listed at the end of the run. The stacks come from scanning the stack
+ * for return addresses, so they are a best effort: frames can be missing
+ * (e.g. after a tail call) or stale. lr is only used for the caller of
+ * the sampled function if it returns from a call to that function.
+ *
+ * COVERAGE
+ * If a coverage file is given (and the ROM has gTestRunnerProfile set),
+ * the functions that each test was sampled in are recorded there, one
+ * "<samples>\t<filename>\t<name>\t<function>" line per pair. The
+ * coverage of tests that didn't run is kept.
+ *
+ * AFFECTED TESTS
+ * If a changes file from changed_symbols.py is given, only the tests that
+ * the changes could affect are run. Those are the tests in changed test
+ * files, the tests without coverage, and the tests covering a function
+ * that changed or that refers to something that changed, directly or
+ * through any chain of functions and variables. References are found by
+ * scanning the ROM for BLs and pointers. Sampling can miss short
+ * functions, which is what following the references makes up for, so
+ * this is a quick check rather than a replacement for running all the
+ * tests.
  */
+#include <errno.h>
 #include <fcntl.h>
 #include <math.h>
 #include <poll.h>
@@ -32,24 +93,52 @@
 #endif
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 #include "elf.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
-#define MAX_PROCESSES               32 // See also test/test.h
+#define MAX_PROCESSES               32 // Without a queue. See also test/test.h
 #define MAX_SUMMARY_TESTS_TO_LIST   50
 #define MAX_TEST_LIST_BUFFER_LENGTH 256
+#define MAX_PROFILE_FRAMES          32
+#define MAX_PROFILE_FUNCTIONS       20
 
 #define ARRAY_COUNT(arr) (sizeof((arr)) / sizeof((arr)[0]))
 
+// A value stored against a key in a tab-separated file of
+// "<value>\t<key>" lines. Used for test timings, benchmarks and coverage.
+struct Record
+{
+    char *key;
+    uint64_t value;
+    size_t seq;
+};
+
+// Sorted by key, except for any records added after loading, which are
+// appended.
+struct Records
+{
+    struct Record *records;
+    size_t n;
+    size_t capacity;
+    size_t loaded_n;
+};
+
 struct Runner
 {
     pid_t pid;
     int outfd;
     char rom_path[FILENAME_MAX];
+    bool rom_ready;
     char test_name[256];
     char filename_line[256];
+    bool timing;
+    struct timespec timing_start;
+    char timing_name[256];
+    char timing_filename[256];
+    long frames; // -1 if not reported.
     size_t input_buffer_size;
     size_t input_buffer_capacity;
     char *input_buffer;
@@ -58,17 +147,37 @@ struct Runner
     char *output_buffer;
     int passes;
     int knownFails;
-    int knownFailsPassing;
     int todos;
-    int assumptionFails;
-    int fails;
     int results;
-    char failed_TestNames[MAX_SUMMARY_TESTS_TO_LIST][MAX_TEST_LIST_BUFFER_LENGTH];
-    char failed_TestFilenameLine[MAX_SUMMARY_TESTS_TO_LIST][MAX_TEST_LIST_BUFFER_LENGTH];
-    char knownFailingPassed_TestNames[MAX_SUMMARY_TESTS_TO_LIST][MAX_TEST_LIST_BUFFER_LENGTH];
-    char knownFailingPassed_FilenameLine[MAX_SUMMARY_TESTS_TO_LIST][MAX_TEST_LIST_BUFFER_LENGTH];
-    char assumeFailed_TestNames[MAX_SUMMARY_TESTS_TO_LIST][MAX_TEST_LIST_BUFFER_LENGTH];
-    char assumeFailed_FilenameLine[MAX_SUMMARY_TESTS_TO_LIST][MAX_TEST_LIST_BUFFER_LENGTH];
+    struct Records coverage; // Functions sampled in the current test.
+};
+
+// Tests to list in the summary. Only the first MAX_SUMMARY_TESTS_TO_LIST
+// are kept, but all of them are counted.
+struct TestList
+{
+    int n;
+    char names[MAX_SUMMARY_TESTS_TO_LIST][MAX_TEST_LIST_BUFFER_LENGTH];
+    char filename_lines[MAX_SUMMARY_TESTS_TO_LIST][MAX_TEST_LIST_BUFFER_LENGTH];
+};
+
+// Mirrors 'struct Test' in include/test/test.h.
+struct Test
+{
+    uint32_t name;
+    uint32_t filename;
+    uint32_t runner;
+    uint32_t data;
+    uint16_t sourceLine;
+};
+
+_Static_assert(sizeof(struct Test) == 20, "sizeof(struct Test) must match the GBA");
+
+struct Chunk
+{
+    uint32_t start;
+    uint32_t end;
+    uint64_t cost;
 };
 
 struct Symbol {
@@ -86,11 +195,85 @@ static unsigned nrunners = 0;
 static unsigned runners_digits = 0;
 static struct Runner *runners = NULL;
 
-// TODO: Build the symbol table on demand.
+static struct TestList failed = { 0 };
+static struct TestList known_failing_passed = { 0 };
+static struct TestList assume_failed = { 0 };
+
+// The number of lines of the status display currently on screen.
+static int status_lines = 0;
+
+static const char *mgba_rom_test_path;
+static const char *objcopy_path;
+static void *elf;
+static size_t elf_size;
+
+// Indices into '.tests' of the tests to run, in order. If 'queue' is
+// NULL, tests are assigned statically.
+static uint32_t *queue = NULL;
+static size_t queue_n = 0;
+static const struct Test *tests = NULL;
+static uint32_t tests_n = 0;
+
+// Where gTestRunnerStart and gTestRunnerEnd are in the runners' ROMs, or
+// -1 if they can't be rewritten in place.
+static off_t start_offset = -1;
+static off_t end_offset = -1;
+
+// Ranges of the queue, in the order they are handed out.
+static struct Chunk *chunks = NULL;
+static size_t chunks_n = 0;
+static size_t chunks_next = 0;
+
+// Test times in microseconds, keyed by "<filename>\t<name>".
+static const char *timings_path = NULL;
+static struct Records timings = { 0 };
+
+// Benchmarks in cycles, keyed by "<test name>\t<benchmark>".
+static const char *baselines_path = NULL;
+static struct Records baselines = { 0 };
+static struct Records benchmarks = { 0 };
+static unsigned benchmark_tolerance = 5;
+static bool update_baselines = false;
+
+static FILE *results_json = NULL;
+static FILE *results_junit = NULL;
+// Where the closing tags of the JUnit XML start.
+static long results_junit_end = 0;
+
+static const char junit_header[] = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites>\n<testsuite name=\"mgba-rom-test-hydra\">\n";
+static const char junit_footer[] = "</testsuite>\n</testsuites>\n";
+
+// Samples keyed by folded stack, and by function.
+static const char *profile_path = NULL;
+static struct Records profile_stacks = { 0 };
+static struct Records profile_self = { 0 };
+static struct Records profile_total = { 0 };
+static uint64_t profile_samples = 0;
+
+// Samples keyed by "<filename>\t<name>\t<function>", and the tests that
+// ran keyed by "<filename>\t<name>".
+static const char *coverage_path = NULL;
+static struct Records coverage = { 0 };
+static struct Records coverage_tests = { 0 };
+
+static const char *changes_path = NULL;
+// Whether the queue only has the tests affected by the changes, so chunks
+// must not span the tests between them.
+static bool affected_only = false;
+
 static struct SymbolTable symbol_table = { NULL, 0 };
+static bool symbol_table_built = false;
+
+static void build_symbol_table(void *elf);
+static const void *read_address(uint32_t address, size_t *available);
 
 static const struct Symbol *lookup_address(uint32_t address)
 {
+    if (!symbol_table_built)
+    {
+        build_symbol_table(elf);
+        symbol_table_built = true;
+    }
     int lo = 0, hi = symbol_table.symbols_n;
     while (lo < hi)
     {
@@ -192,6 +375,458 @@ static void fprint_buffer(FILE *f, const char *buffer, size_t size)
     }
 }
 
+static void add_record(struct Records *records, const char *key, uint64_t value)
+{
+    if (records->n == records->capacity)
+    {
+        records->capacity = records->capacity ? 2 * records->capacity : 1024;
+        records->records = realloc(records->records, records->capacity * sizeof(*records->records));
+        if (!records->records)
+        {
+            perror("realloc records failed");
+            exit(2);
+        }
+    }
+    struct Record *record = &records->records[records->n];
+    record->key = strdup(key);
+    if (!record->key)
+    {
+        perror("strdup key failed");
+        exit(2);
+    }
+    record->value = value;
+    record->seq = records->n;
+    records->n++;
+}
+
+static int compare_records_by_key(const void *a, const void *b)
+{
+    const struct Record *ra = a, *rb = b;
+    return strcmp(ra->key, rb->key);
+}
+
+static int compare_records(const void *a, const void *b)
+{
+    const struct Record *ra = a, *rb = b;
+    int cmp = strcmp(ra->key, rb->key);
+    if (cmp != 0)
+        return cmp;
+    // Newest first.
+    return ra->seq < rb->seq ? 1 : ra->seq > rb->seq ? -1 : 0;
+}
+
+// Sorts the records by key, keeping only the newest for each key.
+static void sort_records(struct Records *records)
+{
+    qsort(records->records, records->n, sizeof(*records->records), compare_records);
+    size_t n = 0;
+    for (size_t i = 0; i < records->n; i++)
+    {
+        if (n > 0 && strcmp(records->records[n-1].key, records->records[i].key) == 0)
+            free(records->records[i].key);
+        else
+            records->records[n++] = records->records[i];
+    }
+    records->n = n;
+}
+
+// Sorts the records by key, adding together the values for each key.
+static void sum_records(struct Records *records)
+{
+    qsort(records->records, records->n, sizeof(*records->records), compare_records_by_key);
+    size_t n = 0;
+    for (size_t i = 0; i < records->n; i++)
+    {
+        if (n > 0 && strcmp(records->records[n-1].key, records->records[i].key) == 0)
+        {
+            records->records[n-1].value += records->records[i].value;
+            free(records->records[i].key);
+        }
+        else
+        {
+            records->records[n++] = records->records[i];
+        }
+    }
+    records->n = n;
+}
+
+// Only finds records that were loaded.
+static const struct Record *lookup_record(const struct Records *records, const char *key)
+{
+    struct Record needle = { .key = (char *)key };
+    return bsearch(&needle, records->records, records->loaded_n, sizeof(*records->records), compare_records_by_key);
+}
+
+static void load_records(struct Records *records, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        if (errno != ENOENT)
+            perror("fopen records failed");
+        return;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), f))
+    {
+        char *key;
+        uint64_t value = strtoull(line, &key, 10);
+        size_t n = strlen(key);
+        if (key == line || key[0] != '\t' || key[n-1] != '\n')
+            continue;
+        key[n-1] = '\0';
+        add_record(records, key + 1, value);
+    }
+    fclose(f);
+    sort_records(records);
+    records->loaded_n = records->n;
+}
+
+// Writes the records back out if any were added. The files are only
+// advisory, so errors are reported but don't fail the run.
+static void save_records(struct Records *records, const char *path)
+{
+    if (records->n == records->loaded_n)
+        return;
+    sort_records(records);
+    char tmp_path[FILENAME_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *f = fopen(tmp_path, "w");
+    if (!f)
+    {
+        perror("fopen records failed");
+        return;
+    }
+    for (size_t i = 0; i < records->n; i++)
+        fprintf(f, "%llu\t%s\n", (unsigned long long)records->records[i].value, records->records[i].key);
+    if (fclose(f) != 0)
+        perror("write records failed");
+    else if (rename(tmp_path, path) == -1)
+        perror("rename records failed");
+}
+
+static uint64_t elapsed_us(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000 + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+static void record_timing(const struct Runner *runner, uint64_t us)
+{
+    if (!timings_path)
+        return;
+    char key[sizeof(runner->timing_filename) + sizeof(runner->timing_name)];
+    snprintf(key, sizeof(key), "%s\t%s", runner->timing_filename, runner->timing_name);
+    add_record(&timings, key, us);
+}
+
+// Parses "<cycles> <benchmark>" from a B command.
+static void record_benchmark(const struct Runner *runner, const char *soc, const char *eol)
+{
+    char *label;
+    uint64_t cycles = strtoull(soc, &label, 10);
+    if (label == soc || label[0] != ' ')
+        return;
+    label++;
+    char key[sizeof(runner->timing_name) + 256];
+    snprintf(key, sizeof(key), "%s\t%.*s", runner->timing ? runner->timing_name : runner->test_name, (int)(eol - label - 1), label);
+    add_record(&benchmarks, key, cycles);
+}
+
+static const char *function_name(uint32_t address, char *buffer, size_t size)
+{
+    const struct Symbol *symbol = lookup_address(address);
+    if (symbol)
+        return symbol->name;
+    if (address < 0x4000)
+        return "BIOS";
+    snprintf(buffer, size, "0x%07x", address);
+    return buffer;
+}
+
+// Returns whether the Thumb BL before 'ret' calls 'function'.
+static bool returns_from(uint32_t ret, const struct Symbol *function)
+{
+    size_t available;
+    const uint8_t *bl = read_address((ret & ~1) - 4, &available);
+    if (bl == NULL || available < 4 || function == NULL)
+        return false;
+    uint16_t hi = bl[0] | (bl[1] << 8);
+    uint16_t lo = bl[2] | (bl[3] << 8);
+    if ((hi & 0xF800) != 0xF000 || (lo & 0xF800) != 0xF800)
+        return false;
+    int32_t offset = ((int32_t)((hi & 0x7FF) << 21) >> 9) | ((lo & 0x7FF) << 1);
+    return (ret & ~1) + offset == (function->address & ~1);
+}
+
+// Parses "<pc> <lr> <return addresses...>" from an S command.
+static void record_sample(struct Runner *runner, const char *soc, const char *eol)
+{
+    if (!profile_path && !coverage_path)
+        return;
+
+    uint32_t addresses[2 + MAX_PROFILE_FRAMES];
+    size_t addresses_n = 0;
+    const char *p = soc;
+    while (addresses_n < ARRAY_COUNT(addresses) && (p = memmem(p, eol - p, "<0x", 3)))
+    {
+        char *end;
+        addresses[addresses_n++] = strtoul(p + 3, &end, 16);
+        p = end;
+    }
+    if (addresses_n < 2)
+        return;
+
+    // Outermost first.
+    uint32_t frames[2 + MAX_PROFILE_FRAMES];
+    size_t frames_n = 0;
+    for (size_t i = addresses_n - 1; i >= 2; i--)
+        frames[frames_n++] = addresses[i];
+    if (returns_from(addresses[1], lookup_address(addresses[0]))
+     && (addresses_n == 2 || addresses[1] != addresses[2]))
+        frames[frames_n++] = addresses[1];
+    frames[frames_n++] = addresses[0];
+
+    const char *names[ARRAY_COUNT(frames)];
+    char buffers[ARRAY_COUNT(frames)][16];
+    bool seen[ARRAY_COUNT(frames)];
+    if (coverage_path && runner->coverage.n == runner->coverage.capacity)
+        sum_records(&runner->coverage);
+    for (size_t i = 0; i < frames_n; i++)
+    {
+        names[i] = function_name(frames[i], buffers[i], sizeof(buffers[i]));
+        seen[i] = false;
+        for (size_t j = 0; j < i && !seen[i]; j++)
+            seen[i] = strcmp(names[i], names[j]) == 0;
+        if (coverage_path && !seen[i])
+            add_record(&runner->coverage, names[i], 1);
+    }
+    if (!profile_path)
+        return;
+
+    char stack[8192];
+    const char *name = runner->timing ? runner->timing_name : runner->test_name;
+    size_t n = 0;
+    for (; name[n] != '\0' && n < 256; n++)
+        stack[n] = name[n] == ';' ? ',' : name[n];
+    for (size_t i = 0; i < frames_n; i++)
+    {
+        n += snprintf(&stack[n], sizeof(stack) - n, ";%s", names[i]);
+        if (n >= sizeof(stack))
+            n = sizeof(stack) - 1;
+        if (!seen[i])
+            add_record(&profile_total, names[i], 1);
+    }
+    add_record(&profile_stacks, stack, 1);
+    add_record(&profile_self, names[frames_n - 1], 1);
+    profile_samples++;
+}
+
+static void clear_records(struct Records *records)
+{
+    for (size_t i = 0; i < records->n; i++)
+        free(records->records[i].key);
+    records->n = 0;
+    records->loaded_n = 0;
+}
+
+// Adds the functions that the runner's test was sampled in to the coverage.
+static void record_coverage(struct Runner *runner)
+{
+    if (!coverage_path)
+        return;
+    char key[sizeof(runner->timing_filename) + sizeof(runner->timing_name) + 256];
+    snprintf(key, sizeof(key), "%s\t%s", runner->timing_filename, runner->timing_name);
+    add_record(&coverage_tests, key, 0);
+    sum_records(&runner->coverage);
+    for (size_t i = 0; i < runner->coverage.n; i++)
+    {
+        snprintf(key, sizeof(key), "%s\t%s\t%s", runner->timing_filename, runner->timing_name, runner->coverage.records[i].key);
+        add_record(&coverage, key, runner->coverage.records[i].value);
+    }
+    clear_records(&runner->coverage);
+}
+
+static void add_to_list(struct TestList *list, const struct Runner *runner)
+{
+    if (list->n < MAX_SUMMARY_TESTS_TO_LIST)
+    {
+        strcpy(list->names[list->n], runner->test_name);
+        strcpy(list->filename_lines[list->n], runner->filename_line);
+    }
+    list->n++;
+}
+
+static FILE *open_results(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+    {
+        perror("fopen results failed");
+        exit(2);
+    }
+    fcntl(fileno(f), F_SETFD, FD_CLOEXEC);
+    return f;
+}
+
+// Returns the length of the terminal escape sequence at 's', or 0.
+static size_t escape_length(const char *s, const char *end)
+{
+    if (s[0] != '\e' || s + 1 == end || s[1] != '[')
+        return 0;
+    const char *t = s + 2;
+    while (t < end && (*t < '@' || *t > '~'))
+        t++;
+    return t < end ? t - s + 1 : end - s;
+}
+
+static void fprint_json_string(FILE *f, const char *s, size_t n)
+{
+    const char *end = s + n;
+    fputc('"', f);
+    while (s < end)
+    {
+        size_t escape = escape_length(s, end);
+        if (escape > 0)
+        {
+            s += escape;
+            continue;
+        }
+        unsigned char c = *s++;
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c == '\n')
+            fputs("\\n", f);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static void fprint_xml_string(FILE *f, const char *s, size_t n)
+{
+    const char *end = s + n;
+    while (s < end)
+    {
+        size_t escape = escape_length(s, end);
+        if (escape > 0)
+        {
+            s += escape;
+            continue;
+        }
+        unsigned char c = *s++;
+        switch (c)
+        {
+        case '&': fputs("&amp;", f); break;
+        case '<': fputs("&lt;", f); break;
+        case '>': fputs("&gt;", f); break;
+        case '"': fputs("&quot;", f); break;
+        case '\t':
+        case '\n':
+            fputc(c, f);
+            break;
+        default:
+            // Other control characters are not allowed in XML 1.0.
+            if (c >= 0x20)
+                fputc(c, f);
+            break;
+        }
+    }
+}
+
+// Writes one test's result to the results files. 'command' is the
+// command that reported it, and 'result' the rest of its line.
+static void write_result(int i, const struct Runner *runner, char command, const char *result, size_t result_n, uint64_t us)
+{
+    const char *name = runner->timing ? runner->timing_name : runner->test_name;
+    size_t filename_n = strcspn(runner->filename_line, ":");
+    unsigned long line = runner->filename_line[filename_n] == ':' ? strtoul(&runner->filename_line[filename_n + 1], NULL, 10) : 0;
+    const char *status;
+    switch (command)
+    {
+    case 'P': status = "pass"; break;
+    case 'K': status = "known_failing"; break;
+    case 'U': status = "known_failing_passing"; break;
+    case 'T': status = "todo"; break;
+    case 'A': status = "assumption_failed"; break;
+    default:  status = "fail"; break;
+    }
+
+    // Translate addresses in the output to symbols, as it's printed.
+    char *output = NULL;
+    size_t output_n = 0;
+    if (runner->output_buffer_size > 0)
+    {
+        FILE *f = open_memstream(&output, &output_n);
+        if (!f)
+        {
+            perror("open_memstream failed");
+            exit(2);
+        }
+        fprint_buffer(f, runner->output_buffer, runner->output_buffer_size);
+        fclose(f);
+    }
+
+    if (results_json)
+    {
+        fputs("{\"name\":", results_json);
+        fprint_json_string(results_json, name, strlen(name));
+        fputs(",\"file\":", results_json);
+        fprint_json_string(results_json, runner->filename_line, filename_n);
+        fprintf(results_json, ",\"line\":%lu,\"status\":\"%s\",\"result\":", line, status);
+        fprint_json_string(results_json, result, result_n);
+        fprintf(results_json, ",\"us\":%llu", (unsigned long long)us);
+        if (runner->frames >= 0)
+            fprintf(results_json, ",\"frames\":%ld", runner->frames);
+        fprintf(results_json, ",\"runner\":%d", i);
+        if (output_n > 0)
+        {
+            fputs(",\"output\":", results_json);
+            fprint_json_string(results_json, output, output_n);
+        }
+        fputs("}\n", results_json);
+        fflush(results_json);
+    }
+
+    if (results_junit)
+    {
+        fseek(results_junit, results_junit_end, SEEK_SET);
+        fputs("<testcase classname=\"", results_junit);
+        fprint_xml_string(results_junit, runner->filename_line, filename_n);
+        fputs("\" name=\"", results_junit);
+        fprint_xml_string(results_junit, name, strlen(name));
+        fputs("\" file=\"", results_junit);
+        fprint_xml_string(results_junit, runner->filename_line, filename_n);
+        fprintf(results_junit, "\" line=\"%lu\" time=\"%llu.%06llu\">\n", line, (unsigned long long)(us / 1000000), (unsigned long long)(us % 1000000));
+        fprintf(results_junit, "<properties><property name=\"runner\" value=\"%d\"/>", i);
+        if (runner->frames >= 0)
+            fprintf(results_junit, "<property name=\"frames\" value=\"%ld\"/>", runner->frames);
+        fputs("</properties>\n", results_junit);
+        if (command != 'P')
+        {
+            bool failure = command == 'F' || command == 'U';
+            fprintf(results_junit, "<%s message=\"", failure ? "failure" : "skipped");
+            fprint_xml_string(results_junit, result, result_n);
+            fputs("\"/>\n", results_junit);
+        }
+        if (output_n > 0)
+        {
+            fputs("<system-out>", results_junit);
+            fprint_xml_string(results_junit, output, output_n);
+            fputs("</system-out>\n", results_junit);
+        }
+        fputs("</testcase>\n", results_junit);
+        results_junit_end = ftell(results_junit);
+        fputs(junit_footer, results_junit);
+        fflush(results_junit);
+    }
+
+    free(output);
+}
+
 static void handle_read(int i, struct Runner *runner)
 {
     char *sol = runner->input_buffer;
@@ -219,23 +854,52 @@ static void handle_read(int i, struct Runner *runner)
                 {
                 case 'N':
                     soc += 2;
-                    if (sizeof(runner->test_name) <= eol - soc - 1)
+                    if (sizeof(runner->test_name) <= (size_t)(eol - soc - 1))
                     {
                         fprintf(stderr, "test_name too long\n");
                         exit(2);
                     }
                     strncpy(runner->test_name, soc, eol - soc - 1);
                     runner->test_name[eol - soc - 1] = '\0';
+                    // Later Ns may decorate the name with progress, so
+                    // only the first is used to identify the test.
+                    if (!runner->timing)
+                    {
+                        runner->timing = true;
+                        clock_gettime(CLOCK_MONOTONIC, &runner->timing_start);
+                        strcpy(runner->timing_name, runner->test_name);
+                        runner->timing_filename[0] = '\0';
+                        runner->frames = -1;
+                        clear_records(&runner->coverage);
+                    }
                     break;
                 case 'L':
                     soc += 2;
-                    if (sizeof(runner->filename_line) <= eol - soc - 1)
+                    if (sizeof(runner->filename_line) <= (size_t)(eol - soc - 1))
                     {
                         fprintf(stderr, "filename_line too long\n");
                         exit(2);
                     }
                     strncpy(runner->filename_line, soc, eol - soc - 1);
                     runner->filename_line[eol - soc - 1] = '\0';
+                    if (runner->timing && runner->timing_filename[0] == '\0')
+                    {
+                        size_t n = strcspn(runner->filename_line, ":");
+                        memcpy(runner->timing_filename, runner->filename_line, n);
+                        runner->timing_filename[n] = '\0';
+                    }
+                    break;
+
+                case 'D':
+                    runner->frames = strtol(soc + 2, NULL, 10);
+                    break;
+
+                case 'S':
+                    record_sample(runner, soc + 2, eol);
+                    break;
+
+                case 'B':
+                    record_benchmark(runner, soc + 2, eol);
                     break;
 
                 case 'P':
@@ -245,33 +909,28 @@ static void handle_read(int i, struct Runner *runner)
                     runner->knownFails++;
                     goto add_to_results;
                 case 'U':
-                    if (runner->knownFailsPassing < MAX_SUMMARY_TESTS_TO_LIST)
-                    {
-                        strcpy(runner->knownFailingPassed_TestNames[runner->knownFailsPassing], runner->test_name);
-                        strcpy(runner->knownFailingPassed_FilenameLine[runner->knownFailsPassing], runner->filename_line);
-                    }
-                    runner->knownFailsPassing++;
+                    add_to_list(&known_failing_passed, runner);
                     goto add_to_results;
                 case 'T':
                     runner->todos++;
                     goto add_to_results;
                 case 'A':
-                    if (runner->assumptionFails < MAX_SUMMARY_TESTS_TO_LIST)
-                    {
-                        strcpy(runner->assumeFailed_TestNames[runner->assumptionFails], runner->test_name);
-                        strcpy(runner->assumeFailed_FilenameLine[runner->assumptionFails], runner->filename_line);
-                    }
-                    runner->assumptionFails++;
+                    add_to_list(&assume_failed, runner);
                     goto add_to_results;
                 case 'F':
-                    if (runner->fails < MAX_SUMMARY_TESTS_TO_LIST)
-                    {
-                        strcpy(runner->failed_TestNames[runner->fails], runner->test_name);
-                        strcpy(runner->failed_TestFilenameLine[runner->fails], runner->filename_line);
-                    }
-                    runner->fails++;
+                    add_to_list(&failed, runner);
 add_to_results:
                     runner->results++;
+                    {
+                        uint64_t us = runner->timing ? elapsed_us(&runner->timing_start) : 0;
+                        if (runner->timing)
+                        {
+                            record_timing(runner, us);
+                            record_coverage(runner);
+                        }
+                        write_result(i, runner, soc[1], soc + 2, eol - soc - 3, us);
+                        runner->timing = false;
+                    }
                     soc += 2;
                     fprintf(stdout, "[%0*d] %s: ", runners_digits, i, runner->test_name);
                     fwrite(soc, 1, eol - soc, stdout);
@@ -287,10 +946,10 @@ add_to_results:
             else
             {
 buffer_output:
-                if (runner->output_buffer_size + eol - soc >= runner->output_buffer_capacity)
+                if (runner->output_buffer_size + (size_t)(eol - soc) >= runner->output_buffer_capacity)
                 {
                     runner->output_buffer_capacity *= 2;
-                    if (runner->output_buffer_capacity < runner->output_buffer_size + eol - soc)
+                    if (runner->output_buffer_capacity < runner->output_buffer_size + (size_t)(eol - soc))
                         runner->output_buffer_capacity = runner->output_buffer_size + eol - soc;
                     runner->output_buffer = realloc(runner->output_buffer, runner->output_buffer_capacity);
                     if (!runner->output_buffer)
@@ -327,9 +986,48 @@ buffer_output:
     }
 }
 
+// Prints one line for each running runner, truncated to the width of the
+// terminal. If there are too many runners to fit in half of its height,
+// the rest are summarized on the last line.
+static void draw_status(void)
+{
+    struct winsize winsize;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &winsize) == -1)
+    {
+        perror("ioctl TIOCGWINSZ failed");
+        exit(2);
+    }
+    int max_lines = winsize.ws_row >= 4 ? winsize.ws_row / 2 : 2;
+    int name_width = winsize.ws_col - (4 + runners_digits);
+    if (winsize.ws_col == 0 || name_width < 0)
+        name_width = INT32_MAX;
+
+    int running = 0;
+    for (unsigned i = 0; i < nrunners; i++)
+    {
+        if (runners[i].outfd >= 0)
+            running++;
+    }
+
+    status_lines = 0;
+    for (unsigned i = 0; i < nrunners; i++)
+    {
+        if (runners[i].outfd < 0)
+            continue;
+        if (running > max_lines && status_lines == max_lines - 1)
+        {
+            fprintf(stdout, "... and %d more\n", running - status_lines);
+            status_lines++;
+            break;
+        }
+        fprintf(stdout, "[%0*d] %.*s\n", runners_digits, i, name_width, runners[i].test_name);
+        status_lines++;
+    }
+}
+
 static void unlink_roms(void)
 {
-    for (int i = 0; i < nrunners; i++)
+    for (unsigned i = 0; i < nrunners; i++)
     {
         if (runners[i].rom_path[0])
         {
@@ -345,6 +1043,7 @@ static void unlink_roms(void)
 
 static void exit2(int _)
 {
+    (void)_;
     exit(2);
 }
 
@@ -393,7 +1092,7 @@ static void build_symbol_table(void *elf)
 
     const Elf32_Sym *symtab = (Elf32_Sym *)(elf + shdr_symtab->sh_offset);
     const char *strtab = (const char *)(elf + shdr_strtab->sh_offset);
-    for (int i = 0; i < shdr_symtab->sh_size / shdr_symtab->sh_entsize; i++)
+    for (Elf32_Word i = 0; i < shdr_symtab->sh_size / shdr_symtab->sh_entsize; i++)
     {
         if (symtab[i].st_name == 0) continue;
         if (symtab[i].st_shndx > ehdr->e_shnum) continue;
@@ -424,156 +1123,582 @@ error:
     symbol_table.symbols_n = 0;
 }
 
-int main(int argc, char *argv[])
+static const Elf32_Shdr *find_section(const char *name)
 {
-    if (argc < 4)
+    const Elf32_Ehdr *ehdr = (Elf32_Ehdr *)elf;
+    const Elf32_Shdr *shdrs = (Elf32_Shdr *)(elf + ehdr->e_shoff);
+    if (ehdr->e_shstrndx == SHN_UNDEF)
+        return NULL;
+    const char *shstr = (const char *)(elf + shdrs[ehdr->e_shstrndx].sh_offset);
+    for (int i = 0; i < ehdr->e_shnum; i++)
     {
-        fprintf(stderr, "usage %s mgba-rom-test objcopy rom\n", argv[0]);
-        exit(2);
+        if (strcmp(shstr + shdrs[i].sh_name, name) == 0)
+            return &shdrs[i];
     }
+    return NULL;
+}
 
-    bool tty = isatty(STDOUT_FILENO);
-    if (!tty)
-    {
-        const char *v = getenv("MAKE_TERMOUT");
-        tty = v && v[0] == '\0';
-    }
+static bool find_symbol(const char *name, uint32_t *address)
+{
+    const Elf32_Shdr *shdr_symtab = find_section(".symtab");
+    const Elf32_Shdr *shdr_strtab = find_section(".strtab");
+    if (!shdr_symtab || !shdr_strtab)
+        return false;
 
-    if (tty)
+    const Elf32_Sym *symtab = (Elf32_Sym *)(elf + shdr_symtab->sh_offset);
+    const char *strtab = (const char *)(elf + shdr_strtab->sh_offset);
+    for (Elf32_Word i = 0; i < shdr_symtab->sh_size / shdr_symtab->sh_entsize; i++)
     {
-        char *stdout_buffer = malloc(64 * 1024);
-        if (!stdout_buffer)
+        if (symtab[i].st_name != 0 && strcmp(strtab + symtab[i].st_name, name) == 0)
         {
-            perror("malloc stdout_buffer failed");
-            exit(2);
+            *address = symtab[i].st_value;
+            return true;
         }
-        setvbuf(stdout, stdout_buffer, _IOFBF, 64 * 1024);
-    }
-    else
-    {
-        setvbuf(stdout, NULL, _IONBF, 0);
     }
+    return false;
+}
 
-    int elffd;
-    if ((elffd = open(argv[3], O_RDONLY)) == -1)
+// Returns the contents of the ELF at a GBA address, and how many bytes
+// of the same section follow it.
+static const void *read_address(uint32_t address, size_t *available)
+{
+    const Elf32_Ehdr *ehdr = (Elf32_Ehdr *)elf;
+    const Elf32_Shdr *shdrs = (Elf32_Shdr *)(elf + ehdr->e_shoff);
+    for (int i = 0; i < ehdr->e_shnum; i++)
     {
-        perror("open elffd failed");
-        exit(2);
+        if (shdrs[i].sh_type == SHT_PROGBITS
+         && shdrs[i].sh_addr <= address
+         && address < shdrs[i].sh_addr + shdrs[i].sh_size)
+        {
+            *available = shdrs[i].sh_addr + shdrs[i].sh_size - address;
+            return elf + shdrs[i].sh_offset + (address - shdrs[i].sh_addr);
+        }
     }
+    return NULL;
+}
 
-    struct stat elfst;
-    if (fstat(elffd, &elfst) == -1)
+static const char *read_string(uint32_t address)
+{
+    size_t available;
+    const char *string = read_address(address, &available);
+    if (string == NULL || memchr(string, '\0', available) == NULL)
+        return NULL;
+    return string;
+}
+
+// Same as the filtering in test/test_runner.c.
+static bool test_matches(const char *pattern, const char *name, const char *filename)
+{
+    size_t n = strlen(pattern);
+    if (n > 2 && pattern[n-2] == '.' && pattern[n-1] == 'c')
+        return strcmp(pattern, filename) == 0;
+    else if (pattern[0] == '*')
+        return strstr(name, &pattern[1]) != NULL;
+    else
+        return strncmp(pattern, name, n) == 0;
+}
+
+// Fills the queue with the tests that the runners would run.
+static bool build_queue(void)
+{
+    uint32_t start_tests, stop_tests, assumptions_runner, argv_address;
+    if (!find_symbol("__start_tests", &start_tests)
+     || !find_symbol("__stop_tests", &stop_tests)
+     || !find_symbol("gAssumptionsRunner", &assumptions_runner)
+     || !find_symbol("gTestRunnerArgv", &argv_address)
+     || !find_symbol("gTestRunnerEnd", &(uint32_t){0}))
+        return false;
+
+    size_t available;
+    tests_n = (stop_tests - start_tests) / sizeof(struct Test);
+    tests = read_address(start_tests, &available);
+    const char *pattern = read_string(argv_address);
+    if (tests == NULL || available < tests_n * sizeof(struct Test) || pattern == NULL)
+        return false;
+
+    queue = malloc(tests_n * sizeof(*queue) + 1);
+    if (queue == NULL)
     {
-        perror("stat elffd failed");
+        perror("malloc queue failed");
         exit(2);
     }
+    for (uint32_t i = 0; i < tests_n; i++)
+    {
+        if (tests[i].runner == assumptions_runner)
+            continue;
+        const char *name = read_string(tests[i].name);
+        const char *filename = read_string(tests[i].filename);
+        if (name == NULL || filename == NULL)
+        {
+            free(queue);
+            queue = NULL;
+            return false;
+        }
+        if (test_matches(pattern, name, filename))
+            queue[queue_n++] = i;
+    }
+    return true;
+}
 
-    void *elf;
-    if ((elf = mmap(NULL, elfst.st_size, PROT_READ, MAP_PRIVATE, elffd, 0)) == MAP_FAILED)
+static int compare_symbol_names(const void *a, const void *b)
+{
+    const struct Symbol *const *sa = a, *const *sb = b;
+    return strcmp((*sa)->name, (*sb)->name);
+}
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+// Marks the symbols called 'name', and returns how many there were.
+static size_t mark_symbols(const struct Symbol **by_name, uint8_t *marks, uint8_t mark, const char *name)
+{
+    struct Symbol needle = { .name = name };
+    const struct Symbol *needle_p = &needle;
+    const struct Symbol **found = bsearch(&needle_p, by_name, symbol_table.symbols_n, sizeof(*by_name), compare_symbol_names);
+    if (found == NULL)
+        return 0;
+    while (found > by_name && strcmp(found[-1]->name, name) == 0)
+        found--;
+    size_t n = 0;
+    for (; found < by_name + symbol_table.symbols_n && strcmp((*found)->name, name) == 0; found++, n++)
     {
-        perror("mmap elffd failed");
-        exit(2);
+        size_t i = *found - symbol_table.symbols;
+        if (marks[i] == 0)
+            marks[i] = mark;
     }
+    return n;
+}
 
-    build_symbol_table(elf);
+struct Reference {
+    uint32_t symbol;
+    uint32_t referrer;
+};
 
-    nrunners = 1;
-    const char *makeflags = getenv("MAKEFLAGS");
-    if (makeflags)
+struct References {
+    struct Reference *references;
+    size_t n;
+    size_t capacity;
+};
+
+// Records that 'referrer' calls or points to the symbol at 'address'.
+static void add_reference(struct References *references, size_t referrer, uint32_t address)
+{
+    if (address < 0x2000000 || address >= 0xA000000)
+        return;
+    // Thumb functions' symbols start one byte in, so the function before
+    // would otherwise claim their first byte.
+    const struct Symbol *symbol = lookup_address(address | 1);
+    if (symbol == NULL)
+        symbol = lookup_address(address);
+    if (symbol == NULL || symbol == &symbol_table.symbols[referrer])
+        return;
+    if (references->n == references->capacity)
     {
-        int e;
-        regex_t preg;
-        regmatch_t pmatch[4];
-        if ((e = regcomp(&preg, "(^| )-j([0-9]*)($| )", REG_EXTENDED)) != 0)
+        references->capacity = references->capacity ? 2 * references->capacity : 4096;
+        references->references = realloc(references->references, references->capacity * sizeof(*references->references));
+        if (!references->references)
         {
-            char errbuf[256];
-            regerror(e, &preg, errbuf, sizeof(errbuf));
-            fprintf(stderr, "regcomp failed: '%s'\n", errbuf);
+            perror("realloc references failed");
             exit(2);
         }
-        if (regexec(&preg, makeflags, ARRAY_COUNT(pmatch), pmatch, 0) != REG_NOMATCH)
+    }
+    references->references[references->n++] = (struct Reference) {
+        .symbol = symbol - symbol_table.symbols,
+        .referrer = referrer,
+    };
+}
+
+// Records the symbols that 'referrer' calls or points to.
+static void add_references(struct References *references, size_t referrer)
+{
+    const struct Symbol *symbol = &symbol_table.symbols[referrer];
+    size_t available;
+    uint32_t start = symbol->address & ~1;
+    const uint8_t *data = read_address(start, &available);
+    if (data == NULL || start < 0x8000000)
+        return;
+    size_t size = min(symbol->size, available);
+    for (size_t i = 0; i + 4 <= size; i += 2)
+    {
+        uint16_t hi = data[i] | (data[i+1] << 8);
+        uint16_t lo = data[i+2] | (data[i+3] << 8);
+        if ((symbol->address & 1) && (hi & 0xF800) == 0xF000 && (lo & 0xF800) == 0xF800)
         {
-            if (pmatch[2].rm_so == pmatch[2].rm_eo)
-                nrunners = sysconf(_SC_NPROCESSORS_ONLN);
-            else
-                sscanf(makeflags + pmatch[2].rm_so, "%d", &nrunners);
+            int32_t offset = ((int32_t)((hi & 0x7FF) << 21) >> 9) | ((lo & 0x7FF) << 1);
+            add_reference(references, referrer, start + i + 4 + offset);
         }
-        regfree(&preg);
+        if ((start + i) % 4 == 0)
+            add_reference(references, referrer, (hi | (lo << 16)) & ~1);
     }
-    if (nrunners > MAX_PROCESSES)
-        nrunners = MAX_PROCESSES;
-    runners_digits = ceil(log10(nrunners));
-    runners = calloc(nrunners, sizeof(*runners));
-    if (!runners)
+}
+
+static int compare_references(const void *a, const void *b)
+{
+    const struct Reference *ra = a, *rb = b;
+    if (ra->symbol != rb->symbol)
+        return ra->symbol < rb->symbol ? -1 : 1;
+    return ra->referrer < rb->referrer ? -1 : ra->referrer > rb->referrer;
+}
+
+// Removes the tests that the changes can't affect from the queue. Any
+// change that can't be traced to symbols in the ELF keeps all the tests.
+static void select_affected_tests(void)
+{
+    FILE *f = fopen(changes_path, "r");
+    if (!f)
     {
-        perror("calloc runners failed");
+        perror("fopen changes failed");
         exit(2);
     }
-    for (int i = 0; i < nrunners; i++)
+    // "<file>\t<symbol>" of the changed and defined symbols.
+    struct Records changed = { 0 }, defined = { 0 }, test_files = { 0 };
+    char line[1024];
+    while (fgets(line, sizeof(line), f))
     {
-        runners[i].input_buffer_capacity = 4096;
-        runners[i].input_buffer = malloc(runners[i].input_buffer_capacity);
-        runners[i].output_buffer_capacity = 4096;
-        runners[i].output_buffer = malloc(runners[i].output_buffer_capacity);
-        strcpy(runners[i].test_name, "WAITING...");
-        if (tty)
-            fprintf(stdout, "[%0*d] %s\n", runners_digits, i, runners[i].test_name);
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0] == '\0' || line[1] != '\t')
+            continue;
+        switch (line[0])
+        {
+        case '*':
+            fprintf(stdout, "Running all tests, because %s changed.\n", line + 2);
+            fclose(f);
+            return;
+        case 'S':
+            add_record(&changed, line + 2, 0);
+            break;
+        case 'F':
+            add_record(&defined, line + 2, 0);
+            break;
+        case 'T':
+            add_record(&test_files, line + 2, 0);
+            break;
+        }
     }
-    fflush(stdout);
-    atexit(unlink_roms);
-    signal(SIGINT, exit2);
-    signal(SIGTERM, exit2);
+    fclose(f);
+    sort_records(&test_files);
+    test_files.loaded_n = test_files.n;
 
-    // Start test runners.
-    pid_t parent_pid = getpid();
-    for (int i = 0; i < nrunners; i++)
+    struct Records coverage_map = { 0 };
+    load_records(&coverage_map, coverage_path);
+    if (coverage_map.n == 0)
+    {
+        fprintf(stdout, "Running all tests, because there is no coverage in %s.\n", coverage_path);
+        return;
+    }
+
+    if (!symbol_table_built)
+    {
+        build_symbol_table(elf);
+        symbol_table_built = true;
+    }
+    const struct Symbol **by_name = malloc(symbol_table.symbols_n * sizeof(*by_name) + 1);
+    uint8_t *marks = calloc(symbol_table.symbols_n + 1, 1);
+    if (!by_name || !marks)
     {
-        int pipefds[2];
-        if (pipe(pipefds) == -1)
+        perror("malloc marks failed");
+        exit(2);
+    }
+    for (size_t i = 0; i < symbol_table.symbols_n; i++)
+        by_name[i] = &symbol_table.symbols[i];
+    qsort(by_name, symbol_table.symbols_n, sizeof(*by_name), compare_symbol_names);
+
+    // Symbols that aren't in the ELF (e.g. because they were inlined) are
+    // replaced by every symbol defined in the same file.
+    for (size_t i = 0; i < changed.n; i++)
+    {
+        char *symbol = strchr(changed.records[i].key, '\t');
+        if (symbol == NULL || mark_symbols(by_name, marks, 1, symbol + 1) > 0)
+            continue;
+        size_t file_n = symbol - changed.records[i].key + 1, found = 0;
+        for (size_t j = 0; j < defined.n; j++)
         {
-            perror("pipe failed");
-            exit(2);
+            if (strncmp(defined.records[j].key, changed.records[i].key, file_n) == 0)
+                found += mark_symbols(by_name, marks, 1, defined.records[j].key + file_n);
         }
-        pid_t pid = fork();
-        if (pid == -1) {
-            perror("fork mgba-rom-test failed");
-            exit(2);
-        } else if (pid == 0) {
-            #ifndef __APPLE__
-            if (prctl(PR_SET_PDEATHSIG, SIGTERM) == -1)
-            {
-                perror("prctl failed");
-                _exit(2);
-            }
-            #endif
-            if (getppid() != parent_pid) // Parent died.
-            {
-                _exit(2);
-            }
-            if (close(pipefds[0]) == -1)
+        if (found == 0)
+        {
+            fprintf(stdout, "Running all tests, because nothing in %.*s is in the ELF.\n", (int)file_n - 1, changed.records[i].key);
+            return;
+        }
+    }
+
+    // Marks everything that refers to a marked symbol, until nothing
+    // more is marked. 'pending' holds the symbols whose referrers haven't
+    // been marked yet.
+    struct References references = { 0 };
+    for (size_t i = 0; i < symbol_table.symbols_n; i++)
+        add_references(&references, i);
+    qsort(references.references, references.n, sizeof(*references.references), compare_references);
+    size_t pending_n = 0;
+    uint32_t *pending = malloc(symbol_table.symbols_n * sizeof(*pending) + 1);
+    if (!pending)
+    {
+        perror("malloc pending failed");
+        exit(2);
+    }
+    for (size_t i = 0; i < symbol_table.symbols_n; i++)
+    {
+        if (marks[i] != 0)
+            pending[pending_n++] = i;
+    }
+    while (pending_n > 0)
+    {
+        uint32_t symbol = pending[--pending_n];
+        size_t lo = 0, hi = references.n;
+        while (lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            if (references.references[mid].symbol < symbol)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        for (; lo < references.n && references.references[lo].symbol == symbol; lo++)
+        {
+            uint32_t referrer = references.references[lo].referrer;
+            if (marks[referrer] == 0)
             {
-                perror("close pipefds[0] failed");
-                _exit(2);
+                marks[referrer] = 1;
+                pending[pending_n++] = referrer;
             }
-            if (dup2(pipefds[1], STDOUT_FILENO) == -1)
+        }
+    }
+
+    size_t names_n = 0;
+    const char **names = malloc(symbol_table.symbols_n * sizeof(*names) + 1);
+    if (!names)
+    {
+        perror("malloc names failed");
+        exit(2);
+    }
+    for (size_t i = 0; i < symbol_table.symbols_n; i++)
+    {
+        if (marks[i] != 0)
+            names[names_n++] = symbol_table.symbols[i].name;
+    }
+    qsort(names, names_n, sizeof(*names), compare_names);
+
+    // The coverage is sorted by test, so each test's functions are together.
+    struct Records covered = { 0 }, affected = { 0 };
+    for (size_t i = 0; i < coverage_map.n;)
+    {
+        const char *key = coverage_map.records[i].key;
+        const char *function = strchr(key, '\t');
+        function = function ? strchr(function + 1, '\t') : NULL;
+        if (function == NULL)
+        {
+            i++;
+            continue;
+        }
+        size_t test_n = function - key;
+        bool is_affected = false;
+        for (; i < coverage_map.n && strncmp(coverage_map.records[i].key, key, test_n + 1) == 0; i++)
+        {
+            const char *name = coverage_map.records[i].key + test_n + 1;
+            if (!is_affected && bsearch(&name, names, names_n, sizeof(*names), compare_names))
+                is_affected = true;
+        }
+        char test[1024];
+        snprintf(test, sizeof(test), "%.*s", (int)test_n, key);
+        add_record(&covered, test, 0);
+        if (is_affected)
+            add_record(&affected, test, 0);
+    }
+    covered.loaded_n = covered.n;
+    affected.loaded_n = affected.n;
+
+    size_t n = 0;
+    for (size_t i = 0; i < queue_n; i++)
+    {
+        const char *filename = read_string(tests[queue[i]].filename);
+        char test[1024];
+        snprintf(test, sizeof(test), "%s\t%s", filename, read_string(tests[queue[i]].name));
+        if (lookup_record(&test_files, filename)
+         || !lookup_record(&covered, test)
+         || lookup_record(&affected, test))
+            queue[n++] = queue[i];
+    }
+    fprintf(stdout, "Running %zu of %zu tests, which the changes could affect.\n", n, queue_n);
+    queue_n = n;
+    affected_only = true;
+}
+
+static int compare_chunk_costs(const void *a, const void *b)
+{
+    const struct Chunk *ca = a, *cb = b;
+    if (ca->cost != cb->cost)
+        return ca->cost < cb->cost ? 1 : -1;
+    return ca->start < cb->start ? -1 : ca->start > cb->start;
+}
+
+// Splits the queue into chunks. Each chunk is a share of the cost that's
+// left, so the chunks handed out last are small and everything finishes
+// at around the same time. The chunks are then handed out most expensive
+// first, so that a slow test isn't left until the end.
+static void build_chunks(void)
+{
+    uint64_t *costs = malloc(queue_n * sizeof(*costs) + 1);
+    chunks = malloc(queue_n * sizeof(*chunks) + 1);
+    if (!costs || !chunks)
+    {
+        perror("malloc chunks failed");
+        exit(2);
+    }
+
+    uint64_t known_cost = 0;
+    size_t known_n = 0;
+    for (size_t i = 0; i < queue_n; i++)
+    {
+        char key[1024];
+        snprintf(key, sizeof(key), "%s\t%s", read_string(tests[queue[i]].filename), read_string(tests[queue[i]].name));
+        const struct Record *timing = lookup_record(&timings, key);
+        costs[i] = timing ? timing->value + 1 : 0;
+        if (timing)
+        {
+            known_cost += costs[i];
+            known_n++;
+        }
+    }
+
+    uint64_t remaining = 0;
+    for (size_t i = 0; i < queue_n; i++)
+    {
+        if (costs[i] == 0)
+            costs[i] = known_n > 0 ? known_cost / known_n : 1;
+        remaining += costs[i];
+    }
+
+    for (size_t i = 0; i < queue_n;)
+    {
+        uint64_t target = remaining / (2 * nrunners);
+        struct Chunk *chunk = &chunks[chunks_n++];
+        chunk->start = queue[i];
+        chunk->cost = costs[i++];
+        while (i < queue_n && chunk->cost + costs[i] <= target
+            && (!affected_only || queue[i] == queue[i-1] + 1))
+            chunk->cost += costs[i++];
+        if (affected_only)
+            chunk->end = queue[i-1] + 1;
+        else
+            chunk->end = i < queue_n ? queue[i] : tests_n;
+        remaining -= chunk->cost;
+    }
+
+    qsort(chunks, chunks_n, sizeof(*chunks), compare_chunk_costs);
+    free(costs);
+}
+
+static bool next_chunk(uint32_t *start, uint32_t *end)
+{
+    if (chunks_next == chunks_n)
+        return false;
+    *start = chunks[chunks_next].start;
+    *end = chunks[chunks_next].end;
+    chunks_next++;
+    return true;
+}
+
+static off_t rom_offset(const char *name)
+{
+    uint32_t address;
+    if (!find_symbol(name, &address))
+        return -1;
+#ifdef __APPLE__
+    // 'objcopy -O binary' lays the ROM out from the start of the cartridge.
+    return address >= 0x8000000 ? address - 0x8000000 : -1;
+#else
+    size_t available;
+    const void *data = read_address(address, &available);
+    if (data == NULL || available < sizeof(uint32_t))
+        return -1;
+    return data - elf;
+#endif
+}
+
+static bool write_u32(int fd, off_t offset, uint32_t value)
+{
+    uint8_t bytes[4] = { value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24 };
+    return pwrite(fd, bytes, sizeof(bytes), offset) == sizeof(bytes);
+}
+
+static void format_u32(char *buffer, uint32_t value)
+{
+    sprintf(buffer, "\\x%02x\\x%02x\\x%02x\\x%02x", value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24);
+}
+
+static void start_runner(int i, uint32_t start, uint32_t end)
+{
+    const char *rom_path = runners[i].rom_path;
+    bool rom_ready = runners[i].rom_ready;
+    if (!rom_path[0])
+        sprintf(runners[i].rom_path, "/tmp/mgba-rom-test-hydra-%05d-%d", getpid(), i);
+
+    int pipefds[2];
+    if (pipe(pipefds) == -1)
+    {
+        perror("pipe failed");
+        exit(2);
+    }
+    fflush(stdout);
+    pid_t parent_pid = getpid();
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork mgba-rom-test failed");
+        exit(2);
+    } else if (pid == 0) {
+        #ifndef __APPLE__
+        if (prctl(PR_SET_PDEATHSIG, SIGTERM) == -1)
+        {
+            perror("prctl failed");
+            _exit(2);
+        }
+        #endif
+        if (getppid() != parent_pid) // Parent died.
+        {
+            _exit(2);
+        }
+        if (close(pipefds[0]) == -1)
+        {
+            perror("close pipefds[0] failed");
+            _exit(2);
+        }
+        if (dup2(pipefds[1], STDOUT_FILENO) == -1)
+        {
+            perror("dup2 stdout failed");
+            _exit(2);
+        }
+        if (close(pipefds[1]) == -1)
+        {
+            perror("close pipefds[1] failed");
+            _exit(2);
+        }
+        if (rom_ready)
+        {
+            int romfd;
+            if ((romfd = open(rom_path, O_WRONLY)) == -1)
             {
-                perror("dup2 stdout failed");
+                perror("open romfd failed");
                 _exit(2);
             }
-            if (close(pipefds[1]) == -1)
+            if (!write_u32(romfd, start_offset, start) || !write_u32(romfd, end_offset, end))
             {
-                perror("close pipefds[1] failed");
+                perror("write romfd failed");
                 _exit(2);
             }
-            char rom_path[FILENAME_MAX];
-            sprintf(rom_path, "/tmp/mgba-rom-test-hydra-%05d", getpid());
+            close(romfd);
+        }
+        else
+        {
             int tmpfd;
             if ((tmpfd = open(rom_path, O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR)) == -1)
             {
                 perror("open tmpfd failed");
                 _exit(2);
             }
-            if ((write(tmpfd, elf, elfst.st_size)) == -1)
+            if ((write(tmpfd, elf, elf_size)) == -1)
             {
                 perror("write tmpfd failed");
                 _exit(2);
@@ -586,10 +1711,14 @@ int main(int argc, char *argv[])
             }
             else if (patchelfpid == 0)
             {
-                char n_arg[5], i_arg[5];
-                snprintf(n_arg, sizeof(n_arg), "\\x%02x", nrunners);
-                snprintf(i_arg, sizeof(i_arg), "\\x%02x", i);
-                if (execlp("tools/patchelf/patchelf", "tools/patchelf/patchelf", rom_path, "gTestRunnerN", n_arg, "gTestRunnerI", i_arg, NULL) == -1)
+                // gTestRunnerN and gTestRunnerI are a u8, and are only used
+                // when the tests aren't handed out as ranges.
+                char n_arg[5], i_arg[5], start_arg[17], end_arg[17];
+                snprintf(n_arg, sizeof(n_arg), "\\x%02x", (uint8_t)(end != 0 ? 1 : nrunners));
+                snprintf(i_arg, sizeof(i_arg), "\\x%02x", (uint8_t)(end != 0 ? 0 : i));
+                format_u32(start_arg, start);
+                format_u32(end_arg, end);
+                if (execlp("tools/patchelf/patchelf", "tools/patchelf/patchelf", rom_path, "gTestRunnerN", n_arg, "gTestRunnerI", i_arg, "gTestRunnerStart", start_arg, "gTestRunnerEnd", end_arg, NULL) == -1)
                 {
                     perror("execlp patchelf failed");
                     _exit(2);
@@ -618,7 +1747,7 @@ int main(int argc, char *argv[])
             }
             else if (objcopypid == 0)
             {
-                if (execlp(argv[2], argv[2], "-O", "binary", rom_path, rom_path, NULL) == -1)
+                if (execlp(objcopy_path, objcopy_path, "-O", "binary", rom_path, rom_path, NULL) == -1)
                 {
                     perror("execlp objcopy failed");
                     _exit(2);
@@ -639,56 +1768,381 @@ int main(int argc, char *argv[])
                 }
             }
 #endif
-            // stdbuf is required because otherwise mgba never flushes
-            // stdout.
-            if (execlp("stdbuf", "stdbuf", "-oL", argv[1], "-l15", "-ClogLevel.gba.dma=16", "-Rr0", rom_path, NULL) == -1)
+        }
+        // stdbuf is required because otherwise mgba never flushes
+        // stdout.
+        if (execlp("stdbuf", "stdbuf", "-oL", mgba_rom_test_path, "-l15", "-ClogLevel.gba.dma=16", "-Rr0", rom_path, NULL) == -1)
+        {
+            perror("execl stdbuf mgba-rom-test failed");
+            _exit(2);
+        }
+    } else {
+        runners[i].pid = pid;
+        runners[i].rom_ready = start_offset >= 0 && end_offset >= 0;
+        runners[i].outfd = pipefds[0];
+        if (close(pipefds[1]) == -1)
+        {
+            perror("close pipefds[1] failed");
+            exit(2);
+        }
+    }
+}
+
+// Waits for a runner that has closed its output, and returns its exit code.
+static int reap_runner(struct Runner *runner)
+{
+    int wstatus;
+    if (waitpid(runner->pid, &wstatus, 0) == -1)
+    {
+        perror("waitpid runners[i] failed");
+        exit(2);
+    }
+    if (runner->output_buffer_size > 0)
+    {
+        fwrite(runner->output_buffer, 1, runner->output_buffer_size, stdout);
+        runner->output_buffer_size = 0;
+    }
+    if (WIFEXITED(wstatus))
+        return WEXITSTATUS(wstatus);
+    return 0;
+}
+
+// Lists the benchmarks that ran against their baselines, and returns how
+// many regressed by more than the tolerance. With -u, the baselines are
+// replaced instead.
+static int report_benchmarks(void)
+{
+    int regressions = 0;
+    sort_records(&benchmarks);
+    if (benchmarks.n == 0)
+        return 0;
+
+    fprintf(stdout, "\n  Benchmarks:\n");
+    for (size_t i = 0; i < benchmarks.n; i++)
+    {
+        const struct Record *benchmark = &benchmarks.records[i];
+        const struct Record *baseline = lookup_record(&baselines, benchmark->key);
+        const char *tab = strchr(benchmark->key, '\t');
+        fprintf(stdout, "  - %.*s - %s: %llu cycles", (int)(tab - benchmark->key), benchmark->key, tab + 1, (unsigned long long)benchmark->value);
+        if (baseline == NULL)
+        {
+            fprintf(stdout, ", \e[33mno baseline\e[0m\n");
+            continue;
+        }
+        double change = baseline->value ? 100.0 * ((double)benchmark->value - baseline->value) / baseline->value : 0;
+        bool regressed = benchmark->value * 100 > baseline->value * (100 + benchmark_tolerance);
+        fprintf(stdout, ", %sbaseline %llu (%+.1f%%)%s\n", regressed ? "\e[31m" : "", (unsigned long long)baseline->value, change, regressed ? "\e[0m" : "");
+        if (regressed)
+            regressions++;
+    }
+
+    if (update_baselines)
+    {
+        for (size_t i = 0; i < benchmarks.n; i++)
+            add_record(&baselines, benchmarks.records[i].key, benchmarks.records[i].value);
+        save_records(&baselines, baselines_path);
+        fprintf(stdout, "\nUpdated %zu baselines in %s.\n", benchmarks.n, baselines_path);
+        return 0;
+    }
+
+    if (regressions > 0)
+        fprintf(stdout, "\n- Benchmarks \e[31mREGRESSED\e[0m by more than %u%%: %d\n", benchmark_tolerance, regressions);
+    return regressions;
+}
+
+static int compare_record_values(const void *a, const void *b)
+{
+    const struct Record *ra = a, *rb = b;
+    if (ra->value != rb->value)
+        return ra->value < rb->value ? 1 : -1;
+    return strcmp(ra->key, rb->key);
+}
+
+// Writes the folded stacks and lists the functions with the most samples.
+static void report_profile(void)
+{
+    sum_records(&profile_stacks);
+    sum_records(&profile_self);
+    sum_records(&profile_total);
+    profile_total.loaded_n = profile_total.n;
+
+    FILE *f = fopen(profile_path, "w");
+    if (!f)
+    {
+        perror("fopen profile failed");
+    }
+    else
+    {
+        for (size_t i = 0; i < profile_stacks.n; i++)
+            fprintf(f, "%s %llu\n", profile_stacks.records[i].key, (unsigned long long)profile_stacks.records[i].value);
+        if (fclose(f) != 0)
+            perror("write profile failed");
+    }
+
+    if (profile_samples == 0)
+    {
+        fprintf(stdout, "\nNo profile samples. Was gTestRunnerProfile set?\n");
+        return;
+    }
+
+    qsort(profile_self.records, profile_self.n, sizeof(*profile_self.records), compare_record_values);
+    fprintf(stdout, "\n  Profile (%llu samples, in %s):\n", (unsigned long long)profile_samples, profile_path);
+    for (size_t i = 0; i < profile_self.n && i < MAX_PROFILE_FUNCTIONS; i++)
+    {
+        const struct Record *self = &profile_self.records[i];
+        const struct Record *total = lookup_record(&profile_total, self->key);
+        fprintf(stdout, "  - %5.1f%% self, %5.1f%% total: %s\n", 100.0 * self->value / profile_samples, 100.0 * (total ? total->value : 0) / profile_samples, self->key);
+    }
+}
+
+// Writes the coverage back out, replacing that of the tests that ran and
+// keeping that of the rest.
+static void save_coverage(void)
+{
+    // No samples, e.g. because gTestRunnerProfile wasn't set.
+    if (coverage.n == 0)
+        return;
+    sort_records(&coverage_tests);
+    coverage_tests.loaded_n = coverage_tests.n;
+    struct Records old = { 0 };
+    load_records(&old, coverage_path);
+    for (size_t i = 0; i < old.n; i++)
+    {
+        char *key = old.records[i].key;
+        char *tab = strchr(key, '\t');
+        tab = tab ? strchr(tab + 1, '\t') : NULL;
+        if (tab == NULL)
+            continue;
+        *tab = '\0';
+        bool ran = lookup_record(&coverage_tests, key) != NULL;
+        *tab = '\t';
+        if (!ran)
+            add_record(&coverage, key, old.records[i].value);
+    }
+    save_records(&coverage, coverage_path);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage %s [-t timings] [-b baselines [-r tolerance%%] [-u]] [-J results.jsonl] [-X results.xml] [-p profile] [-c coverage [-a changes]] mgba-rom-test objcopy rom\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "t:b:r:uJ:X:p:c:a:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            timings_path = optarg[0] != '\0' ? optarg : NULL;
+            break;
+        case 'b':
+            baselines_path = optarg[0] != '\0' ? optarg : NULL;
+            break;
+        case 'r':
+            benchmark_tolerance = strtoul(optarg, NULL, 10);
+            break;
+        case 'u':
+            update_baselines = true;
+            break;
+        case 'J':
+            if (optarg[0] != '\0')
+                results_json = open_results(optarg);
+            break;
+        case 'X':
+            if (optarg[0] != '\0')
+                results_junit = open_results(optarg);
+            break;
+        case 'p':
+            profile_path = optarg[0] != '\0' ? optarg : NULL;
+            break;
+        case 'c':
+            coverage_path = optarg[0] != '\0' ? optarg : NULL;
+            break;
+        case 'a':
+            changes_path = optarg[0] != '\0' ? optarg : NULL;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (argc - optind != 3 || (update_baselines && !baselines_path) || (changes_path && !coverage_path))
+        usage(argv[0]);
+    argv += optind - 1;
+
+    bool tty = isatty(STDOUT_FILENO);
+    if (!tty)
+    {
+        const char *v = getenv("MAKE_TERMOUT");
+        tty = v && v[0] == '\0';
+    }
+
+    if (tty)
+    {
+        char *stdout_buffer = malloc(64 * 1024);
+        if (!stdout_buffer)
+        {
+            perror("malloc stdout_buffer failed");
+            exit(2);
+        }
+        setvbuf(stdout, stdout_buffer, _IOFBF, 64 * 1024);
+    }
+    else
+    {
+        setvbuf(stdout, NULL, _IONBF, 0);
+    }
+
+    int elffd;
+    if ((elffd = open(argv[3], O_RDONLY)) == -1)
+    {
+        perror("open elffd failed");
+        exit(2);
+    }
+
+    struct stat elfst;
+    if (fstat(elffd, &elfst) == -1)
+    {
+        perror("stat elffd failed");
+        exit(2);
+    }
+
+    if ((elf = mmap(NULL, elfst.st_size, PROT_READ, MAP_PRIVATE, elffd, 0)) == MAP_FAILED)
+    {
+        perror("mmap elffd failed");
+        exit(2);
+    }
+
+    elf_size = elfst.st_size;
+    mgba_rom_test_path = argv[1];
+    objcopy_path = argv[2];
+
+    if (build_queue())
+    {
+        if (changes_path)
+            select_affected_tests();
+    }
+    else if (changes_path)
+    {
+        fprintf(stdout, "Running all tests, because they can't be queued.\n");
+    }
+
+    nrunners = 1;
+    const char *makeflags = getenv("MAKEFLAGS");
+    if (makeflags)
+    {
+        int e;
+        regex_t preg;
+        regmatch_t pmatch[4];
+        if ((e = regcomp(&preg, "(^| )-j([0-9]*)($| )", REG_EXTENDED)) != 0)
+        {
+            char errbuf[256];
+            regerror(e, &preg, errbuf, sizeof(errbuf));
+            fprintf(stderr, "regcomp failed: '%s'\n", errbuf);
+            exit(2);
+        }
+        if (regexec(&preg, makeflags, ARRAY_COUNT(pmatch), pmatch, 0) != REG_NOMATCH)
+        {
+            if (pmatch[2].rm_so == pmatch[2].rm_eo)
+                nrunners = sysconf(_SC_NPROCESSORS_ONLN);
+            else
+                sscanf(makeflags + pmatch[2].rm_so, "%d", &nrunners);
+        }
+        regfree(&preg);
+    }
+    // test_runner.c can only split the tests between so many runners
+    // itself, but there is no limit on how many can take from the queue.
+    if (!queue && nrunners > MAX_PROCESSES)
+        nrunners = MAX_PROCESSES;
+    if (queue && nrunners > queue_n)
+        nrunners = queue_n > 0 ? queue_n : 1;
+    if (timings_path)
+        load_records(&timings, timings_path);
+    if (baselines_path)
+        load_records(&baselines, baselines_path);
+    if (queue)
+    {
+        build_chunks();
+        start_offset = rom_offset("gTestRunnerStart");
+        end_offset = rom_offset("gTestRunnerEnd");
+    }
+    runners_digits = ceil(log10(nrunners));
+    runners = calloc(nrunners, sizeof(*runners));
+    if (!runners)
+    {
+        perror("calloc runners failed");
+        exit(2);
+    }
+    for (unsigned i = 0; i < nrunners; i++)
+    {
+        runners[i].input_buffer_capacity = 4096;
+        runners[i].input_buffer = malloc(runners[i].input_buffer_capacity);
+        runners[i].output_buffer_capacity = 4096;
+        runners[i].output_buffer = malloc(runners[i].output_buffer_capacity);
+        strcpy(runners[i].test_name, "WAITING...");
+    }
+    if (results_junit)
+    {
+        fputs(junit_header, results_junit);
+        results_junit_end = ftell(results_junit);
+        fputs(junit_footer, results_junit);
+        fflush(results_junit);
+    }
+    atexit(unlink_roms);
+    signal(SIGINT, exit2);
+    signal(SIGTERM, exit2);
+
+    // Start test runners.
+    int exit_code = 0;
+    int openfds = 0;
+    if (queue)
+    {
+        for (unsigned i = 0; i < nrunners; i++)
+        {
+            uint32_t start, end;
+            if (next_chunk(&start, &end))
             {
-                perror("execl stdbuf mgba-rom-test failed");
-                _exit(2);
+                start_runner(i, start, end);
+                openfds++;
             }
-        } else {
-            runners[i].pid = pid;
-            sprintf(runners[i].rom_path, "/tmp/mgba-rom-test-hydra-%05d", runners[i].pid);
-            runners[i].outfd = pipefds[0];
-            if (close(pipefds[1]) == -1)
+            else
             {
-                perror("close pipefds[1] failed");
-                exit(2);
+                runners[i].outfd = -1;
             }
         }
     }
+    else
+    {
+        for (unsigned i = 0; i < nrunners; i++)
+            start_runner(i, 0, 0);
+        openfds = nrunners;
+    }
+
+    if (tty)
+    {
+        draw_status();
+        fflush(stdout);
+    }
 
     // Process test runner output.
-    int openfds = nrunners;
     struct pollfd *pollfds = calloc(nrunners, sizeof(*pollfds));
     if (!pollfds)
     {
         perror("calloc pollfds failed");
         exit(2);
     }
-    for (int i = 0; i < nrunners; i++)
+    for (unsigned i = 0; i < nrunners; i++)
     {
         pollfds[i].fd = runners[i].outfd;
         pollfds[i].events = POLLIN;
     }
     while (openfds > 0)
     {
-        if (tty)
+        if (tty && status_lines > 0)
         {
-            struct winsize winsize;
-            if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &winsize) == -1)
-            {
-                perror("ioctl TIOCGWINSZ failed");
-                exit(2);
-            }
-            int scrollback = 0;
-            for (int i = 0; i < nrunners; i++)
-            {
-                if (runners[i].outfd >= 0)
-                    scrollback += (3 + runners_digits + strlen(runners[i].test_name) + winsize.ws_col - 1) / winsize.ws_col;
-            }
-            if (scrollback > 0)
-                fprintf(stdout, "\e[%dF\e[J", scrollback);
+            fprintf(stdout, "\e[%dF\e[J", status_lines);
+            status_lines = 0;
         }
 
         if (poll(pollfds, nrunners, -1) == -1)
@@ -696,7 +2150,7 @@ int main(int argc, char *argv[])
             perror("poll failed");
             exit(2);
         }
-        for (int i = 0; i < nrunners; i++)
+        for (unsigned i = 0; i < nrunners; i++)
         {
             if (pollfds[i].revents & POLLIN)
             {
@@ -717,86 +2171,51 @@ int main(int argc, char *argv[])
                     perror("close pollfds[i] failed");
                     exit(2);
                 }
-                runners[i].outfd = pollfds[i].fd = -pollfds[i].fd;
-                openfds--;
+                int runner_exit_code = reap_runner(&runners[i]);
+                if (runner_exit_code > exit_code)
+                    exit_code = runner_exit_code;
+
+                uint32_t start, end;
+                if (queue && next_chunk(&start, &end))
+                {
+                    start_runner(i, start, end);
+                    pollfds[i].fd = runners[i].outfd;
+                }
+                else
+                {
+                    runners[i].outfd = pollfds[i].fd = -1;
+                    openfds--;
+                }
             }
         }
 
         if (tty)
         {
-            for (int i = 0; i < nrunners; i++)
-            {
-                if (runners[i].outfd >= 0)
-                    fprintf(stdout, "[%0*d] %s\n", runners_digits, i, runners[i].test_name);
-            }
-
+            draw_status();
             fflush(stdout);
         }
     }
 
-    // Reap test runners and collate exit codes.
-    int exit_code = 0;
+    if (timings_path)
+        save_records(&timings, timings_path);
+    if (coverage_path)
+        save_coverage();
+
+    // Collate results.
     int passes = 0;
     int knownFails = 0;
-    int knownFailsPassing = 0;
     int todos = 0;
-    int assumptionFails = 0;
-    int fails = 0;
     int results = 0;
-
-    char failed_TestNames[MAX_SUMMARY_TESTS_TO_LIST * MAX_PROCESSES][MAX_TEST_LIST_BUFFER_LENGTH];
-    char failed_TestFilenameLine[MAX_SUMMARY_TESTS_TO_LIST * MAX_PROCESSES][MAX_TEST_LIST_BUFFER_LENGTH];
-
-    char knownFailingPassed_TestNames[MAX_SUMMARY_TESTS_TO_LIST * MAX_PROCESSES][MAX_TEST_LIST_BUFFER_LENGTH];
-    char knownFailingPassed_FilenameLine[MAX_SUMMARY_TESTS_TO_LIST * MAX_PROCESSES][MAX_TEST_LIST_BUFFER_LENGTH];
-
-    char assumeFailed_TestNames[MAX_SUMMARY_TESTS_TO_LIST * MAX_PROCESSES][MAX_TEST_LIST_BUFFER_LENGTH];
-    char assumeFailed_FilenameLine[MAX_SUMMARY_TESTS_TO_LIST * MAX_PROCESSES][MAX_TEST_LIST_BUFFER_LENGTH];
-
-    for (int i = 0; i < nrunners; i++)
+    for (unsigned i = 0; i < nrunners; i++)
     {
-        int wstatus;
-        if (waitpid(runners[i].pid, &wstatus, 0) == -1)
-        {
-            perror("waitpid runners[i] failed");
-            exit(2);
-        }
-        if (runners[i].output_buffer_size > 0)
-            fwrite(runners[i].output_buffer, 1, runners[i].output_buffer_size, stdout);
-        if (WIFEXITED(wstatus) && WEXITSTATUS(wstatus) > exit_code)
-            exit_code = WEXITSTATUS(wstatus);
         passes += runners[i].passes;
         knownFails += runners[i].knownFails;
-        for (int j = 0; j < runners[i].knownFailsPassing; j++)
-        {
-            if (j < MAX_SUMMARY_TESTS_TO_LIST)
-            {
-                strcpy(knownFailingPassed_TestNames[knownFailsPassing], runners[i].knownFailingPassed_TestNames[j]);
-                strcpy(knownFailingPassed_FilenameLine[knownFailsPassing], runners[i].knownFailingPassed_FilenameLine[j]);
-            }
-            knownFailsPassing++;
-        }
         todos += runners[i].todos;
-        for (int j = 0; j < runners[i].assumptionFails; j++)
-        {
-            if (j < MAX_SUMMARY_TESTS_TO_LIST)
-            {
-                strcpy(assumeFailed_TestNames[assumptionFails], runners[i].assumeFailed_TestNames[j]);
-                strcpy(assumeFailed_FilenameLine[assumptionFails], runners[i].assumeFailed_FilenameLine[j]);
-            }
-            assumptionFails++;
-        }
-        for (int j = 0; j < runners[i].fails; j++)
-        {
-            if (j < MAX_SUMMARY_TESTS_TO_LIST)
-            {
-                strcpy(failed_TestNames[fails], runners[i].failed_TestNames[j]);
-                strcpy(failed_TestFilenameLine[fails], runners[i].failed_TestFilenameLine[j]);
-            }
-            fails++;
-        }
         results += runners[i].results;
     }
+    int fails = failed.n;
+    int assumptionFails = assume_failed.n;
+    int knownFailsPassing = known_failing_passed.n;
 
     if (results == 0)
     {
@@ -815,8 +2234,8 @@ int main(int argc, char *argv[])
                     break;
                 }
                 fprintf(stdout, "  - \e[31m");
-                fprint_buffer(stdout, failed_TestFilenameLine[i], strlen(failed_TestFilenameLine[i]));
-                fprintf(stdout, "\e[0m - %s.\n", failed_TestNames[i]);
+                fprint_buffer(stdout, failed.filename_lines[i], strlen(failed.filename_lines[i]));
+                fprintf(stdout, "\e[0m - %s.\n", failed.names[i]);
             }
         }
 
@@ -831,8 +2250,8 @@ int main(int argc, char *argv[])
                     break;
                 }
                 fprintf(stdout, "  - \e[33m");
-                fprint_buffer(stdout, assumeFailed_FilenameLine[i], strlen(assumeFailed_FilenameLine[i]));
-                fprintf(stdout, "\e[0m - %s.\n", assumeFailed_TestNames[i]);
+                fprint_buffer(stdout, assume_failed.filename_lines[i], strlen(assume_failed.filename_lines[i]));
+                fprintf(stdout, "\e[0m - %s.\n", assume_failed.names[i]);
             }
         }
 
@@ -847,8 +2266,8 @@ int main(int argc, char *argv[])
                     break;
                 }
                 fprintf(stdout, "  - \e[32m");
-                fprint_buffer(stdout, knownFailingPassed_FilenameLine[i], strlen(knownFailingPassed_FilenameLine[i]));
-                fprintf(stdout, "\e[0m - %s.\n", knownFailingPassed_TestNames[i]);
+                fprint_buffer(stdout, known_failing_passed.filename_lines[i], strlen(known_failing_passed.filename_lines[i]));
+                fprintf(stdout, "\e[0m - %s.\n", known_failing_passed.names[i]);
             }
         }
 
@@ -866,6 +2285,10 @@ int main(int argc, char *argv[])
         fprintf(stdout, "- Tests \e[32mPASSED\e[0m:          %d\n", passes);
         fprintf(stdout, "- Tests \e[34mTOTAL\e[0m:           %d\n", results);
     }
+    if (baselines_path && report_benchmarks() > 0 && exit_code == 0)
+        exit_code = 1;
+    if (profile_path)
+        report_profile();
     fprintf(stdout, "\n");
 
     fflush(stdout);
@@ -25,6 +25,7 @@
 #include "asm_file.h"
 #include "c_file.h"
 #include "charmap.h"
+#include "server.h"
 
 #ifdef _WIN32
 #include <io.h>
@@ -145,9 +146,37 @@ const char* GetFileExtension(const char* filename)
     return extension;
 }
 
+void PreprocFile(const char *source, bool isStdin, bool doEnum)
+{
+    const char* extension = GetFileExtension(source);
+
+    if (!extension)
+        FATAL_ERROR("\"%s\" has no file extension.\n", source);
+
+    if ((extension[0] == 's') && extension[1] == 0)
+    {
+        PreprocAsmFile(source, isStdin, doEnum);
+    }
+    else if ((extension[0] == 'c' || extension[0] == 'i') && extension[1] == 0)
+    {
+        if (doEnum)
+            FATAL_ERROR("-e is invalid for C sources\n");
+        PreprocCFile(source, isStdin);
+    }
+    else
+    {
+        FATAL_ERROR("\"%s\" has an unknown file extension of \"%s\".\n", source, extension);
+    }
+}
+
 static void UsageAndExit(const char *program)
 {
-    std::fprintf(stderr, "Usage: %s [-i] [-e] SRC_FILE CHARMAP_FILE\nwhere -i denotes if input is from stdin\n      -e enables enum handling\n", program);
+    std::fprintf(stderr, "Usage: %s [-i] [-e] [-s SOCKET] SRC_FILE CHARMAP_FILE\n"
+                         "       %s -S SOCKET CHARMAP_FILE\n"
+                         "where -i denotes if input is from stdin\n"
+                         "      -e enables enum handling\n"
+                         "      -s hands the file to a server listening on SOCKET, if there is one\n"
+                         "      -S starts a server on SOCKET that keeps CHARMAP_FILE loaded\n", program, program);
     std::exit(EXIT_FAILURE);
 }
 
@@ -156,11 +185,14 @@ int main(int argc, char **argv)
     int opt;
     const char *source = NULL;
     const char *charmap = NULL;
+    const char *clientSocket = NULL;
+    const char *serverSocket = NULL;
     bool isStdin = false;
     bool doEnum = false;
 
-    /* preproc [-i] [-e] SRC_FILE CHARMAP_FILE */
-    while ((opt = getopt(argc, argv, "ie")) != -1)
+    /* preproc [-i] [-e] [-s SOCKET] SRC_FILE CHARMAP_FILE */
+    /* preproc -S SOCKET CHARMAP_FILE */
+    while ((opt = getopt(argc, argv, "ies:S:")) != -1)
     {
         switch (opt)
         {
@@ -170,18 +202,37 @@ int main(int argc, char **argv)
         case 'e':
             doEnum = true;
             break;
+        case 's':
+            clientSocket = optarg;
+            break;
+        case 'S':
+            serverSocket = optarg;
+            break;
         default:
             UsageAndExit(argv[0]);
             break;
         }
     }
 
+    if (serverSocket)
+    {
+        if (optind + 1 != argc || isStdin || doEnum || clientSocket)
+            UsageAndExit(argv[0]);
+
+        RunServer(serverSocket, argv[optind]);
+        return 0;
+    }
+
     if (optind + 2 != argc)
         UsageAndExit(argv[0]);
 
     source = argv[optind + 0];
     charmap = argv[optind + 1];
 
+    int exitCode;
+    if (clientSocket && RunClient(clientSocket, source, charmap, isStdin, doEnum, &exitCode))
+        return exitCode;
+
     g_charmap = new Charmap(charmap);
 
 #ifdef _WIN32
@@ -189,25 +240,7 @@ int main(int argc, char **argv)
 	_setmode(_fileno(stdout), _O_BINARY);
 #endif
 
-    const char* extension = GetFileExtension(source);
-
-    if (!extension)
-        FATAL_ERROR("\"%s\" has no file extension.\n", argv[1]);
-
-    if ((extension[0] == 's') && extension[1] == 0)
-    {
-        PreprocAsmFile(source, isStdin, doEnum);
-    }
-    else if ((extension[0] == 'c' || extension[0] == 'i') && extension[1] == 0)
-    {
-        if (doEnum)
-            FATAL_ERROR("-e is invalid for C sources\n");
-        PreprocCFile(source, isStdin);
-    }
-    else
-    {
-        FATAL_ERROR("\"%s\" has an unknown file extension of \"%s\".\n", argv[1], extension);
-    }
+    PreprocFile(source, isStdin, doEnum);
 
     return 0;
 }
@@ -51,4 +51,6 @@ const unsigned long kMaxCharmapSequenceLength = 16;
 
 extern Charmap* g_charmap;
 
+void PreprocFile(const char *source, bool isStdin, bool doEnum);
+
 #endif // PREPROC_H
@@ -0,0 +1,482 @@
+#include "preproc.h"
+#include "server.h"
+
+#ifdef _WIN32
+
+void RunServer(const char *, const char *)
+{
+    FATAL_ERROR("Server mode is not supported on Windows.\n");
+}
+
+bool RunClient(const char *, const char *, const char *, bool, bool, int *)
+{
+    return false;
+}
+
+#else
+
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Request layout, following a 4-byte little-endian payload length:
+//   magic \0 flags \0 cwd \0 source \0 charmap \0
+// The client's stdin, stdout and stderr travel as SCM_RIGHTS with the length.
+// The reply is a single 4-byte exit status.
+static const char kMagic[] = "preproc1";
+static const int kNumPassedFds = 3;
+static const std::uint32_t kMaxRequestSize = 4 * PATH_MAX + 64;
+static const std::int32_t kStatusRejected = -1;
+
+static const char *s_socketPath;
+
+struct Request
+{
+    bool isStdin;
+    bool doEnum;
+    std::string cwd;
+    std::string source;
+    std::string charmap;
+};
+
+static bool MakeSocketAddress(const char *socketPath, struct sockaddr_un *addr)
+{
+    std::memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+
+    if (std::strlen(socketPath) >= sizeof(addr->sun_path))
+        return false;
+
+    std::strcpy(addr->sun_path, socketPath);
+    return true;
+}
+
+static bool WriteAll(int fd, const void *data, std::size_t size)
+{
+    const char *p = (const char *)data;
+
+    while (size > 0)
+    {
+        ssize_t count = write(fd, p, size);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+
+        p += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+static bool ReadAll(int fd, void *data, std::size_t size)
+{
+    char *p = (char *)data;
+
+    while (size > 0)
+    {
+        ssize_t count = read(fd, p, size);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+
+        p += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+static std::uint32_t DecodeU32(const unsigned char *bytes)
+{
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((std::uint32_t)bytes[3] << 24);
+}
+
+static void EncodeU32(std::uint32_t value, unsigned char *bytes)
+{
+    bytes[0] = value & 0xFF;
+    bytes[1] = (value >> 8) & 0xFF;
+    bytes[2] = (value >> 16) & 0xFF;
+    bytes[3] = (value >> 24) & 0xFF;
+}
+
+static std::string RealPath(const char *path)
+{
+    char resolved[PATH_MAX];
+
+    if (realpath(path, resolved) == NULL)
+        return std::string();
+
+    return std::string(resolved);
+}
+
+static bool SendRequest(int sock, const Request& request)
+{
+    std::string payload;
+    payload += kMagic;
+    payload += '\0';
+    if (request.isStdin)
+        payload += 'i';
+    if (request.doEnum)
+        payload += 'e';
+    payload += '\0';
+    payload += request.cwd;
+    payload += '\0';
+    payload += request.source;
+    payload += '\0';
+    payload += request.charmap;
+    payload += '\0';
+
+    if (payload.size() > kMaxRequestSize)
+        return false;
+
+    unsigned char length[4];
+    EncodeU32(payload.size(), length);
+
+    struct iovec iov;
+    iov.iov_base = length;
+    iov.iov_len = sizeof(length);
+
+    union
+    {
+        char buffer[CMSG_SPACE(kNumPassedFds * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    std::memset(&control, 0, sizeof(control));
+
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(kNumPassedFds * sizeof(int));
+    int fds[kNumPassedFds] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    ssize_t count;
+    do
+        count = sendmsg(sock, &msg, 0);
+    while (count < 0 && errno == EINTR);
+
+    if (count <= 0)
+        return false;
+
+    // Only the first byte has to carry the descriptors; finish the rest normally.
+    if (!WriteAll(sock, length + count, sizeof(length) - count))
+        return false;
+
+    return WriteAll(sock, payload.data(), payload.size());
+}
+
+static bool ReceiveRequest(int sock, Request *request, int fds[kNumPassedFds])
+{
+    unsigned char length[4];
+
+    struct iovec iov;
+    iov.iov_base = length;
+    iov.iov_len = sizeof(length);
+
+    union
+    {
+        char buffer[CMSG_SPACE(kNumPassedFds * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    ssize_t count;
+    do
+        count = recvmsg(sock, &msg, 0);
+    while (count < 0 && errno == EINTR);
+
+    if (count <= 0)
+        return false;
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+     || cmsg->cmsg_len != CMSG_LEN(kNumPassedFds * sizeof(int)))
+        return false;
+    std::memcpy(fds, CMSG_DATA(cmsg), kNumPassedFds * sizeof(int));
+
+    if (!ReadAll(sock, length + count, sizeof(length) - count))
+        return false;
+
+    std::uint32_t size = DecodeU32(length);
+    if (size > kMaxRequestSize)
+        return false;
+
+    std::vector<char> payload(size + 1);
+    if (!ReadAll(sock, payload.data(), size))
+        return false;
+    payload[size] = 0;
+
+    std::vector<std::string> fields;
+    std::size_t start = 0;
+    for (std::size_t i = 0; i < size; i++)
+    {
+        if (payload[i] == 0)
+        {
+            fields.push_back(std::string(&payload[start], i - start));
+            start = i + 1;
+        }
+    }
+
+    if (fields.size() != 5 || fields[0] != kMagic)
+        return false;
+
+    request->isStdin = fields[1].find('i') != std::string::npos;
+    request->doEnum = fields[1].find('e') != std::string::npos;
+    request->cwd = fields[2];
+    request->source = fields[3];
+    request->charmap = fields[4];
+    return true;
+}
+
+static void SendStatus(int sock, std::int32_t status)
+{
+    unsigned char bytes[4];
+    EncodeU32((std::uint32_t)status, bytes);
+    WriteAll(sock, bytes, sizeof(bytes));
+}
+
+// Runs in a child of the server for each connection, so that the worker's
+// FATAL_ERROR exits can be caught and reported back to the client.
+static void HandleConnection(int sock, const std::string& charmapRealPath)
+{
+    Request request;
+    int fds[kNumPassedFds];
+
+    if (!ReceiveRequest(sock, &request, fds))
+        _exit(1);
+
+    if (chdir(request.cwd.c_str()) != 0
+     || RealPath(request.charmap.c_str()) != charmapRealPath)
+    {
+        SendStatus(sock, kStatusRejected);
+        _exit(0);
+    }
+
+    pid_t pid = fork();
+
+    if (pid < 0)
+    {
+        SendStatus(sock, kStatusRejected);
+        _exit(0);
+    }
+
+    if (pid == 0)
+    {
+        close(sock);
+
+        for (int i = 0; i < kNumPassedFds; i++)
+        {
+            if (dup2(fds[i], i) < 0)
+                _exit(1);
+            close(fds[i]);
+        }
+
+        PreprocFile(request.source.c_str(), request.isStdin, request.doEnum);
+        std::exit(0);
+    }
+
+    for (int i = 0; i < kNumPassedFds; i++)
+        close(fds[i]);
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+            _exit(1);
+    }
+
+    if (WIFEXITED(status))
+        SendStatus(sock, WEXITSTATUS(status));
+    else
+        SendStatus(sock, 128 + WTERMSIG(status));
+
+    _exit(0);
+}
+
+static void HandleTerminationSignal(int sig)
+{
+    unlink(s_socketPath);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+static bool IsSocketInUse(const struct sockaddr_un& addr)
+{
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (sock < 0)
+        return false;
+
+    bool inUse = connect(sock, (const struct sockaddr *)&addr, sizeof(addr)) == 0;
+    close(sock);
+    return inUse;
+}
+
+void RunServer(const char *socketPath, const char *charmapPath)
+{
+    struct sockaddr_un addr;
+
+    if (!MakeSocketAddress(socketPath, &addr))
+        FATAL_ERROR("Socket path \"%s\" is too long.\n", socketPath);
+
+    std::string charmapRealPath = RealPath(charmapPath);
+
+    if (charmapRealPath.empty())
+        FATAL_ERROR("Failed to open \"%s\" for reading.\n", charmapPath);
+
+    struct stat charmapStat;
+    if (stat(charmapRealPath.c_str(), &charmapStat) != 0)
+        FATAL_ERROR("Failed to stat \"%s\".\n", charmapPath);
+
+    g_charmap = new Charmap(charmapRealPath);
+
+    if (IsSocketInUse(addr))
+        FATAL_ERROR("A server is already listening on \"%s\".\n", socketPath);
+
+    // Anything left at the path is stale from a server that didn't shut down cleanly.
+    unlink(socketPath);
+
+    int listenSock = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (listenSock < 0)
+        FATAL_ERROR("Failed to create socket. (error: %s)\n", std::strerror(errno));
+
+    if (bind(listenSock, (const struct sockaddr *)&addr, sizeof(addr)) != 0)
+        FATAL_ERROR("Failed to bind \"%s\". (error: %s)\n", socketPath, std::strerror(errno));
+
+    if (listen(listenSock, SOMAXCONN) != 0)
+        FATAL_ERROR("Failed to listen on \"%s\". (error: %s)\n", socketPath, std::strerror(errno));
+
+    s_socketPath = socketPath;
+    signal(SIGINT, HandleTerminationSignal);
+    signal(SIGTERM, HandleTerminationSignal);
+    signal(SIGHUP, HandleTerminationSignal);
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGCHLD, SIG_IGN);
+
+    std::fprintf(stderr, "preproc: serving \"%s\" on \"%s\"\n", charmapPath, socketPath);
+
+    for (;;)
+    {
+        int sock = accept(listenSock, NULL, NULL);
+
+        if (sock < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            FATAL_ERROR("Failed to accept connection. (error: %s)\n", std::strerror(errno));
+        }
+
+        // Pick up edits to the charmap without needing a restart.
+        struct stat currentStat;
+        if (stat(charmapRealPath.c_str(), &currentStat) == 0
+         && (currentStat.st_mtime != charmapStat.st_mtime || currentStat.st_size != charmapStat.st_size))
+        {
+            delete g_charmap;
+            g_charmap = new Charmap(charmapRealPath);
+            charmapStat = currentStat;
+        }
+
+        std::fflush(stdout);
+        pid_t pid = fork();
+
+        if (pid == 0)
+        {
+            close(listenSock);
+            signal(SIGINT, SIG_DFL);
+            signal(SIGTERM, SIG_DFL);
+            signal(SIGHUP, SIG_DFL);
+            signal(SIGPIPE, SIG_DFL);
+            signal(SIGCHLD, SIG_DFL);
+            HandleConnection(sock, charmapRealPath);
+        }
+
+        if (pid < 0)
+            std::fprintf(stderr, "preproc: failed to fork. (error: %s)\n", std::strerror(errno));
+
+        close(sock);
+    }
+}
+
+bool RunClient(const char *socketPath, const char *source, const char *charmapPath, bool isStdin, bool doEnum, int *exitCode)
+{
+    struct sockaddr_un addr;
+
+    if (!MakeSocketAddress(socketPath, &addr))
+        return false;
+
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == NULL)
+        return false;
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (sock < 0)
+        return false;
+
+    if (connect(sock, (const struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(sock);
+        return false;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    Request request;
+    request.isStdin = isStdin;
+    request.doEnum = doEnum;
+    request.cwd = cwd;
+    request.source = source;
+    request.charmap = charmapPath;
+
+    if (!SendRequest(sock, request))
+    {
+        close(sock);
+        return false;
+    }
+
+    unsigned char bytes[4];
+
+    if (!ReadAll(sock, bytes, sizeof(bytes)))
+        FATAL_ERROR("preproc server on \"%s\" exited while processing \"%s\".\n", socketPath, source);
+
+    close(sock);
+
+    std::int32_t status = (std::int32_t)DecodeU32(bytes);
+
+    if (status == kStatusRejected)
+        return false;
+
+    *exitCode = status;
+    return true;
+}
+
+#endif // _WIN32
@@ -0,0 +1,17 @@
+#ifndef SERVER_H_
+#define SERVER_H_
+
+// Runs preproc as a long-lived server listening on a Unix socket.
+// The charmap is parsed once up front (and reparsed if the file changes);
+// each request is then handled in a forked worker that inherits it.
+void RunServer(const char *socketPath, const char *charmapPath);
+
+// Hands a single request off to a server started with RunServer.
+// The client's stdin, stdout and stderr are passed across the socket,
+// so the worker reads and writes them directly.
+// Returns false without touching any stream if no compatible server is
+// available, in which case the caller should process the file itself.
+// Otherwise, *exitCode is set to the worker's exit status.
+bool RunClient(const char *socketPath, const char *source, const char *charmapPath, bool isStdin, bool doEnum, int *exitCode);
+
+#endif // SERVER_H_
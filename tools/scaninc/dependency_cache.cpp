@@ -0,0 +1,207 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include "scaninc.h"
+#include "dependency_cache.h"
+
+// Cache file format, one record per line with tab-separated fields:
+//   scaninc-cache <version>
+//   F <mtime> <size> <hash> <recorded> <path>
+//   B <incbin path>     (belongs to the preceding F record)
+//   I <include path>    (belongs to the preceding F record)
+static const char *const CACHE_HEADER = "scaninc-cache\t1";
+
+static bool HashFile(const std::string& path, std::uint64_t& hash)
+{
+    FILE *fp = std::fopen(path.c_str(), "rb");
+
+    if (fp == NULL)
+        return false;
+
+    // 64-bit FNV-1a
+    hash = 0xCBF29CE484222325ULL;
+
+    unsigned char buffer[16384];
+    std::size_t count;
+
+    while ((count = std::fread(buffer, 1, sizeof(buffer), fp)) != 0)
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            hash ^= buffer[i];
+            hash *= 0x100000001B3ULL;
+        }
+    }
+
+    std::fclose(fp);
+    return true;
+}
+
+DependencyCache::DependencyCache(std::string path)
+    : m_path(path), m_dirty(false), m_now(std::time(nullptr))
+{
+    Load();
+}
+
+void DependencyCache::Load()
+{
+    std::ifstream input(m_path);
+
+    if (!input.is_open())
+        return;
+
+    std::string line;
+
+    if (!std::getline(input, line) || line != CACHE_HEADER)
+        return;
+
+    Entry *current = nullptr;
+
+    while (std::getline(input, line))
+    {
+        if (line.size() < 2 || line[1] != '\t')
+            break;
+
+        if (line[0] == 'F')
+        {
+            std::istringstream fields(line.substr(2));
+            Entry entry;
+            std::string path;
+
+            if (!(fields >> entry.stamp.mtime >> entry.stamp.size >> entry.stamp.hash >> entry.recorded))
+                break;
+
+            fields.get();
+            std::getline(fields, path);
+
+            if (path.empty())
+                break;
+
+            current = &(m_entries[path] = entry);
+        }
+        else if (line[0] == 'B' && current)
+        {
+            current->directives.incbins.insert(line.substr(2));
+        }
+        else if (line[0] == 'I' && current)
+        {
+            current->directives.includes.insert(line.substr(2));
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+bool DependencyCache::Lookup(const std::string& path, ScannedDirectives& directives, FileStamp& stamp)
+{
+    struct stat st;
+
+    stamp.size = -1;
+
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+
+    stamp.mtime = st.st_mtime;
+    stamp.size = st.st_size;
+    stamp.hash = 0;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto it = m_entries.find(path);
+
+    if (it != m_entries.end() && it->second.stamp.size == stamp.size)
+    {
+        Entry& entry = it->second;
+
+        // A file modified in the same second the entry was recorded could
+        // still have a matching mtime, so only trust strictly older ones.
+        if (entry.stamp.mtime == stamp.mtime && entry.stamp.mtime < entry.recorded)
+        {
+            directives = entry.directives;
+            return true;
+        }
+
+        lock.unlock();
+        bool hashed = HashFile(path, stamp.hash);
+        lock.lock();
+
+        if (hashed && entry.stamp.hash == stamp.hash)
+        {
+            entry.stamp.mtime = stamp.mtime;
+            entry.recorded = m_now;
+            m_dirty = true;
+            directives = entry.directives;
+            return true;
+        }
+
+        return false;
+    }
+
+    lock.unlock();
+
+    if (!HashFile(path, stamp.hash))
+        stamp.size = -1;
+
+    return false;
+}
+
+void DependencyCache::Store(const std::string& path, const FileStamp& stamp, const ScannedDirectives& directives)
+{
+    if (stamp.size < 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Entry& entry = m_entries[path];
+    entry.stamp = stamp;
+    entry.recorded = m_now;
+    entry.directives = directives;
+    m_dirty = true;
+}
+
+void DependencyCache::Save()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_dirty)
+        return;
+
+    // Write to a temporary file first so an interrupted run can't leave a truncated cache behind.
+    std::string tempPath = m_path + ".tmp";
+    std::ofstream output(tempPath);
+
+    if (!output.is_open())
+        FATAL_ERROR("Failed to open \"%s\" for writing.\n", tempPath.c_str());
+
+    output << CACHE_HEADER << '\n';
+
+    for (const auto& it : m_entries)
+    {
+        const Entry& entry = it.second;
+
+        output << "F\t" << entry.stamp.mtime << '\t' << entry.stamp.size << '\t' << entry.stamp.hash
+               << '\t' << entry.recorded << '\t' << it.first << '\n';
+
+        for (const std::string& incbin : entry.directives.incbins)
+            output << "B\t" << incbin << '\n';
+
+        for (const std::string& include : entry.directives.includes)
+            output << "I\t" << include << '\n';
+    }
+
+    output.close();
+
+    if (output.fail())
+        FATAL_ERROR("Failed to write \"%s\".\n", tempPath.c_str());
+
+    std::remove(m_path.c_str());
+
+    if (std::rename(tempPath.c_str(), m_path.c_str()) != 0)
+        FATAL_ERROR("Failed to rename \"%s\" to \"%s\".\n", tempPath.c_str(), m_path.c_str());
+
+    m_dirty = false;
+}
@@ -0,0 +1,56 @@
+#ifndef DEPENDENCY_CACHE_H
+#define DEPENDENCY_CACHE_H
+
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+// The includes and incbins found in a single file.
+struct ScannedDirectives
+{
+    std::set<std::string> incbins;
+    std::set<std::string> includes;
+};
+
+// Identifies one version of a file's contents.
+struct FileStamp
+{
+    std::int64_t mtime;
+    std::int64_t size;
+    std::uint64_t hash;
+};
+
+// Persists ScannedDirectives between runs, keyed by path.
+// An entry is trusted if the file's mtime and size are unchanged and the
+// mtime is older than the time the entry was recorded; otherwise the file
+// is hashed and the entry is reused only if the contents are identical.
+class DependencyCache
+{
+public:
+    DependencyCache(std::string path);
+    // On a miss, stamp is filled in so it can be passed to Store once the file has been scanned.
+    bool Lookup(const std::string& path, ScannedDirectives& directives, FileStamp& stamp);
+    void Store(const std::string& path, const FileStamp& stamp, const ScannedDirectives& directives);
+    void Save();
+
+private:
+    struct Entry
+    {
+        FileStamp stamp;
+        std::int64_t recorded;
+        ScannedDirectives directives;
+    };
+
+    std::string m_path;
+    std::map<std::string, Entry> m_entries;
+    std::mutex m_mutex;
+    bool m_dirty;
+    std::int64_t m_now;
+
+    void Load();
+};
+
+#endif // DEPENDENCY_CACHE_H
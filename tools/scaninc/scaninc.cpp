@@ -20,15 +20,22 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <atomic>
+#include <future>
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <set>
 #include <string>
 #include <iostream>
+#include <thread>
 #include <tuple>
 #include <fstream>
 #include "scaninc.h"
 #include "source_file.h"
+#include "dependency_cache.h"
 
 bool CanOpenFile(std::string path)
 {
@@ -41,91 +48,132 @@ bool CanOpenFile(std::string path)
     return true;
 }
 
-const char *const USAGE = "Usage: scaninc [-I INCLUDE_PATH] [-M DEPENDENCY_OUT_PATH] FILE_PATH\n";
+const char *const USAGE = "Usage: scaninc [-I INCLUDE_PATH] [-C CACHE_PATH] [-M DEPENDENCY_OUT_PATH] FILE_PATH\n"
+                          "       scaninc [-I INCLUDE_PATH] [-C CACHE_PATH] [-j JOBS] -B LIST_PATH\n"
+                          "where LIST_PATH (or - for stdin) holds whitespace-separated pairs of\n"
+                          "DEPENDENCY_OUT_PATH FILE_PATH, each handled as if passed to -M\n";
 
-int main(int argc, char **argv)
+struct ScannedFile
 {
-    std::queue<std::string> filesToProcess;
-    std::set<std::string> dependencies;
-    std::set<std::string> dependencies_includes;
+    SourceFileType type;
+    std::string srcDir;
+    ScannedDirectives directives;
+};
 
-    std::vector<std::string> includeDirs;
+// Scans source files and resolves their includes.
+// Every file is scanned at most once per Scanner, even when the same header
+// is reached from several threads at once; the rest wait for the first scan.
+class Scanner
+{
+public:
+    Scanner(const std::vector<std::string>& includeDirs, DependencyCache *cache)
+        : m_includeDirs(includeDirs), m_cache(cache) {}
 
-    bool makeformat = false;
-    std::string make_outfile;
+    void CollectDependencies(const std::string& initialPath, std::set<std::string>& dependencies, std::set<std::string>& dependencies_includes);
 
-    argc--;
-    argv++;
+private:
+    std::vector<std::string> m_includeDirs;
+    DependencyCache *m_cache;
+    std::mutex m_mutex;
+    std::map<std::string, std::shared_future<std::shared_ptr<const ScannedFile>>> m_files;
+    std::map<std::string, bool> m_canOpen;
 
-    while (argc > 1)
+    std::shared_ptr<const ScannedFile> GetFile(const std::string& path);
+    std::shared_ptr<const ScannedFile> ScanFile(std::string path);
+    bool CanOpen(const std::string& path);
+};
+
+std::shared_ptr<const ScannedFile> Scanner::ScanFile(std::string path)
+{
+    std::shared_ptr<ScannedFile> scanned = std::make_shared<ScannedFile>();
+    scanned->type = GetFileType(path);
+    scanned->srcDir = GetDir(path);
+
+    FileStamp stamp;
+    if (m_cache && m_cache->Lookup(path, scanned->directives, stamp))
+        return scanned;
+
+    SourceFile file(path);
+    scanned->directives.incbins = file.GetIncbins();
+    scanned->directives.includes = file.GetIncludes();
+
+    if (m_cache)
+        m_cache->Store(path, stamp, scanned->directives);
+
+    return scanned;
+}
+
+std::shared_ptr<const ScannedFile> Scanner::GetFile(const std::string& path)
+{
+    std::promise<std::shared_ptr<const ScannedFile>> promise;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto it = m_files.find(path);
+    if (it != m_files.end())
     {
-        std::string arg(argv[0]);
-        if (arg.substr(0, 2) == "-I")
-        {
-            std::string includeDir = arg.substr(2);
-            if (includeDir.empty())
-            {
-                argc--;
-                argv++;
-                includeDir = std::string(argv[0]);
-            }
-            if (!includeDir.empty() && includeDir.back() != '/')
-            {
-                includeDir += '/';
-            }
-            includeDirs.push_back(includeDir);
-        }
-        else if(arg.substr(0, 2) == "-M")
-        {
-            makeformat = true;
-            argc--;
-            argv++;
-            make_outfile = std::string(argv[0]);
-        }
-        else
-        {
-            FATAL_ERROR(USAGE);
-        }
-        argc--;
-        argv++;
+        std::shared_future<std::shared_ptr<const ScannedFile>> future = it->second;
+        lock.unlock();
+        return future.get();
     }
+    m_files[path] = promise.get_future().share();
+    lock.unlock();
 
-    if (argc != 1) {
-        FATAL_ERROR(USAGE);
+    std::shared_ptr<const ScannedFile> scanned = ScanFile(path);
+    promise.set_value(scanned);
+    return scanned;
+}
+
+bool Scanner::CanOpen(const std::string& path)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_canOpen.find(path);
+        if (it != m_canOpen.end())
+            return it->second;
     }
 
-    std::string initialPath(argv[0]);
+    bool canOpen = CanOpenFile(path);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_canOpen[path] = canOpen;
+    return canOpen;
+}
+
+void Scanner::CollectDependencies(const std::string& initialPath, std::set<std::string>& dependencies, std::set<std::string>& dependencies_includes)
+{
+    std::queue<std::string> filesToProcess;
+    std::vector<std::string> includeDirs = m_includeDirs;
 
     filesToProcess.push(initialPath);
 
     while (!filesToProcess.empty())
     {
         std::string filePath = filesToProcess.front();
-        SourceFile file(filePath);
+        std::shared_ptr<const ScannedFile> file = GetFile(filePath);
         filesToProcess.pop();
 
-        includeDirs.push_back(file.GetSrcDir());
-        for (auto incbin : file.GetIncbins())
+        includeDirs.push_back(file->srcDir);
+        for (auto incbin : file->directives.incbins)
         {
             dependencies.insert(incbin);
         }
-        for (auto include : file.GetIncludes())
+        for (auto include : file->directives.includes)
         {
             bool exists = false;
             std::string path("");
             for (auto includeDir : includeDirs)
             {
                 path = includeDir + include;
-                if (CanOpenFile(path))
+                if (CanOpen(path))
                 {
                     exists = true;
                     break;
                 }
             }
-            if (!exists && (file.FileType() == SourceFileType::Asm || file.FileType() == SourceFileType::Inc))
+            if (!exists && (file->type == SourceFileType::Asm || file->type == SourceFileType::Inc))
             {
                 path = include;
-                if (CanOpenFile(path))
+                if (CanOpen(path))
                     exists = true;
             }
             if (!exists)
@@ -140,47 +188,194 @@ int main(int argc, char **argv)
         }
         includeDirs.pop_back();
     }
+}
+
+void WriteMakeRules(const std::string& make_outfile, const std::set<std::string>& dependencies, const std::set<std::string>& dependencies_includes)
+{
+    // Write out make rules to a file
+    std::ofstream output(make_outfile);
 
-    if(!makeformat)
+    if (!output.is_open())
+        FATAL_ERROR("Failed to open \"%s\" for writing.\n", make_outfile.c_str());
+
+    // Print a make rule for the object file
+    size_t ext_pos = make_outfile.find_last_of(".");
+    auto object_file = make_outfile.substr(0, ext_pos + 1) + "o";
+    output << object_file.c_str() << ":";
+    for (const std::string &path : dependencies)
     {
-        for (const std::string &path : dependencies)
-        {
-            std::printf("%s\n", path.c_str());
-        }
-        std::cout << std::endl;
+        output << " " << path;
     }
-    else
+    output << '\n';
+
+    // Dependency list rule.
+    // Although these rules are identical, they need to be separate, else make will trigger the rule again after the file is created for the first time.
+    output << make_outfile.c_str() << ":";
+    for (const std::string &path : dependencies_includes)
+    {
+        output << " " << path;
+    }
+    output << '\n';
+
+    // Dummy rules
+    // If a dependency is deleted, make will try to make it, instead of rescanning the dependencies before trying to do that.
+    for (const std::string &path : dependencies)
+    {
+        output << path << ":\n";
+    }
+
+    output.flush();
+    output.close();
+}
+
+// Handles every (dependency file, source file) pair from the list on a pool of threads.
+void RunBatch(Scanner& scanner, const std::string& listPath, unsigned int numJobs)
+{
+    std::vector<std::pair<std::string, std::string>> jobs;
+    std::ifstream listFile;
+    std::istream *input = &std::cin;
+
+    if (listPath != "-")
     {
-        // Write out make rules to a file
-        std::ofstream output(make_outfile);
-
-        // Print a make rule for the object file
-        size_t ext_pos = make_outfile.find_last_of(".");
-        auto object_file = make_outfile.substr(0, ext_pos + 1) + "o";
-        output << object_file.c_str() << ":";
-        for (const std::string &path : dependencies)
+        listFile.open(listPath);
+        if (!listFile.is_open())
+            FATAL_ERROR("Failed to open \"%s\" for reading.\n", listPath.c_str());
+        input = &listFile;
+    }
+
+    std::string make_outfile, source;
+    while (*input >> make_outfile)
+    {
+        if (!(*input >> source))
+            FATAL_ERROR("No source file given for \"%s\" in \"%s\".\n", make_outfile.c_str(), listPath.c_str());
+        jobs.emplace_back(make_outfile, source);
+    }
+
+    if (numJobs > jobs.size())
+        numJobs = jobs.size();
+
+    std::atomic<std::size_t> nextJob(0);
+    auto worker = [&]()
+    {
+        std::size_t i;
+        while ((i = nextJob++) < jobs.size())
         {
-            output << " " << path;
+            std::set<std::string> dependencies;
+            std::set<std::string> dependencies_includes;
+            scanner.CollectDependencies(jobs[i].second, dependencies, dependencies_includes);
+            WriteMakeRules(jobs[i].first, dependencies, dependencies_includes);
         }
-        output << '\n';
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < numJobs; i++)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+int main(int argc, char **argv)
+{
+    std::set<std::string> dependencies;
+    std::set<std::string> dependencies_includes;
+
+    std::vector<std::string> includeDirs;
+
+    bool makeformat = false;
+    std::string make_outfile;
+    std::string cache_path;
+    std::string batch_list;
+    unsigned int numJobs = std::thread::hardware_concurrency();
+
+    argc--;
+    argv++;
 
-        // Dependency list rule.
-        // Although these rules are identical, they need to be separate, else make will trigger the rule again after the file is created for the first time.
-        output << make_outfile.c_str() << ":";
-        for (const std::string &path : dependencies_includes)
+    while (argc > 1)
+    {
+        std::string arg(argv[0]);
+        if (arg.substr(0, 2) == "-I")
         {
-            output << " " << path;
+            std::string includeDir = arg.substr(2);
+            if (includeDir.empty())
+            {
+                argc--;
+                argv++;
+                includeDir = std::string(argv[0]);
+            }
+            if (!includeDir.empty() && includeDir.back() != '/')
+            {
+                includeDir += '/';
+            }
+            includeDirs.push_back(includeDir);
         }
-        output << '\n';
-
-        // Dummy rules
-        // If a dependency is deleted, make will try to make it, instead of rescanning the dependencies before trying to do that.
-        for (const std::string &path : dependencies)
+        else if(arg.substr(0, 2) == "-M")
         {
-            output << path << ":\n";
+            makeformat = true;
+            argc--;
+            argv++;
+            make_outfile = std::string(argv[0]);
+        }
+        else if (arg == "-C")
+        {
+            argc--;
+            argv++;
+            cache_path = std::string(argv[0]);
+        }
+        else if (arg == "-B")
+        {
+            argc--;
+            argv++;
+            batch_list = std::string(argv[0]);
         }
+        else if (arg == "-j")
+        {
+            argc--;
+            argv++;
+            numJobs = std::atoi(argv[0]);
+        }
+        else
+        {
+            FATAL_ERROR(USAGE);
+        }
+        argc--;
+        argv++;
+    }
+
+    if (batch_list.empty() ? argc != 1 : (argc != 0 || makeformat))
+        FATAL_ERROR(USAGE);
+
+    if (numJobs == 0)
+        numJobs = 1;
+
+    std::unique_ptr<DependencyCache> cache;
+    if (!cache_path.empty())
+        cache.reset(new DependencyCache(cache_path));
 
-        output.flush();
-        output.close();
+    Scanner scanner(includeDirs, cache.get());
+
+    if (!batch_list.empty())
+    {
+        RunBatch(scanner, batch_list, numJobs);
     }
+    else
+    {
+        scanner.CollectDependencies(std::string(argv[0]), dependencies, dependencies_includes);
+
+        if(!makeformat)
+        {
+            for (const std::string &path : dependencies)
+            {
+                std::printf("%s\n", path.c_str());
+            }
+            std::cout << std::endl;
+        }
+        else
+        {
+            WriteMakeRules(make_outfile, dependencies, dependencies_includes);
+        }
+    }
+
+    if (cache)
+        cache->Save();
 }
@@ -8,17 +8,27 @@
  * 3. Format that member in 'fprint_trainers'. */
 #include <assert.h>
 #include <limits.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <pthread.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #define MAX_TRAINER_AI_FLAGS 64
 #define MAX_TRAINER_ITEMS 4
 #define PARTY_SIZE 255
 #define MAX_MON_MOVES 4
 #define MAX_MON_TAGS 32
+#define MAX_JOBS 64
+// Sources smaller than this per shard aren't worth splitting further.
+#define MIN_SHARD_SIZE 16384
 
 struct String
 {
@@ -261,6 +271,8 @@ struct Parser
     struct SourceLocation error_location;
     const char *error;
     bool fatal_error;
+    // If set, errors are only recorded here instead of being printed.
+    bool *quiet_error;
 };
 
 struct Parsed
@@ -610,6 +622,14 @@ static bool match_move_identifier(struct Parser *p, struct Token *t)
 
 static bool show_parse_error(struct Parser *p)
 {
+    if (p->quiet_error)
+    {
+        *p->quiet_error = true;
+        p->error = NULL;
+        p->fatal_error = true;
+        return false;
+    }
+
     // Print error message.
     int n = fprintf(stderr, "%s:%d: ", p->source->path, p->error_location.line);
     fprintf(stderr, "error: %s\n", p->error);
@@ -1150,7 +1170,10 @@ static const struct {
 static bool parse_trainer(struct Parser *p, const struct Parsed *parsed, struct Trainer *trainer)
 {
     bool any_error = false;
-    *trainer = (struct Trainer) {};
+    // 'pokemon' is large and mostly unused, so only clear the members
+    // around it here, and each Pokemon once it is known to exist.
+    memset(trainer, 0, offsetof(struct Trainer, pokemon));
+    memset(&trainer->pokemon_n, 0, sizeof(*trainer) - offsetof(struct Trainer, pokemon_n));
 
     while (match_empty_line(p)) {}
     struct Token id;
@@ -1350,6 +1373,7 @@ static bool parse_trainer(struct Parser *p, const struct Parsed *parsed, struct
             return false;
         }
         trainer->pokemon_n++;
+        *pokemon = (struct Pokemon) {};
 
         if (!is_empty_string(trainer->copy_pool))
         {
@@ -1563,19 +1587,23 @@ static bool parse_trainer(struct Parser *p, const struct Parsed *parsed, struct
     return !any_error;
 }
 
-static void parse(struct Parser *p, struct Parsed *parsed)
+static void parse_pragmas(struct Parser *p, struct Parsed *parsed)
 {
     parsed->source = p->source;
-    int trainers_c = 256;
-    parsed->trainers = malloc(sizeof(*parsed->trainers) * trainers_c);
-    parsed->trainers_n = 0;
-    assert(parsed->trainers);
     for (;;)
     {
         while (match_empty_line(p)) {}
         if (!parse_pragma(p, parsed))
             break;
     }
+}
+
+static void parse_trainers(struct Parser *p, struct Parsed *parsed)
+{
+    int trainers_c = 256;
+    parsed->trainers = malloc(sizeof(*parsed->trainers) * trainers_c);
+    parsed->trainers_n = 0;
+    assert(parsed->trainers);
     for (;;)
     {
         if (parsed->trainers_n == trainers_c)
@@ -1608,6 +1636,12 @@ static void parse(struct Parser *p, struct Parsed *parsed)
     }
 }
 
+static void parse(struct Parser *p, struct Parsed *parsed)
+{
+    parse_pragmas(p, parsed);
+    parse_trainers(p, parsed);
+}
+
 static void fprint_string(FILE *f, struct String s)
 {
     fprintf(f, "%.*s", s.string_n, s.string);
@@ -2101,74 +2135,153 @@ static void fprint_trainers(const char *output_path, FILE *f, struct Parsed *par
     }
 }
 
-static void usage(FILE *file, char *argv0)
+static double now_ms(void)
 {
-    fprintf(file, "Usage: %s -o <output> <source>\n", argv0);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
 }
 
-int main(int argc, char *argv[])
+struct Pool
 {
-    int status = 1;
-    FILE *source_file = NULL;
-    FILE *output_file = NULL;
-    unsigned char *source_buffer = NULL;
-    struct Parsed parsed = {
-        .default_ivs = { 31, 31, 31, 31, 31, 31 },
-        .default_level = 100,
-    };
+    pthread_mutex_t mutex;
+    int next;
+    int n;
+    void (*work)(void *context, int i);
+    void *context;
+};
 
-    const char *source_path = NULL;
-    const char *output_path = NULL;
-    const char *real_source_path = NULL;
+static void *pool_thread(void *arg)
+{
+    struct Pool *pool = arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        int i = pool->next++;
+        pthread_mutex_unlock(&pool->mutex);
+        if (i >= pool->n)
+            return NULL;
+        pool->work(pool->context, i);
+    }
+}
+
+// Runs 'work' for every index in [0, n) on up to 'threads_n' threads.
+static void run_parallel(int n, int threads_n, void (*work)(void *context, int i), void *context)
+{
+    struct Pool pool = {
+        .next = 0,
+        .n = n,
+        .work = work,
+        .context = context,
+    };
+    pthread_t threads[MAX_JOBS];
+    int started_n = 0;
 
-    int opt;
-    while ((opt = getopt(argc, argv, "i:o:")) != -1)
+    if (threads_n > n)
+        threads_n = n;
+    if (threads_n > 1)
     {
-        switch (opt)
+        pthread_mutex_init(&pool.mutex, NULL);
+        for (; started_n < threads_n - 1; started_n++)
         {
-        case 'i':
-            real_source_path = optarg;
-            break;
-        case 'o':
-            output_path = optarg;
-            break;
-        default:
-            fprintf(stderr, "unknown option '%c'\n", opt);
-            usage(stderr, argv[0]);
-            goto exit;
+            if (pthread_create(&threads[started_n], NULL, pool_thread, &pool) != 0)
+                break;
         }
     }
-
-    if (!output_path)
+    else
     {
-        usage(stderr, argv[0]);
-        goto exit;
+        for (int i = 0; i < n; i++)
+            work(context, i);
+        return;
     }
+    pool_thread(&pool);
+    for (int i = 0; i < started_n; i++)
+        pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&pool.mutex);
+}
+
+struct Job;
+
+// A run of whole trainers from one source, parsed independently of the others.
+struct Shard
+{
+    struct Job *job;
+    struct Source source;
+    struct Parser parser;
+    struct Parsed parsed;
+    bool error;
+};
+
+struct Job
+{
+    const char *source_path;
+    const char *real_source_path;
+    const char *output_path;
+    unsigned char *source_buffer;
+    bool source_mapped;
+    struct Source source;
+    struct Parsed parsed;
+    struct Shard *shards;
+    int shards_n;
+    int status;
+};
+
+// Reads the whole source, mapping it if it is a regular file.
+static bool read_source(struct Job *job)
+{
+    FILE *source_file = NULL;
+    int source_buffer_n = 0;
 
-    if (optind != argc - 1)
+    if (strcmp(job->source_path, "-") == 0)
     {
-        usage(stderr, argv[0]);
-        goto exit;
+        source_file = stdin;
+        job->source_path = "<stdin>";
+    }
+    else
+    {
+        source_file = fopen(job->source_path, "r");
+        if (source_file == NULL)
+        {
+            fprintf(stderr, "could not open '%s' for reading\n", job->source_path);
+            return false;
+        }
     }
-    source_path = argv[optind++];
 
-    int source_buffer_n;
-    if (strcmp(source_path, "-") == 0)
+#ifndef _WIN32
+    struct stat st;
+    if (fstat(fileno(source_file), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
     {
-        source_file = stdin;
-        source_path = "<stdin>";
+        if (st.st_size > INT_MAX)
+        {
+            fprintf(stderr, "could not read '%s': too big\n", job->source_path);
+            goto fail;
+        }
+        source_buffer_n = st.st_size;
+        void *mapped = mmap(NULL, source_buffer_n, PROT_READ, MAP_PRIVATE, fileno(source_file), 0);
+        if (mapped != MAP_FAILED)
+        {
+            job->source_buffer = mapped;
+            job->source_mapped = true;
+            goto done;
+        }
+    }
+#endif
 
+    if (source_file == stdin)
+    {
         int source_buffer_c = 4096;
         source_buffer_n = 0;
         for (;;)
         {
-            if (!(source_buffer = realloc(source_buffer, source_buffer_c)))
+            unsigned char *source_buffer_ = realloc(job->source_buffer, source_buffer_c);
+            if (!source_buffer_)
             {
                 fprintf(stderr, "could not allocate %d bytes\n", source_buffer_c);
-                goto exit;
+                goto fail;
             }
+            job->source_buffer = source_buffer_;
 
-            source_buffer_n += fread(&source_buffer[source_buffer_n], 1, source_buffer_c - source_buffer_n, source_file);
+            source_buffer_n += fread(&job->source_buffer[source_buffer_n], 1, source_buffer_c - source_buffer_n, source_file);
             if (source_buffer_n < source_buffer_c)
                 break;
 
@@ -2177,55 +2290,190 @@ int main(int argc, char *argv[])
     }
     else
     {
-        source_file = fopen(source_path, "r");
-        if (source_file == NULL)
-        {
-            fprintf(stderr, "could not open '%s' for reading\n", source_path);
-            goto exit;
-        }
-
         fseek(source_file, 0, SEEK_END);
         long source_buffer_n_ = ftell(source_file);
         if (source_buffer_n_ > INT_MAX)
         {
-            fprintf(stderr, "could not read '%s': too big\n", source_path);
-            goto exit;
+            fprintf(stderr, "could not read '%s': too big\n", job->source_path);
+            goto fail;
         }
 
         source_buffer_n = source_buffer_n_;
 
-        if (!(source_buffer = malloc(source_buffer_n)))
+        if (!(job->source_buffer = malloc(source_buffer_n + 1)))
         {
             fprintf(stderr, "could not allocate %d bytes\n", source_buffer_n);
-            goto exit;
+            goto fail;
         }
         rewind(source_file);
-        if (fread(source_buffer, 1, source_buffer_n, source_file) < source_buffer_n)
+        if (fread(job->source_buffer, 1, source_buffer_n, source_file) < source_buffer_n)
         {
-            fprintf(stderr, "could not read '%s'\n", source_path);
-            goto exit;
+            fprintf(stderr, "could not read '%s'\n", job->source_path);
+            goto fail;
         }
     }
 
-    struct Source source = {
-        .path = real_source_path ? real_source_path : source_path,
-        .buffer = source_buffer,
+#ifndef _WIN32
+done:
+#endif
+    if (source_file != stdin)
+        fclose(source_file);
+    job->source = (struct Source) {
+        .path = job->real_source_path ? job->real_source_path : job->source_path,
+        .buffer = job->source_buffer,
         .buffer_n = source_buffer_n,
     };
+    return true;
+
+fail:
+    if (source_file != stdin)
+        fclose(source_file);
+    return false;
+}
+
+static void free_source(struct Job *job)
+{
+#ifndef _WIN32
+    if (job->source_mapped)
+    {
+        munmap(job->source_buffer, job->source.buffer_n);
+        return;
+    }
+#endif
+    free(job->source_buffer);
+}
+
+// Parses the pragmas, then divides the trainers into up to 'shards_n'
+// shards of roughly equal size. Shards always start at a '===' line, so
+// each one can be parsed as if it were the rest of the file.
+static void split_job(struct Job *job, int shards_n)
+{
+    bool error = false;
     struct Parser parser = {
-        .source = &source,
+        .source = &job->source,
         .location = { .line = 1, .column = 1 },
         .offset = 0,
+        .quiet_error = &error,
     };
-    parse(&parser, &parsed);
-    if (parser.fatal_error)
+    parse_pragmas(&parser, &job->parsed);
+
+    int trainers_size = job->source.buffer_n - parser.offset;
+    if (error || shards_n > trainers_size / MIN_SHARD_SIZE + 1)
+        shards_n = trainers_size / MIN_SHARD_SIZE + 1;
+    if (error)
+        shards_n = 0;
+
+    job->shards = calloc(shards_n, sizeof(*job->shards));
+    job->shards_n = 0;
+    if (shards_n == 0)
+        return;
+    assert(job->shards);
+
+    struct Parser p = parser;
+    for (int i = 0; i < shards_n && !match_eof(&p); i++)
+    {
+        struct Shard *shard = &job->shards[job->shards_n++];
+        shard->job = job;
+        shard->parser = p;
+        shard->parsed = job->parsed;
+
+        int target = parser.offset + (long long)trainers_size * (i + 1) / shards_n;
+        if (i == shards_n - 1)
+            target = job->source.buffer_n;
+        while (!match_eof(&p))
+        {
+            struct Parser p_ = p;
+            if (p.offset >= target && match_exact(&p_, "==="))
+                break;
+            if (!match_empty_line(&p))
+                skip_line(&p);
+        }
+
+        shard->source = job->source;
+        shard->source.buffer_n = p.offset;
+        shard->parser.source = &shard->source;
+        shard->parser.quiet_error = &shard->error;
+    }
+}
+
+static void parse_shard(void *context, int i)
+{
+    struct Shard *shard = ((struct Shard **)context)[i];
+    parse_trainers(&shard->parser, &shard->parsed);
+}
+
+static void copy_trainer(struct Trainer *dest, const struct Trainer *src)
+{
+    memcpy(dest, src, offsetof(struct Trainer, pokemon));
+    memcpy(dest->pokemon, src->pokemon, sizeof(src->pokemon[0]) * src->pokemon_n);
+    memcpy(&dest->pokemon_n, &src->pokemon_n, sizeof(*src) - offsetof(struct Trainer, pokemon_n));
+}
+
+// Joins the shards' trainers back together. If any shard had an error, the
+// whole source is parsed again in one go so that the errors are reported
+// exactly as they would have been without sharding.
+static void merge_job(struct Job *job)
+{
+    bool any_error = job->shards_n == 0;
+    int trainers_n = 0;
+    for (int i = 0; i < job->shards_n; i++)
     {
-        goto exit;
+        any_error |= job->shards[i].error;
+        trainers_n += job->shards[i].parsed.trainers_n;
+    }
+
+    if (any_error)
+    {
+        struct Parser parser = {
+            .source = &job->source,
+            .location = { .line = 1, .column = 1 },
+            .offset = 0,
+        };
+        struct Parsed parsed = {
+            .default_ivs = { 31, 31, 31, 31, 31, 31 },
+            .default_level = 100,
+        };
+        job->parsed = parsed;
+        parse(&parser, &job->parsed);
+        if (parser.fatal_error)
+            job->status = 1;
+    }
+    else if (job->shards_n == 1)
+    {
+        job->parsed.trainers = job->shards[0].parsed.trainers;
+        job->parsed.trainers_n = job->shards[0].parsed.trainers_n;
+        job->shards[0].parsed.trainers = NULL;
+    }
+    else
+    {
+        job->parsed.trainers = malloc(sizeof(*job->parsed.trainers) * (trainers_n + 1));
+        job->parsed.trainers_n = 0;
+        assert(job->parsed.trainers);
+        for (int i = 0; i < job->shards_n; i++)
+        {
+            for (int j = 0; j < job->shards[i].parsed.trainers_n; j++)
+                copy_trainer(&job->parsed.trainers[job->parsed.trainers_n++], &job->shards[i].parsed.trainers[j]);
+        }
     }
 
+    for (int i = 0; i < job->shards_n; i++)
+        free(job->shards[i].parsed.trainers);
+    free(job->shards);
+    job->shards = NULL;
+    job->shards_n = 0;
+}
+
+static void emit_job(void *context, int i)
+{
+    struct Job *job = &((struct Job *)context)[i];
+    if (job->status != 0)
+        return;
+
+    FILE *output_file;
+    const char *output_path = job->output_path;
     if (strcmp(output_path, "-") == 0)
     {
-        source_file = stdout;
+        output_file = stdout;
         output_path = "<stdout>";
     }
     else
@@ -2234,17 +2482,142 @@ int main(int argc, char *argv[])
         if (output_file == NULL)
         {
             fprintf(stderr, "could not open '%s' for writing\n", output_path);
+            job->status = 1;
+            return;
+        }
+    }
+    fprint_trainers(output_path, output_file, &job->parsed);
+    if (output_file != stdout)
+        fclose(output_file);
+}
+
+static void usage(FILE *file, char *argv0)
+{
+    fprintf(file, "Usage: %s [-j <jobs>] [-t] -o <output> [-i <path>] <source> [-o <output> [-i <path>] <source>...]\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+    int status = 1;
+    struct Job *jobs = calloc(argc, sizeof(*jobs));
+    int jobs_n = 0;
+    int threads_n = 1;
+    bool print_timings = false;
+    assert(jobs);
+
+#ifdef _SC_NPROCESSORS_ONLN
+    threads_n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    // Each source is preceded by its own options, so stop at the first non-option.
+    const char *output_path = NULL;
+    const char *real_source_path = NULL;
+    while (optind < argc)
+    {
+        int opt = getopt(argc, argv, "+i:o:j:t");
+        if (opt == -1)
+        {
+            if (!output_path)
+            {
+                usage(stderr, argv[0]);
+                goto exit;
+            }
+            jobs[jobs_n++] = (struct Job) {
+                .source_path = argv[optind++],
+                .real_source_path = real_source_path,
+                .output_path = output_path,
+                .parsed = {
+                    .default_ivs = { 31, 31, 31, 31, 31, 31 },
+                    .default_level = 100,
+                },
+            };
+            output_path = NULL;
+            real_source_path = NULL;
+            continue;
+        }
+
+        switch (opt)
+        {
+        case 'i':
+            real_source_path = optarg;
+            break;
+        case 'o':
+            output_path = optarg;
+            break;
+        case 'j':
+            threads_n = atoi(optarg);
+            break;
+        case 't':
+            print_timings = true;
+            break;
+        default:
+            fprintf(stderr, "unknown option '%c'\n", opt);
+            usage(stderr, argv[0]);
             goto exit;
         }
     }
-    fprint_trainers(output_path, output_file, &parsed);
+
+    if (jobs_n == 0 || output_path)
+    {
+        usage(stderr, argv[0]);
+        goto exit;
+    }
+    if (threads_n < 1)
+        threads_n = 1;
+    if (threads_n > MAX_JOBS)
+        threads_n = MAX_JOBS;
+
+    double start = now_ms();
+    for (int i = 0; i < jobs_n; i++)
+    {
+        if (!read_source(&jobs[i]))
+            goto exit;
+    }
+    double read_end = now_ms();
+
+    struct Shard **shards = NULL;
+    int shards_n = 0;
+    for (int i = 0; i < jobs_n; i++)
+    {
+        split_job(&jobs[i], threads_n);
+        shards = realloc(shards, sizeof(*shards) * (shards_n + jobs[i].shards_n));
+        assert(shards || shards_n + jobs[i].shards_n == 0);
+        for (int j = 0; j < jobs[i].shards_n; j++)
+            shards[shards_n++] = &jobs[i].shards[j];
+    }
+    double split_end = now_ms();
+
+    run_parallel(shards_n, threads_n, parse_shard, shards);
+    free(shards);
+    double parse_end = now_ms();
+
+    for (int i = 0; i < jobs_n; i++)
+        merge_job(&jobs[i]);
+    double merge_end = now_ms();
+
+    run_parallel(jobs_n, threads_n, emit_job, jobs);
+    double emit_end = now_ms();
+
+    if (print_timings)
+    {
+        // Lexing and validation happen as part of parsing, so they aren't timed separately.
+        fprintf(stderr, "trainerproc: %d file(s), %d shard(s) on %d thread(s): read %.2f ms, split %.2f ms, parse %.2f ms, merge %.2f ms, emit %.2f ms, total %.2f ms\n",
+                jobs_n, shards_n, threads_n, read_end - start, split_end - read_end, parse_end - split_end, merge_end - parse_end, emit_end - merge_end, emit_end - start);
+    }
 
     status = 0;
+    for (int i = 0; i < jobs_n; i++)
+    {
+        if (jobs[i].status != 0)
+            status = 1;
+    }
 
 exit:
-    if (output_file) fclose(output_file);
-    if (parsed.trainers) free(parsed.trainers);
-    if (source_buffer) free(source_buffer);
-    if (source_file) fclose(source_file);
+    for (int i = 0; i < jobs_n; i++)
+    {
+        if (jobs[i].parsed.trainers) free(jobs[i].parsed.trainers);
+        if (jobs[i].source_buffer) free_source(&jobs[i]);
+    }
+    free(jobs);
     return status;
 }
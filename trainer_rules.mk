@@ -7,4 +7,4 @@ AUTO_GEN_TARGETS += test/battle/trainer_control.h
 AUTO_GEN_TARGETS += src/data/debug_trainers.h
 
 %.h: %.party
-	$(CPP) $(CPPFLAGS) -traditional-cpp - < $< | $(TRAINERPROC) -o $@ -i $< -
+	$(CPP) $(CPPFLAGS) -traditional-cpp - < $< | $(call CACHED,$@,-s) $(TRAINERPROC) -o $@ -i $< -